@@ -5,6 +5,10 @@ in vec3 v_normal;
 in vec2 v_texture_coords;
 
 uniform sampler2D u_color_texture;
+// scalar layers come as single channel float textures, shown in gray between their minimum and maximum
+uniform bool u_scalar_texture;
+uniform float u_value_min;
+uniform float u_value_max;
 
 out vec4 f_color;
 
@@ -12,6 +16,8 @@ void main()
 {
     vec3 light_direction = vec3(0.0, -1.0, -1.0);
     vec3 color = texture(u_color_texture, v_texture_coords).xyz;
+    if(u_scalar_texture)
+        color = vec3(clamp((color.r - u_value_min) / max(u_value_max - u_value_min, 1e-20), 0.0, 1.0));
     vec3 ambient = vec3(0.2, 0.2, 0.2) * color;
     vec3 diffuse = vec3(0.7, 0.7, 0.7) * max(dot(normalize(v_normal), -normalize(light_direction)), 0.0) * color;
     
@@ -11,18 +11,75 @@ layout(location = 4) in vec3 col_1;
 layout(location = 5) in vec3 col_2;
 layout(location = 6) in vec3 col_3;
 
+// grid vertex attributes (level of detail patches) : height and octahedral normal, the rest comes from the
+// index of the vertex in its patch
+layout(location = 7) in float height;
+layout(location = 8) in vec2 packed_normal;
+
 uniform mat4 u_view_matrix;
 uniform mat4 u_projection_matrix;
 
+uniform bool u_grid_vertices;
+uniform vec2 u_grid_scale;
+uniform vec2 u_grid_last_cell;
+uniform int u_patch_size;
+uniform vec3 u_patch;           // first cell x, y and stride
+uniform float u_height_min;
+uniform float u_height_range;
+
 out vec3 v_position;
 out vec3 v_normal;
 out vec2 v_texture_coords;
 
+// the same computation as TerrainLod::vertex_cell, gl_VertexID includes the first vertex of the patch
+vec2 grid_cell()
+{
+    int n = u_patch_size + 1;
+    int v = gl_VertexID % (n * n + 4 * u_patch_size);
+    ivec2 local = ivec2(v % n, v / n);
+    if(v >= n * n)
+    {
+        // skirt, along the bottom, right, top and left borders
+        int k = v - n * n;
+        int side = k / u_patch_size;
+        int t = k % u_patch_size;
+        if(side == 0)
+            local = ivec2(t, 0);
+        else if(side == 1)
+            local = ivec2(u_patch_size, t);
+        else if(side == 2)
+            local = ivec2(u_patch_size - t, u_patch_size);
+        else
+            local = ivec2(0, u_patch_size - t);
+    }
+    return min(u_patch.xy + vec2(local) * u_patch.z, u_grid_last_cell);
+}
+
+// the same decoding as unpack_normal (mesh.hpp)
+vec3 unpack_normal(vec2 octahedral)
+{
+    vec3 n = vec3(octahedral, 1.0 - abs(octahedral.x) - abs(octahedral.y));
+    if(n.z < 0.0)
+        n.xy = (1.0 - abs(octahedral.yx)) * vec2(octahedral.x >= 0.0 ? 1.0 : -1.0, octahedral.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
 void main()
 {
+    vec3 vertex_position = position;
+    vec3 vertex_normal = normal;
+    vec2 vertex_texture_coords = texture_coords;
+    if(u_grid_vertices)
+    {
+        vec2 cell = grid_cell();
+        vertex_position = vec3(cell * u_grid_scale, u_height_min + height * u_height_range);
+        vertex_normal = unpack_normal(packed_normal);
+        vertex_texture_coords = cell / u_grid_last_cell;
+    }
+
     mat4 world_matrix = mat4(vec4(col_0, 0.0), vec4(col_1, 0.0), vec4(col_2, 0.0), vec4(col_3, 1.0));
-    v_position = (world_matrix * vec4(position, 1.0)).xyz;
-    v_normal = normal;
-    v_texture_coords = texture_coords;
-    gl_Position = u_projection_matrix * u_view_matrix * world_matrix * vec4(position, 1.0);
-}
\ No newline at end of file
+    v_position = (world_matrix * vec4(vertex_position, 1.0)).xyz;
+    v_normal = vertex_normal;
+    v_texture_coords = vertex_texture_coords;
+    gl_Position = u_projection_matrix * u_view_matrix * world_matrix * vec4(vertex_position, 1.0);
+}
@@ -0,0 +1,35 @@
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <chrono>
+
+#include "terrain_job.hpp"
+
+// headless terrain generation : runs every job file given on the command line, without window or OpenGL context
+int main(int argc, char **argv)
+{
+    if(argc < 2)
+    {
+        fprintf(stderr, "usage : %s job_file [job_file ...]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    int nb_failed = 0;
+    for(int i = 1; i < argc; ++i)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        TerrainJob job;
+        if(!load_job(argv[i], job) || !run_job(job))
+        {
+            fprintf(stderr, "[BATCH] - job %s failed\n", argv[i]);
+            ++nb_failed;
+            continue;
+        }
+
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        printf("[BATCH] - job %s done in %.1f ms\n", argv[i], elapsed.count());
+    }
+
+    return nb_failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
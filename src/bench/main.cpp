@@ -0,0 +1,290 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include "heightfield.hpp"
+#include "mesh.hpp"
+#include "layer_export.hpp"
+#include "terrain_lod.hpp"
+#include "parallel.hpp"
+
+// times the terrain kernels over a range of grid sizes, without window or OpenGL context
+namespace
+{
+    struct Options
+    {
+        std::vector<unsigned int> sizes = {256, 1024, 4096, 8192};
+        unsigned int nb_repeats = 3;
+        std::string format = "text";
+        std::string output;
+        std::string filter;
+        std::string export_dir = "/tmp";
+    };
+
+    struct Measure
+    {
+        std::string kernel;
+        unsigned int nx, ny;
+        unsigned int nb_repeats;
+        double best_ms, mean_ms;
+        double cells_per_second;
+        long peak_rss_kb;
+    };
+
+    // the kernel peak is only available on linux (VmHWM can be reset through clear_refs), elsewhere the process peak is reported
+    void reset_peak_rss()
+    {
+        std::ofstream clear_refs("/proc/self/clear_refs");
+        if(clear_refs)
+            clear_refs << "5";
+    }
+
+    long peak_rss_kb()
+    {
+        std::ifstream status("/proc/self/status");
+        std::string line;
+        while(std::getline(status, line))
+        {
+            if(line.compare(0, 6, "VmHWM:") == 0)
+                return std::stol(line.substr(6));
+        }
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss;
+    }
+
+    bool parse_sizes(const std::string &list, std::vector<unsigned int> &sizes)
+    {
+        sizes.clear();
+        std::istringstream values(list);
+        std::string value;
+        while(std::getline(values, value, ','))
+        {
+            unsigned long size = std::strtoul(value.c_str(), nullptr, 10);
+            if(size < 16)
+                return false;
+            sizes.push_back((unsigned int)size);
+        }
+        return !sizes.empty();
+    }
+
+    bool parse_options(int argc, char **argv, Options &options)
+    {
+        for(int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            if(i + 1 >= argc)
+                return false;
+            std::string value = argv[++i];
+            if(arg == "--sizes")
+            {
+                if(!parse_sizes(value, options.sizes))
+                    return false;
+            }
+            else if(arg == "--repeat") options.nb_repeats = std::max(1, std::atoi(value.c_str()));
+            else if(arg == "--format")
+            {
+                if(value != "text" && value != "csv" && value != "json")
+                    return false;
+                options.format = value;
+            }
+            else if(arg == "--output") options.output = value;
+            else if(arg == "--filter") options.filter = value;
+            else if(arg == "--export-dir") options.export_dir = value;
+            else
+                return false;
+        }
+        return true;
+    }
+
+    class Bench
+    {
+    public:
+        Bench(const Options &options) : options_(options) {}
+
+        // setup is run before each repetition and is not timed
+        void run(const std::string &kernel, unsigned int nx, unsigned int ny, const std::function<void()> &function,
+            const std::function<void()> &setup = std::function<void()>())
+        {
+            if(!options_.filter.empty() && kernel.find(options_.filter) == std::string::npos)
+                return;
+
+            Measure measure;
+            measure.kernel = kernel;
+            measure.nx = nx;
+            measure.ny = ny;
+            measure.nb_repeats = options_.nb_repeats;
+            measure.best_ms = 0.0;
+            measure.mean_ms = 0.0;
+
+            reset_peak_rss();
+            for(unsigned int r = 0; r < options_.nb_repeats; ++r)
+            {
+                if(setup)
+                    setup();
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                function();
+                std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+                measure.best_ms = r == 0 ? elapsed.count() : std::min(measure.best_ms, elapsed.count());
+                measure.mean_ms += elapsed.count() / options_.nb_repeats;
+            }
+            measure.peak_rss_kb = peak_rss_kb();
+            measure.cells_per_second = (double)nx * ny / (measure.best_ms / 1000.0);
+            measures_.push_back(measure);
+
+            if(options_.format == "text")
+            {
+                printf("%-24s %5ux%-5u best %10.2f ms  mean %10.2f ms  %8.2f Mcells/s  peak %8.1f MB\n", kernel.c_str(), nx, ny,
+                    measure.best_ms, measure.mean_ms, measure.cells_per_second / 1e6, measure.peak_rss_kb / 1024.0);
+                fflush(stdout);
+            }
+        }
+
+        bool write() const
+        {
+            if(options_.format == "text")
+                return true;
+
+            std::ostringstream out;
+            if(options_.format == "csv")
+            {
+                out << "kernel,nx,ny,threads,repeats,best_ms,mean_ms,cells_per_second,peak_rss_kb\n";
+                for(const Measure &m : measures_)
+                    out << m.kernel << "," << m.nx << "," << m.ny << "," << util::nb_threads() << "," << m.nb_repeats << ","
+                        << m.best_ms << "," << m.mean_ms << "," << m.cells_per_second << "," << m.peak_rss_kb << "\n";
+            }
+            else
+            {
+                out << "{\n  \"threads\": " << util::nb_threads() << ",\n  \"results\": [\n";
+                for(unsigned int i = 0; i < measures_.size(); ++i)
+                {
+                    const Measure &m = measures_[i];
+                    out << "    {\"kernel\": \"" << m.kernel << "\", \"nx\": " << m.nx << ", \"ny\": " << m.ny << ", \"repeats\": " << m.nb_repeats
+                        << ", \"best_ms\": " << m.best_ms << ", \"mean_ms\": " << m.mean_ms << ", \"cells_per_second\": " << m.cells_per_second
+                        << ", \"peak_rss_kb\": " << m.peak_rss_kb << "}" << (i + 1 < measures_.size() ? "," : "") << "\n";
+                }
+                out << "  ]\n}\n";
+            }
+
+            if(options_.output.empty())
+            {
+                std::cout << out.str();
+                return true;
+            }
+            std::ofstream file(options_.output);
+            if(!file)
+            {
+                fprintf(stderr, "[BENCH] - could not write %s\n", options_.output.c_str());
+                return false;
+            }
+            file << out.str();
+            return true;
+        }
+
+    private:
+        const Options &options_;
+        std::vector<Measure> measures_;
+    };
+
+    void bench_size(Bench &bench, const Options &options, unsigned int size)
+    {
+        unsigned int n = size;
+        NoiseParameters noise;
+        noise.frequency_x = 10.0f;
+        noise.frequency_y = 10.0f;
+        noise.amplitude = 0.1f;
+        noise.octaves = 6;
+
+        HeightField reference(Vector2<float>(0.0f, 0.0f), Vector2<float>(1.0f, 1.0f), n, n);
+        reference.perlin_noise(noise);
+        reference.fill(0.05f);
+        HeightField field = reference;
+        auto reset = [&]() { field = reference; };
+        // the kernels reading the flow recompute it at each repetition, like after an edit
+        auto invalidate = [&]() { field.heights_changed(); };
+
+        bench.run("perlin_noise", n, n, [&]() { field.perlin_noise(noise); });
+        bench.run("thermal_sequential", n, n, [&]() { field.thermal_erosion(0.001f, ThermalErosionMode::sequential); }, reset);
+        bench.run("thermal_parallel", n, n, [&]() { field.thermal_erosion(0.001f, ThermalErosionMode::parallel); }, reset);
+        bench.run("stream_areas", n, n, [&]() { field.stream_areas(); }, invalidate);
+        bench.run("stream_power_erosion", n, n, [&]() { field.stream_power_erosion(0.00001f, 1.0f); }, reset);
+        bench.run("blur", n, n, [&]() { field.blur(8); }, reset);
+        bench.run("fill", n, n, [&]() { field.fill(0.05f); }, reset);
+        bench.run("road", n, n, [&]() { field.road(n / 10, n / 10, n - n / 10, n - n / 10, 2, 1.0f, 1.0f, 100.0f, 0.01f); }, reset);
+
+        std::vector<Vector3<float>> positions;
+        std::vector<Vector2<float>> texture_coords;
+        std::vector<unsigned int> indices;
+        reset();
+        bench.run("polygonize", n, n, [&]() { field.polygonize(positions, texture_coords, indices); });
+        bench.run("normals", n, n, [&]() { normals(positions, indices); });
+        bench.run("grid_normals", n, n, [&]() { grid_normals(field.view(), field.scale_x(), field.scale_y()); });
+        bench.run("grid_normals_packed", n, n, [&]() { grid_normals_packed(field.view(), field.scale_x(), field.scale_y()); });
+        std::vector<Vector3<float>>().swap(positions);
+        std::vector<Vector2<float>>().swap(texture_coords);
+        std::vector<unsigned int>().swap(indices);
+
+        // level of detail mesh, and the selection of a view from above the center of the grid
+        TerrainLod lod;
+        std::vector<unsigned int> patches;
+        bench.run("lod_build", n, n, [&]() { lod = TerrainLod(field); });
+        bench.run("lod_select", n, n, [&]() { lod.select({0.5f, 0.5f, 0.2f}, (float)M_PI / 2.0f, 900.0f, 1.0f, patches); });
+        Frustum frustum(Projection<float>(M_PI / 4.0f, 16.0f / 9.0f, 0.1f, 10.0f) * View<float>(normalize(Vector3<float>(0.0f, 1.0f, -0.3f)), {0.0f, 0.0f, 1.0f}, {0.5f, 0.5f, 0.2f}));
+        std::vector<unsigned int> visible;
+        bench.run("lod_cull", n, n, [&]() { visible = patches; lod.cull(frustum, visible); });
+        lod = TerrainLod();
+
+        std::string prefix = options.export_dir + "/terrain_bench_";
+        bench.run("export_data", n, n, [&]() { field.export_data(prefix + "data.png"); });
+        bench.run("export_data16", n, n, [&]() { field.export_data(prefix + "data16.png", 16); });
+        bench.run("export_data_pfm", n, n, [&]() { field.export_data(prefix + "data.pfm"); });
+        bench.run("export_gradient", n, n, [&]() { field.export_gradient(prefix + "gradient.png"); });
+        bench.run("export_laplacian", n, n, [&]() { field.export_laplacian(prefix + "laplacian.png"); });
+        bench.run("export_wetness", n, n, [&]() { field.export_wetness(prefix + "wetness.png"); }, invalidate);
+        bench.run("export_stream_areas", n, n, [&]() { field.export_stream_areas(prefix + "stream_areas.png"); }, invalidate);
+        bench.run("export_texture", n, n, [&]() { field.export_texture(prefix + "texture.png"); }, invalidate);
+        bench.run("export_all_layers", n, n, [&]()
+        {
+            std::vector<LayerOutput> outputs;
+            for(TerrainLayer layer : {TerrainLayer::texture, TerrainLayer::height, TerrainLayer::slope, TerrainLayer::laplacian, TerrainLayer::wetness, TerrainLayer::stream_areas})
+                outputs.push_back({layer, prefix + "layer_" + layer_name(layer) + ".png"});
+            LayerExporter exporter;
+            exporter.export_layers(field, outputs);
+            exporter.wait();
+        }, invalidate);
+
+        TerrainFileOptions compressed;
+        compressed.compress = true;
+        HeightField loaded(Vector2<float>(0.0f, 0.0f), Vector2<float>(1.0f, 1.0f), 2, 2);
+        bench.run("save_terrain", n, n, [&]() { field.save(prefix + "terrain.mtf"); });
+        bench.run("load_terrain", n, n, [&]() { loaded.load(prefix + "terrain.mtf"); });
+        bench.run("save_terrain_compressed", n, n, [&]() { field.save(prefix + "terrain_lz.mtf", compressed); });
+        bench.run("load_terrain_compressed", n, n, [&]() { loaded.load(prefix + "terrain_lz.mtf"); });
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if(!parse_options(argc, argv, options))
+    {
+        fprintf(stderr, "usage : %s [--sizes 256,1024,4096,8192] [--repeat 3] [--format text|csv|json] [--output file] [--filter kernel] [--export-dir dir]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if(options.format == "text")
+        printf("[BENCH] - %u threads, %u repeats\n", util::nb_threads(), options.nb_repeats);
+
+    Bench bench(options);
+    for(unsigned int size : options.sizes)
+        bench_size(bench, options, size);
+
+    return bench.write() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -1,5 +1,7 @@
 #include "image.hpp"
 
+#include <utility>
+
 Image::Image(const std::string &path)
 {
     pixels_ = image_io::load(path, &width_, &height_, &nb_channels_, true);
@@ -11,11 +13,27 @@ Image::Image(const std::vector<unsigned char> &pixels, unsigned int width, unsig
     assert(pixels.size() == width * height * nb_channels && "pixel array size does not match the provided dimensions");
 }
 
-std::vector<unsigned char> Image::pixels() const
+Image::Image(std::vector<unsigned char> &&pixels, unsigned int width, unsigned int height, unsigned int nb_channels)
+    : pixels_(std::move(pixels)), width_(width), height_(height), nb_channels_(nb_channels)
+{
+    assert(pixels_.size() == width * height * nb_channels && "pixel array size does not match the provided dimensions");
+}
+
+const std::vector<unsigned char> &Image::pixels() const
 {
     return pixels_;
 }
 
+util::GridView<const unsigned char> Image::view() const
+{
+    return util::GridView<const unsigned char>(pixels_.data(), width_, height_, nb_channels_);
+}
+
+util::GridView<unsigned char> Image::mutable_view()
+{
+    return util::GridView<unsigned char>(pixels_.data(), width_, height_, nb_channels_);
+}
+
 unsigned int Image::width() const
 {
     return width_;
@@ -7,13 +7,17 @@
 
 #include "color.hpp"
 #include "image_io.hpp"
+#include "grid_view.hpp"
 
 class Image
 {
 public:
     Image(const std::string &path);
     Image(const std::vector<unsigned char> &pixels, unsigned int width, unsigned int height, unsigned int nb_channels);
-    std::vector<unsigned char> pixels() const;
+    Image(std::vector<unsigned char> &&pixels, unsigned int width, unsigned int height, unsigned int nb_channels);
+    const std::vector<unsigned char> &pixels() const;
+    util::GridView<const unsigned char> view() const;
+    util::GridView<unsigned char> mutable_view();
     unsigned int width() const;
     unsigned int height() const;
     unsigned int nb_channels() const;
@@ -0,0 +1,198 @@
+#include "mesh.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+#include "parallel.hpp"
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#define MESHTOOL_MESH_SSE
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    // cross products of the triangles of the (up to) four quads around the vertex, not normalized
+    Vector3<float> normal_sum(util::GridView<const float> heights, float scale_x, float scale_y, unsigned int i, unsigned int j)
+    {
+        unsigned int width = heights.width();
+        unsigned int height = heights.height();
+        float v = heights(i, j);
+        float sx = scale_x, sy = scale_y;
+        Vector3<float> n(0.0f, 0.0f, 0.0f);
+        if(i + 1 < width && j + 1 < height)
+        {
+            float b = heights(i + 1, j), c = heights(i, j + 1), d = heights(i + 1, j + 1);
+            n = n + Vector3<float>(sy * ((c - d) - (b - v)), sx * ((b - d) - (c - v)), 2.0f * sx * sy);
+        }
+        if(i > 0 && j + 1 < height)
+        {
+            float a = heights(i - 1, j), d = heights(i, j + 1);
+            n = n + Vector3<float>(-sy * (v - a), sx * (v - d), sx * sy);
+        }
+        if(i + 1 < width && j > 0)
+        {
+            float a = heights(i, j - 1), d = heights(i + 1, j);
+            n = n + Vector3<float>(sy * (v - d), -sx * (v - a), sx * sy);
+        }
+        if(i > 0 && j > 0)
+        {
+            float a = heights(i - 1, j - 1), b = heights(i, j - 1), c = heights(i - 1, j);
+            n = n + Vector3<float>(sy * ((c - v) - (b - a)), sx * ((b - v) - (c - a)), 2.0f * sx * sy);
+        }
+        return n;
+    }
+
+    // sum of the normals of the triangles around every vertex of row j, not normalized
+    void normal_row(util::GridView<const float> heights, float scale_x, float scale_y, unsigned int j, float *x, float *y, float *z)
+    {
+        unsigned int width = heights.width();
+        unsigned int height = heights.height();
+        unsigned int i = 0;
+        if(j > 0 && j + 1 < height && width > 2)
+        {
+            // inside the grid the six triangles reduce to differences of six neighbors
+            const float *below = heights.row(j - 1);
+            const float *row = heights.row(j);
+            const float *above = heights.row(j + 1);
+            float z_value = 6.0f * scale_x * scale_y;
+
+            i = 1;
+#ifdef MESHTOOL_MESH_SSE
+            __m128 two = _mm_set1_ps(2.0f);
+            __m128 sx = _mm_set1_ps(scale_x);
+            __m128 sy = _mm_set1_ps(scale_y);
+            for(; i + 4 < width; i += 4)
+            {
+                __m128 left = _mm_loadu_ps(row + i - 1);
+                __m128 right = _mm_loadu_ps(row + i + 1);
+                __m128 bottom_left = _mm_loadu_ps(below + i - 1);
+                __m128 bottom = _mm_loadu_ps(below + i);
+                __m128 top = _mm_loadu_ps(above + i);
+                __m128 top_right = _mm_loadu_ps(above + i + 1);
+
+                __m128 nx = _mm_add_ps(_mm_mul_ps(two, _mm_sub_ps(left, right)), _mm_sub_ps(_mm_sub_ps(top, top_right), _mm_sub_ps(bottom, bottom_left)));
+                __m128 ny = _mm_add_ps(_mm_mul_ps(two, _mm_sub_ps(bottom, top)), _mm_sub_ps(_mm_sub_ps(right, top_right), _mm_sub_ps(left, bottom_left)));
+                _mm_storeu_ps(x + i, _mm_mul_ps(sy, nx));
+                _mm_storeu_ps(y + i, _mm_mul_ps(sx, ny));
+                _mm_storeu_ps(z + i, _mm_set1_ps(z_value));
+            }
+#endif
+            for(; i + 1 < width; ++i)
+            {
+                float nx = 2.0f * (row[i - 1] - row[i + 1]) + ((above[i] - above[i + 1]) - (below[i] - below[i - 1]));
+                float ny = 2.0f * (below[i] - above[i]) + ((row[i + 1] - above[i + 1]) - (row[i - 1] - below[i - 1]));
+                x[i] = scale_y * nx;
+                y[i] = scale_x * ny;
+                z[i] = z_value;
+            }
+
+            // borders of the row
+            for(unsigned int b : {0u, width - 1})
+            {
+                Vector3<float> n = normal_sum(heights, scale_x, scale_y, b, j);
+                x[b] = n.x;
+                y[b] = n.y;
+                z[b] = n.z;
+            }
+            return;
+        }
+
+        for(; i < width; ++i)
+        {
+            Vector3<float> n = normal_sum(heights, scale_x, scale_y, i, j);
+            x[i] = n.x;
+            y[i] = n.y;
+            z[i] = n.z;
+        }
+    }
+
+    template<typename Output, typename Write>
+    std::vector<Output> grid_pass(util::GridView<const float> heights, float scale_x, float scale_y, const Write &write)
+    {
+        unsigned int width = heights.width();
+        std::vector<Output> output((std::size_t)width * heights.height());
+        util::parallel_for(0, heights.height(), [&](unsigned int begin, unsigned int end)
+        {
+            std::vector<float> x(width), y(width), z(width);
+            for(unsigned int j = begin; j < end; ++j)
+            {
+                normal_row(heights, scale_x, scale_y, j, x.data(), y.data(), z.data());
+                Output *out = &output[(std::size_t)j * width];
+                for(unsigned int i = 0; i < width; ++i)
+                {
+                    float inverse = 1.0f / std::sqrt(x[i] * x[i] + y[i] * y[i] + z[i] * z[i]);
+                    out[i] = write(Vector3<float>(x[i] * inverse, y[i] * inverse, z[i] * inverse));
+                }
+            }
+        }, 8);
+        return output;
+    }
+
+    float to_snorm(float value)
+    {
+        return std::round(std::max(-1.0f, std::min(1.0f, value)) * 32767.0f);
+    }
+}
+
+std::vector<Vector3<float>> normals(const std::vector<Vector3<float>> &positions, const std::vector<unsigned int> &indices)
+{
+    std::vector<Vector3<float>> ns(positions.size(), Vector3<float>(0.0f, 0.0f, 0.0f));
+    for(unsigned int i = 0; i < indices.size(); i += 3)
+    {
+        Vector3<float> ab = positions.at(indices.at(i + 1)) - positions.at(indices.at(i));
+        Vector3<float> ac = positions.at(indices.at(i + 2)) - positions.at(indices.at(i));
+        Vector3<float> normal = cross(ab, ac);
+        ns.at(indices.at(i)) = ns.at(indices.at(i)) + normal;
+        ns.at(indices.at(i + 1)) = ns.at(indices.at(i + 1)) + normal;
+        ns.at(indices.at(i + 2)) = ns.at(indices.at(i + 2)) + normal;
+    }
+    for(unsigned int i = 0; i < ns.size(); ++i)
+        ns.at(i) = normalize(ns.at(i));
+    return ns;
+}
+
+Vector3<float> grid_normal(util::GridView<const float> heights, float scale_x, float scale_y, unsigned int i, unsigned int j)
+{
+    return normalize(normal_sum(heights, scale_x, scale_y, i, j));
+}
+
+std::vector<Vector3<float>> grid_normals(util::GridView<const float> heights, float scale_x, float scale_y)
+{
+    return grid_pass<Vector3<float>>(heights, scale_x, scale_y, [](const Vector3<float> &n) { return n; });
+}
+
+std::vector<std::uint32_t> grid_normals_packed(util::GridView<const float> heights, float scale_x, float scale_y)
+{
+    return grid_pass<std::uint32_t>(heights, scale_x, scale_y, pack_normal);
+}
+
+std::uint32_t pack_normal(const Vector3<float> &normal)
+{
+    float l1 = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+    float u = normal.x / l1;
+    float v = normal.y / l1;
+    if(normal.z < 0.0f)
+    {
+        float fu = (1.0f - std::abs(v)) * (u >= 0.0f ? 1.0f : -1.0f);
+        float fv = (1.0f - std::abs(u)) * (v >= 0.0f ? 1.0f : -1.0f);
+        u = fu;
+        v = fv;
+    }
+    std::uint16_t pu = (std::uint16_t)(std::int16_t)to_snorm(u);
+    std::uint16_t pv = (std::uint16_t)(std::int16_t)to_snorm(v);
+    return (std::uint32_t)pu | ((std::uint32_t)pv << 16);
+}
+
+Vector3<float> unpack_normal(std::uint32_t packed)
+{
+    float u = std::max(-1.0f, (std::int16_t)(packed & 0xFFFF) / 32767.0f);
+    float v = std::max(-1.0f, (std::int16_t)(packed >> 16) / 32767.0f);
+    Vector3<float> n(u, v, 1.0f - std::abs(u) - std::abs(v));
+    if(n.z < 0.0f)
+    {
+        n.x = (1.0f - std::abs(v)) * (u >= 0.0f ? 1.0f : -1.0f);
+        n.y = (1.0f - std::abs(u)) * (v >= 0.0f ? 1.0f : -1.0f);
+    }
+    return normalize(n);
+}
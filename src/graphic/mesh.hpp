@@ -0,0 +1,26 @@
+#ifndef MESHTOOL_MESH
+#define MESHTOOL_MESH
+
+#include <vector>
+#include <cstdint>
+
+#include "vector.hpp"
+#include "grid_view.hpp"
+
+// vertex normals of an indexed triangle mesh, averaged over the incident triangles (weighted by their area)
+std::vector<Vector3<float>> normals(const std::vector<Vector3<float>> &positions, const std::vector<unsigned int> &indices);
+
+// the same normals for the grid mesh of a height field (vertex (i, j) at (i scale_x, j scale_y, height), quads
+// split along their (i, j) (i + 1, j + 1) diagonal), read from the heights in one pass over the rows. Rows are
+// computed in parallel, 4 vertices at a time with SSE
+Vector3<float> grid_normal(util::GridView<const float> heights, float scale_x, float scale_y, unsigned int i, unsigned int j);
+std::vector<Vector3<float>> grid_normals(util::GridView<const float> heights, float scale_x, float scale_y);
+// octahedral encoded, see pack_normal
+std::vector<std::uint32_t> grid_normals_packed(util::GridView<const float> heights, float scale_x, float scale_y);
+
+// unit vector folded on the octahedron then on its upper half : two 16 bit signed normalized coordinates, x in
+// the low bits. The angular error stays below 0.05 degree
+std::uint32_t pack_normal(const Vector3<float> &normal);
+Vector3<float> unpack_normal(std::uint32_t packed);
+
+#endif
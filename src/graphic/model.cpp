@@ -7,17 +7,107 @@ void Model::init(const std::vector<Vector3<float>> &positions, const std::vector
     nb_vertices_ = positions.size();
     nb_indices_ = indices.size();
     nb_instances_ = transforms.size();
+    format_ = VertexFormat::full;
     create_vao(positions, normals, texture_coords, indices, transforms);
     shader_ = shader;
     texture_ = texture;
 }
 
+void Model::init(const TerrainLod &lod, VertexFormat format, const std::vector<Matrix4<float>> &transforms, const Shader &shader, const Texture &texture)
+{
+    assert(format != VertexFormat::full && "level of detail models use a grid vertex format");
+    nb_vertices_ = lod.heights().size();
+    nb_indices_ = lod.indices().size();
+    nb_instances_ = transforms.size();
+    format_ = format;
+    grid_.scale = Vector2<float>(lod.scale_x(), lod.scale_y());
+    grid_.last_cell = Vector2<float>(lod.nx() - 1, lod.ny() - 1);
+    grid_.patch_size = lod.patch_size();
+    grid_.height_min = format == VertexFormat::grid_unorm16 ? lod.height_min() : 0.0f;
+    grid_.height_range = format == VertexFormat::grid_unorm16 ? lod.height_max() - lod.height_min() : 1.0f;
+    grid_nx_ = lod.nx();
+    grid_ny_ = lod.ny();
+    create_grid_vao(lod, transforms);
+    set_patches({lod.patches().front()});
+    shader_ = shader;
+    texture_ = texture;
+}
+
 void Model::destroy()
 {
     glDeleteVertexArrays(1, &vao_);
     glDeleteBuffers(1, &ebo_);
     glDeleteBuffers(1, &ibo_);
     glDeleteBuffers(1, &vbo_);
+    texture_.destroy();
+}
+
+bool Model::same_topology(const TerrainLod &lod) const
+{
+    return format_ != VertexFormat::full && grid_nx_ == lod.nx() && grid_ny_ == lod.ny() && grid_.patch_size == (int)lod.patch_size()
+        && nb_vertices_ == lod.heights().size();
+}
+
+std::size_t Model::update(const TerrainLod &lod, const std::vector<VertexRange> &ranges, StagingBuffer &staging)
+{
+    assert(same_topology(lod) && "the mesh does not have the layout of the model");
+    grid_.scale = Vector2<float>(lod.scale_x(), lod.scale_y());
+
+    // new heights out of the range quantized so far requantize all of them
+    std::vector<VertexRange> all(1, VertexRange{0, nb_vertices_});
+    const std::vector<VertexRange> *updated = &ranges;
+    if(format_ == VertexFormat::grid_unorm16 && (lod.height_min() < grid_.height_min || lod.height_max() > grid_.height_min + grid_.height_range))
+    {
+        grid_.height_min = lod.height_min();
+        grid_.height_range = lod.height_max() - lod.height_min();
+        updated = &all;
+    }
+
+    std::size_t nb_bytes = 0;
+    std::vector<std::uint16_t> quantized;
+    for(const VertexRange &range : *updated)
+    {
+        assert(range.first + range.count <= nb_vertices_ && "vertex range out of bounds");
+        if(format_ == VertexFormat::grid_unorm16)
+        {
+            quantized.resize(range.count);
+            lod.quantized_heights(range.first, range.count, grid_.height_min, grid_.height_min + grid_.height_range, quantized.data());
+            staging.copy(vbo_, range.first * height_size(), quantized.data(), range.count * height_size());
+        }
+        else
+            staging.copy(vbo_, range.first * height_size(), &lod.heights()[range.first], range.count * height_size());
+        staging.copy(vbo_, nb_vertices_ * height_size() + range.first * sizeof(std::uint32_t), &lod.normals()[range.first], range.count * sizeof(std::uint32_t));
+        nb_bytes += range.count * (height_size() + sizeof(std::uint32_t));
+    }
+    staging.flush();
+    return nb_bytes;
+}
+
+void Model::set_texture(const Texture &texture)
+{
+    texture_.destroy();
+    texture_ = texture;
+    texture_.use();
+}
+
+void Model::set_patches(const std::vector<LodPatch> &patches)
+{
+    patches_ = patches;
+}
+
+const std::vector<LodPatch> &Model::patches() const
+{
+    return patches_;
+}
+
+VertexFormat Model::format() const
+{
+    return format_;
+}
+
+const GridVertices &Model::grid() const
+{
+    return grid_;
 }
 
 unsigned int Model::vao() const
@@ -53,14 +143,6 @@ Texture Model::texture() const
 void Model::create_vao(const std::vector<Vector3<float>> &positions, const std::vector<Vector3<float>> &normals, const std::vector<Vector2<float>> &texture_coords, 
     const std::vector<unsigned int> &indices, const std::vector<Matrix4<float>> &transforms)
 {
-    std::vector<Vector3<float>> transform_columns;
-    transform_columns.reserve(nb_instances_ * 4);
-    for(const Matrix4<float> &transform : transforms)
-    {
-        for(unsigned int i = 0; i < 4; ++i)
-            transform_columns.push_back(transform[i]);
-    }
-
     glGenVertexArrays(1, &vao_);
     glCreateBuffers(1, &vbo_);
     glCreateBuffers(1, &ibo_);
@@ -85,6 +167,70 @@ void Model::create_vao(const std::vector<Vector3<float>> &positions, const std::
     glEnableVertexAttribArray(2);
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vector2<float>), (void*)(nb_vertices_ * sizeof(Vector3<float>) * 2));
 
+    create_instances(transforms);
+    create_indices(indices);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+// heights then normals, the grid cell of a vertex is rebuilt from gl_VertexID
+void Model::create_grid_vao(const TerrainLod &lod, const std::vector<Matrix4<float>> &transforms)
+{
+    glGenVertexArrays(1, &vao_);
+    glCreateBuffers(1, &vbo_);
+    glCreateBuffers(1, &ibo_);
+    glCreateBuffers(1, &ebo_);
+
+    glBindVertexArray(vao_);
+
+    // store vertex data
+    std::size_t height_size = this->height_size();
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+    glBufferData(GL_ARRAY_BUFFER, nb_vertices_ * (height_size + sizeof(std::uint32_t)), nullptr, GL_DYNAMIC_DRAW);
+
+    if(format_ == VertexFormat::grid_unorm16)
+    {
+        std::vector<std::uint16_t> heights = lod.quantized_heights();
+        glBufferSubData(GL_ARRAY_BUFFER, 0, nb_vertices_ * height_size, &heights[0]);
+    }
+    else
+        glBufferSubData(GL_ARRAY_BUFFER, 0, nb_vertices_ * height_size, &lod.heights()[0]);
+    glBufferSubData(GL_ARRAY_BUFFER, nb_vertices_ * height_size, nb_vertices_ * sizeof(std::uint32_t), &lod.normals()[0]);
+
+    glEnableVertexAttribArray(7);
+    if(format_ == VertexFormat::grid_unorm16)
+        glVertexAttribPointer(7, 1, GL_UNSIGNED_SHORT, GL_TRUE, height_size, (void*)0);
+    else
+        glVertexAttribPointer(7, 1, GL_FLOAT, GL_FALSE, height_size, (void*)0);
+
+    glEnableVertexAttribArray(8);
+    glVertexAttribPointer(8, 2, GL_SHORT, GL_TRUE, sizeof(std::uint32_t), (void*)(nb_vertices_ * height_size));
+
+    create_instances(transforms);
+    create_indices(lod.indices());
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+std::size_t Model::height_size() const
+{
+    return format_ == VertexFormat::grid_unorm16 ? sizeof(std::uint16_t) : sizeof(float);
+}
+
+void Model::create_instances(const std::vector<Matrix4<float>> &transforms)
+{
+    std::vector<Vector3<float>> transform_columns;
+    transform_columns.reserve(nb_instances_ * 4);
+    for(const Matrix4<float> &transform : transforms)
+    {
+        for(unsigned int i = 0; i < 4; ++i)
+            transform_columns.push_back(transform[i]);
+    }
+
     // store per instances vertex data
     glBindBuffer(GL_ARRAY_BUFFER, ibo_);
     glBufferData(GL_ARRAY_BUFFER, transform_columns.size() * sizeof(Vector3<float>), &transform_columns[0], GL_STATIC_DRAW);
@@ -104,37 +250,11 @@ void Model::create_vao(const std::vector<Vector3<float>> &positions, const std::
     glEnableVertexAttribArray(6);
     glVertexAttribPointer(6, 3, GL_FLOAT, GL_FALSE, sizeof(Vector3<float>) * 4, (void *)(sizeof(Vector3<float>) * 3));
     glVertexAttribDivisor(6, 1);
-
-    // store indices
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo_);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, nb_indices_ * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-    
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
-Model make_model(const std::vector<Vector3<float>> &positions, const std::vector<Vector2<float>> &texture_coords, 
-        const std::vector<unsigned int> &indices, const std::vector<Matrix4<float>> &transforms, const Shader &shader, const Texture &texture)
+void Model::create_indices(const std::vector<unsigned int> &indices)
 {
-    Model model;
-    model.init(positions, normals(positions, indices), texture_coords, indices, transforms, shader, texture);
-    return model;
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo_);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, nb_indices_ * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
 }
 
-std::vector<Vector3<float>> normals(const std::vector<Vector3<float>> &positions, const std::vector<unsigned int> &indices)
-{
-    std::vector<Vector3<float>> ns(positions.size(), Vector3<float>(0.0f, 0.0f, 0.0f));
-    for(unsigned int i = 0; i < indices.size(); i += 3)
-    {
-        Vector3<float> ab = positions.at(indices.at(i + 1)) - positions.at(indices.at(i));
-        Vector3<float> ac = positions.at(indices.at(i + 2)) - positions.at(indices.at(i));
-        Vector3<float> normal = cross(ab, ac);
-        ns.at(indices.at(i)) = ns.at(indices.at(i)) + normal;
-        ns.at(indices.at(i + 1)) = ns.at(indices.at(i + 1)) + normal;
-        ns.at(indices.at(i + 2)) = ns.at(indices.at(i + 2)) + normal;
-    }
-    for(unsigned int i = 0; i < ns.size(); ++i)
-        ns.at(i) = normalize(ns.at(i));
-    return ns;
-}
\ No newline at end of file
@@ -10,13 +10,50 @@
 #include "matrix.hpp"
 #include "shader.hpp"
 #include "texture.hpp"
+#include "mesh.hpp"
+#include "terrain_lod.hpp"
+#include "staging_buffer.hpp"
+
+// how the vertices of a model are stored in its buffer, see basic_vertex.vs
+enum class VertexFormat
+{
+    full,           // position, normal and texture coordinates, 32 bytes
+    grid_float,     // level of detail patches : height and octahedral normal, 8 bytes
+    grid_unorm16    // the same with a 16 bit height over the height range, 6 bytes
+};
+
+// what the vertex shader needs to rebuild the positions and texture coordinates of the grid formats
+struct GridVertices
+{
+    Vector2<float> scale;       // size of a cell
+    Vector2<float> last_cell;   // nx - 1, ny - 1
+    int patch_size;
+    float height_min, height_range;
+};
 
 class Model
 {
 public:
     void init(const std::vector<Vector3<float>> &positions, const std::vector<Vector3<float>> &normals, const std::vector<Vector2<float>> &texture_coords, 
         const std::vector<unsigned int> &indices, const std::vector<Matrix4<float>> &transforms, const Shader &shader, const Texture &texture);
+    void init(const TerrainLod &lod, VertexFormat format, const std::vector<Matrix4<float>> &transforms, const Shader &shader, const Texture &texture);
     void destroy();
+
+    // true when the vertices of the level of detail mesh have the layout of this grid model : same grid size and
+    // patches, so that the instance and index buffers are kept and update() can replace vertex ranges
+    bool same_topology(const TerrainLod &lod) const;
+    // uploads these vertex ranges of the mesh through the staging buffer, all of them when a height falls out of
+    // the quantization range of the 16 bit format. Returns the number of bytes copied
+    std::size_t update(const TerrainLod &lod, const std::vector<VertexRange> &ranges, StagingBuffer &staging);
+    // destroys the previous texture
+    void set_texture(const Texture &texture);
+
+    // draws the index buffer once from the first vertex of each of these patches instead of once for the whole
+    // mesh, for meshes made of patches sharing their triangles (see TerrainLod)
+    void set_patches(const std::vector<LodPatch> &patches);
+    const std::vector<LodPatch> &patches() const;
+    VertexFormat format() const;
+    const GridVertices &grid() const;
     unsigned int vao() const;
     unsigned int nb_vertices() const;
     unsigned int nb_indices() const;
@@ -27,17 +64,29 @@ public:
 private:
     void create_vao(const std::vector<Vector3<float>> &positions, const std::vector<Vector3<float>> &normals, const std::vector<Vector2<float>> &texture_coords, 
         const std::vector<unsigned int> &indices, const std::vector<Matrix4<float>> &transforms);
+    void create_grid_vao(const TerrainLod &lod, const std::vector<Matrix4<float>> &transforms);
+    void create_instances(const std::vector<Matrix4<float>> &transforms);
+    void create_indices(const std::vector<unsigned int> &indices);
+    std::size_t height_size() const;
 
 private:
     unsigned int vao_, vbo_, ibo_, ebo_;
     unsigned int nb_vertices_, nb_indices_, nb_instances_;
+    VertexFormat format_ = VertexFormat::full;
+    GridVertices grid_;
+    unsigned int grid_nx_ = 0, grid_ny_ = 0;
+    std::vector<LodPatch> patches_;
     Shader shader_;
     Texture texture_;
 };
 
 Model make_model(const std::vector<Vector3<float>> &positions, const std::vector<Vector2<float>> &texture_coords, 
         const std::vector<unsigned int> &indices, const std::vector<Matrix4<float>> &transforms, const Shader &shader, const Texture &texture);
-
-std::vector<Vector3<float>> normals(const std::vector<Vector3<float>> &positions, const std::vector<unsigned int> &indices);
+// normals computed by the caller, grid_normals for a height field
+Model make_model(const std::vector<Vector3<float>> &positions, const std::vector<Vector3<float>> &normals, const std::vector<Vector2<float>> &texture_coords,
+        const std::vector<unsigned int> &indices, const std::vector<Matrix4<float>> &transforms, const Shader &shader, const Texture &texture);
+// every patch of the level of detail mesh, the root one is drawn until set_patches is called
+Model make_model(const TerrainLod &lod, const std::vector<Matrix4<float>> &transforms, const Shader &shader, const Texture &texture,
+        VertexFormat format = VertexFormat::grid_unorm16);
 
 #endif
\ No newline at end of file
@@ -20,6 +20,11 @@ Camera &Scene::camera()
     return camera_;
 }
 
+std::vector<Model> &Scene::models()
+{
+    return models_;
+}
+
 void Scene::sort_models()
 {
     std::sort(models_.begin(), models_.end(), 
@@ -52,7 +57,29 @@ void Scene::draw()
         last_model_.shader().set_uniform("u_view_matrix", camera_.view());
         last_model_.shader().set_uniform("u_projection_matrix", camera_.projection());
         last_model_.shader().set_uniform("u_color_texture", (int)(model.texture().unit()));
+        last_model_.shader().set_uniform("u_scalar_texture", model.texture().scalar());
+        last_model_.shader().set_uniform("u_value_min", model.texture().value_min());
+        last_model_.shader().set_uniform("u_value_max", model.texture().value_max());
+
+        bool grid = model.format() != VertexFormat::full;
+        last_model_.shader().set_uniform("u_grid_vertices", grid);
+        if(grid)
+        {
+            last_model_.shader().set_uniform("u_grid_scale", model.grid().scale);
+            last_model_.shader().set_uniform("u_grid_last_cell", model.grid().last_cell);
+            last_model_.shader().set_uniform("u_patch_size", model.grid().patch_size);
+            last_model_.shader().set_uniform("u_height_min", model.grid().height_min);
+            last_model_.shader().set_uniform("u_height_range", model.grid().height_range);
+        }
+
         glBindVertexArray(last_model_.vao());
-        glDrawElementsInstanced(GL_TRIANGLES, last_model_.nb_indices(), GL_UNSIGNED_INT, 0, last_model_.nb_instances());
+        if(model.patches().empty())
+            glDrawElementsInstanced(GL_TRIANGLES, last_model_.nb_indices(), GL_UNSIGNED_INT, 0, last_model_.nb_instances());
+        for(const LodPatch &patch : model.patches())
+        {
+            if(grid)
+                last_model_.shader().set_uniform("u_patch", Vector3<float>(patch.x0, patch.y0, patch.stride));
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, last_model_.nb_indices(), GL_UNSIGNED_INT, 0, last_model_.nb_instances(), patch.first_vertex);
+        }
     }
 }
\ No newline at end of file
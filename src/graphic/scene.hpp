@@ -19,6 +19,7 @@ public:
     void destroy();
     void draw();
     Camera &camera();
+    std::vector<Model> &models();
 
 private:
     void sort_models();
@@ -56,6 +56,11 @@ void Shader::set_uniform(const std::string &name, const Matrix4<float> &matrix)
     glUniformMatrix4fv(glGetUniformLocation(program_, name.c_str()), 1, GL_TRUE, &matrix.m[0][0]);
 }
 
+void Shader::set_uniform(const std::string &name, const Vector2<float> &vector)
+{
+    glUniform2f(glGetUniformLocation(program_, name.c_str()), vector.x, vector.y);
+}
+
 void Shader::set_uniform(const std::string &name, const Vector3<float> &vector)
 {
     glUniform3f(glGetUniformLocation(program_, name.c_str()), vector.x, vector.y, vector.z);
@@ -18,6 +18,7 @@ public:
     void set_uniform(const std::string &name, int value);
     void set_uniform(const std::string &name, float value);
     void set_uniform(const std::string &name, bool value);
+    void set_uniform(const std::string &name, const Vector2<float> &vector);
     void set_uniform(const std::string &name, const Vector3<float> &vector);
     void set_uniform(const std::string &name, const Matrix4<float> &matrix);
 
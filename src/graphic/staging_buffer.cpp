@@ -0,0 +1,83 @@
+#include "staging_buffer.hpp"
+
+#include <cstring>
+#include <algorithm>
+
+void StagingBuffer::init(std::size_t capacity)
+{
+    ring_ = util::RingAllocator(capacity);
+    glGenBuffers(1, &buffer_);
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer_);
+    if(GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage)
+    {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_COPY_READ_BUFFER, capacity, nullptr, flags);
+        mapped_ = glMapBufferRange(GL_COPY_READ_BUFFER, 0, capacity, flags);
+    }
+    else
+        glBufferData(GL_COPY_READ_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+}
+
+void StagingBuffer::destroy()
+{
+    for(GLsync fence : fences_)
+        glDeleteSync(fence);
+    fences_.clear();
+    if(mapped_)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer_);
+        glUnmapBuffer(GL_COPY_READ_BUFFER);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        mapped_ = nullptr;
+    }
+    glDeleteBuffers(1, &buffer_);
+}
+
+void StagingBuffer::copy(unsigned int destination, std::size_t offset, const void *data, std::size_t size)
+{
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer_);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, destination);
+    while(size > 0)
+    {
+        std::size_t chunk = std::min(size, ring_.capacity());
+        std::size_t ring_offset;
+        void *target = allocate(chunk, ring_offset);
+        std::memcpy(target, bytes, chunk);
+        if(!mapped_)
+            glUnmapBuffer(GL_COPY_READ_BUFFER);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, ring_offset, offset, chunk);
+
+        bytes += chunk;
+        offset += chunk;
+        size -= chunk;
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+}
+
+void StagingBuffer::flush()
+{
+    if(ring_.close_segment())
+        fences_.push_back(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+}
+
+// expects the ring bound to GL_COPY_READ_BUFFER, the range stays mapped until the copy when the ring is not
+void *StagingBuffer::allocate(std::size_t size, std::size_t &offset)
+{
+    while(!ring_.allocate(size, offset))
+    {
+        // the pending copies are fenced too when they fill the ring by themselves
+        if(fences_.empty())
+            flush();
+        glClientWaitSync(fences_.front(), GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        glDeleteSync(fences_.front());
+        fences_.pop_front();
+        ring_.release_segment();
+    }
+
+    if(mapped_)
+        return static_cast<unsigned char *>(mapped_) + offset;
+    return glMapBufferRange(GL_COPY_READ_BUFFER, offset, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+}
@@ -0,0 +1,36 @@
+#ifndef MESHTOOL_STAGING_BUFFER
+#define MESHTOOL_STAGING_BUFFER
+
+#include <deque>
+#include <cstddef>
+
+#include <glad/glad.h>
+
+#include "ring_allocator.hpp"
+
+// upload buffer reused for every partial buffer update : data is written to the ring then copied on the GPU to
+// its destination, so a frame never waits on a buffer the driver still reads from. The ring is mapped once when
+// buffer storage is available (GL 4.4), range by range without synchronization otherwise. Each batch of copies
+// is fenced, writing over a batch waits for its fence
+class StagingBuffer
+{
+public:
+    void init(std::size_t capacity = 8u << 20);
+    void destroy();
+
+    // copies size bytes to the offset of the destination buffer, through chunks of the ring when it is smaller
+    void copy(unsigned int destination, std::size_t offset, const void *data, std::size_t size);
+    // fences the copies issued since the last call
+    void flush();
+
+private:
+    void *allocate(std::size_t size, std::size_t &offset);
+
+private:
+    unsigned int buffer_ = 0;
+    void *mapped_ = nullptr;    // whole ring, persistently mapped
+    util::RingAllocator ring_;
+    std::deque<GLsync> fences_;
+};
+
+#endif
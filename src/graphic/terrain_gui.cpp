@@ -77,8 +77,18 @@ void render_gui(TerrainGuiState &gui_state)
 
     ImGui::Begin("Update", nullptr, gui_flags);
     ImGui::SetWindowPos(ImVec2(10.0f, 540.0f));
+    ImGui::SliderFloat("lod error (pixels)", &gui_state.lod_error, 0.25f, 8.0f);
+    ImGui::Text("%u triangles", gui_state.nb_triangles);
+    ImGui::Text("%u / %u patches culled", gui_state.nb_patches_culled, gui_state.nb_patches_tested);
     if(ImGui::Button("update"))
         gui_state.update = true;
+    if(gui_state.building)
+    {
+        ImGui::SameLine();
+        if(ImGui::Button("cancel"))
+            gui_state.cancel = true;
+        ImGui::ProgressBar(gui_state.progress, ImVec2(200.0f, 0.0f), gui_state.stage);
+    }
     ImGui::End();
 
     ImGui::Render();
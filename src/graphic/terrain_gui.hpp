@@ -39,8 +39,20 @@ struct TerrainGuiState
     bool wetness       = false;
     bool stream_areas  = false;
 
+    // level of detail : largest screen space error in pixels, triangles drawn and patches outside of the view
+    float lod_error = 1.0f;
+    unsigned int nb_triangles = 0;
+    unsigned int nb_patches_tested = 0;
+    unsigned int nb_patches_culled = 0;
+
     // update
     bool update = false;
+    bool cancel = false;
+
+    // background build, filled by the viewer
+    bool building = false;
+    float progress = 0.0f;
+    const char *stage = "";
 };
 
 inline ImGuiWindowFlags gui_flags = ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoCollapse;
@@ -1,5 +1,9 @@
 #include "texture.hpp"
 
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
 void Texture::init(const std::string &path, unsigned int unit)
 {
     unit_ = unit;
@@ -18,7 +22,7 @@ void Texture::init(const std::string &path, unsigned int unit)
         case(3) : nb_channels = GL_RGB; break;
         case(4) : nb_channels = GL_RGBA; break;
     }
-    glTexImage2D(GL_TEXTURE_2D, 0, nb_channels, image.width(), image.height(), 0, nb_channels, GL_UNSIGNED_BYTE, &(image.pixels()[0]));
+    glTexImage2D(GL_TEXTURE_2D, 0, nb_channels, image.width(), image.height(), 0, nb_channels, GL_UNSIGNED_BYTE, image.view().data());
     glGenerateMipmap(GL_TEXTURE_2D);
 }
 
@@ -39,16 +43,60 @@ void Texture::init(const Image &image, unsigned int unit)
         case(4) : nb_channels = GL_RGBA; break;
     }
     
-    glTexImage2D(GL_TEXTURE_2D, 0, nb_channels, image.width(), image.height(), 0, nb_channels, GL_UNSIGNED_BYTE, &(image.pixels()[0]));
+    glTexImage2D(GL_TEXTURE_2D, 0, nb_channels, image.width(), image.height(), 0, nb_channels, GL_UNSIGNED_BYTE, image.view().data());
     glGenerateMipmap(GL_TEXTURE_2D);
 }
 
+void Texture::init(util::GridView<const float> values, unsigned int unit)
+{
+    unit_ = unit;
+    scalar_ = true;
+    // non finite values (holes of imported maps, logarithms of empty areas) are left out of the range
+    value_min_ = std::numeric_limits<float>::infinity();
+    value_max_ = -std::numeric_limits<float>::infinity();
+    for(unsigned int j = 0; j < values.height(); ++j)
+    {
+        const float *row = values.row(j);
+        for(unsigned int i = 0; i < values.width(); ++i)
+        {
+            if(std::isfinite(row[i]))
+            {
+                value_min_ = std::min(value_min_, row[i]);
+                value_max_ = std::max(value_max_, row[i]);
+            }
+        }
+    }
+    if(value_min_ > value_max_)
+    {
+        value_min_ = 0.0f;
+        value_max_ = 1.0f;
+    }
+
+    glGenTextures(1, &texture_);
+    glBindTexture(GL_TEXTURE_2D, texture_);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+    // rows are read in place, the stride is given in floats
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, values.stride());
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, values.width(), values.height(), 0, GL_RED, GL_FLOAT, values.data());
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+}
+
 void Texture::use()
 {
     glActiveTexture(GL_TEXTURE0 + unit_);
     glBindTexture(GL_TEXTURE_2D, texture_);
 }
 
+void Texture::destroy()
+{
+    glDeleteTextures(1, &texture_);
+}
+
 unsigned int Texture::texture_id() const
 {
     return texture_;
@@ -59,9 +107,38 @@ unsigned int Texture::unit() const
     return unit_;
 }
 
+bool Texture::scalar() const
+{
+    return scalar_;
+}
+
+float Texture::value_min() const
+{
+    return value_min_;
+}
+
+float Texture::value_max() const
+{
+    return value_max_;
+}
+
 Texture make_texture(const std::string &path, unsigned int unit)
 {
     Texture texture;
     texture.init(path, unit);
     return texture;
+}
+
+Texture make_texture(const Image &image, unsigned int unit)
+{
+    Texture texture;
+    texture.init(image, unit);
+    return texture;
+}
+
+Texture make_texture(util::GridView<const float> values, unsigned int unit)
+{
+    Texture texture;
+    texture.init(values, unit);
+    return texture;
 }
\ No newline at end of file
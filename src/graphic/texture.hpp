@@ -6,21 +6,32 @@
 #include <glad/glad.h>
 
 #include "image.hpp"
+#include "grid_view.hpp"
 
 class Texture
 {
 public:
     void init(const std::string &path, unsigned int unit = 0);
     void init(const Image &image, unsigned int unit = 0);
+    // single channel float texture (GL_R32F) of scalar values, colormapped by the shader over [value_min, value_max]
+    void init(util::GridView<const float> values, unsigned int unit = 0);
     void use();
+    void destroy();
     unsigned int texture_id() const;
     unsigned int unit() const;
+    bool scalar() const;
+    float value_min() const;
+    float value_max() const;
 
 private:
     unsigned int texture_;
     unsigned int unit_;
+    bool scalar_ = false;
+    float value_min_ = 0.0f, value_max_ = 1.0f;
 };
 
 Texture make_texture(const std::string &path, unsigned int unit = 0);
+Texture make_texture(const Image &image, unsigned int unit = 0);
+Texture make_texture(util::GridView<const float> values, unsigned int unit = 0);
 
 #endif
\ No newline at end of file
@@ -1,5 +1,233 @@
 #include "image_io.hpp"
 
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+
+#include "parallel.hpp"
+
+// deflate of stb_image_write, defined with the rest of the implementation in stb_image.cpp
+extern "C" unsigned char *stbi_zlib_compress(unsigned char *data, int data_len, int *out_len, int quality);
+
+namespace
+{
+    std::string extension(const std::string &path)
+    {
+        size_t dot = path.find_last_of('.');
+        if(dot == std::string::npos)
+            return "";
+        std::string result = path.substr(dot + 1);
+        std::transform(result.begin(), result.end(), result.begin(), ::tolower);
+        return result;
+    }
+
+    // first channel of n pixels over divisor. The single channel loop is contiguous so the compiler vectorizes it
+    template<typename T>
+    void first_channel(const T *src, unsigned int nb_channels, unsigned int n, float divisor, float *dst)
+    {
+        if(nb_channels == 1)
+        {
+            for(unsigned int i = 0; i < n; ++i)
+                dst[i] = src[i] / divisor;
+        }
+        else
+        {
+            for(unsigned int i = 0; i < n; ++i)
+                dst[i] = src[i * nb_channels] / divisor;
+        }
+    }
+
+    // converts the rows of an interleaved image, file row j going to grid row ny - 1 - j when flipped
+    template<typename T>
+    void convert_rows(const T *pixels, unsigned int width, unsigned int height, unsigned int nb_channels, float divisor, bool flip, float *heights)
+    {
+        util::parallel_for(0, height, [&](unsigned int j_begin, unsigned int j_end)
+        {
+            for(unsigned int j = j_begin; j < j_end; ++j)
+            {
+                unsigned int row = flip ? height - 1 - j : j;
+                first_channel(pixels + (size_t)j * width * nb_channels, nb_channels, width, divisor, heights + (size_t)row * width);
+            }
+        });
+    }
+
+    bool read_binary(const std::string &path, std::vector<unsigned char> &content)
+    {
+        FILE *file = fopen(path.c_str(), "rb");
+        if(file == nullptr)
+            return false;
+        fseek(file, 0, SEEK_END);
+        long size = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        content.resize(size > 0 ? size : 0);
+        bool read = size >= 0 && fread(content.data(), 1, content.size(), file) == content.size();
+        fclose(file);
+        return read;
+    }
+
+    // PFM : "Pf" (gray) or "PF" (rgb), the size, a scale whose sign gives the endianness, then the rows from the bottom
+    bool load_pfm(const std::string &path, std::vector<float> &heights, unsigned int *width, unsigned int *height, bool flip)
+    {
+        std::vector<unsigned char> content;
+        if(!read_binary(path, content))
+            return false;
+        content.push_back(0);
+
+        char type[3] = {};
+        unsigned int w = 0, h = 0;
+        float scale = 0.0f;
+        int header_size = 0;
+        if(sscanf((const char *)content.data(), "%2s %u %u %f%n", type, &w, &h, &scale, &header_size) != 4 || scale == 0.0f
+            || (std::strcmp(type, "Pf") != 0 && std::strcmp(type, "PF") != 0))
+            return false;
+        ++header_size;  // single whitespace before the data
+
+        unsigned int nb_channels = type[1] == 'f' ? 1 : 3;
+        size_t nb_values = (size_t)w * h * nb_channels;
+        if(content.size() - 1 < header_size + nb_values * sizeof(float))
+            return false;
+
+        std::vector<float> values(nb_values);
+        std::memcpy(values.data(), content.data() + header_size, nb_values * sizeof(float));
+        if(scale > 0.0f)
+        {
+            for(float &value : values)
+            {
+                unsigned char *bytes = (unsigned char *)&value;
+                std::swap(bytes[0], bytes[3]);
+                std::swap(bytes[1], bytes[2]);
+            }
+        }
+
+        *width = w;
+        *height = h;
+        heights.resize((size_t)w * h);
+        convert_rows(values.data(), w, h, nb_channels, 1.0f, !flip, heights.data());
+        return true;
+    }
+
+    bool load_raw(const std::string &path, bool r16, std::vector<float> &heights, unsigned int *width, unsigned int *height, bool flip)
+    {
+        std::vector<unsigned char> content;
+        if(!read_binary(path, content))
+            return false;
+
+        size_t element_size = r16 ? sizeof(std::uint16_t) : sizeof(float);
+        size_t nb_values = content.size() / element_size;
+        if((size_t)(*width) * (*height) != nb_values)
+        {
+            unsigned int side = (unsigned int)std::sqrt((double)nb_values);
+            while((size_t)side * side < nb_values)
+                ++side;
+            if((size_t)side * side != nb_values)
+                return false;
+            *width = side;
+            *height = side;
+        }
+        if(content.size() != nb_values * element_size || nb_values == 0)
+            return false;
+
+        heights.resize(nb_values);
+        if(r16)
+        {
+            std::vector<std::uint16_t> values(nb_values);
+            std::memcpy(values.data(), content.data(), content.size());
+            convert_rows(values.data(), *width, *height, 1, 65535.0f, flip, heights.data());
+        }
+        else
+        {
+            std::vector<float> values(nb_values);
+            std::memcpy(values.data(), content.data(), content.size());
+            convert_rows(values.data(), *width, *height, 1, 1.0f, flip, heights.data());
+        }
+        return true;
+    }
+
+    // values mapped from [min, max] to [0, 65535], rows from the top of the picture (last grid row first)
+    std::vector<std::uint16_t> quantize_rows(const std::vector<float> &data, unsigned int width, unsigned int height)
+    {
+        float max = *std::max_element(data.begin(), data.end());
+        float min = *std::min_element(data.begin(), data.end());
+        float scale = max > min ? 65535.0f / (max - min) : 0.0f;
+
+        std::vector<std::uint16_t> quantized(data.size());
+        util::parallel_for(0, height, [&](unsigned int j_begin, unsigned int j_end)
+        {
+            for(unsigned int j = j_begin; j < j_end; ++j)
+            {
+                const float *row = &data[(size_t)(height - 1 - j) * width];
+                std::uint16_t *out = &quantized[(size_t)j * width];
+                for(unsigned int i = 0; i < width; ++i)
+                    out[i] = (std::uint16_t)((row[i] - min) * scale + 0.5f);
+            }
+        });
+        return quantized;
+    }
+
+    std::uint32_t crc32(const unsigned char *data, size_t size, std::uint32_t crc = 0)
+    {
+        // filled once, the initialization of a local static is thread safe : the PNG layers are encoded concurrently
+        static const std::array<std::uint32_t, 256> table = []()
+        {
+            std::array<std::uint32_t, 256> table;
+            for(std::uint32_t n = 0; n < 256; ++n)
+            {
+                std::uint32_t c = n;
+                for(int k = 0; k < 8; ++k)
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                table[n] = c;
+            }
+            return table;
+        }();
+
+        crc = ~crc;
+        for(size_t i = 0; i < size; ++i)
+            crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    void put32(std::vector<unsigned char> &out, std::uint32_t value)
+    {
+        out.push_back(value >> 24);
+        out.push_back((value >> 16) & 0xFF);
+        out.push_back((value >> 8) & 0xFF);
+        out.push_back(value & 0xFF);
+    }
+
+    void put_chunk(std::vector<unsigned char> &out, const char *type, const unsigned char *data, size_t size)
+    {
+        put32(out, size);
+        size_t start = out.size();
+        out.insert(out.end(), type, type + 4);
+        out.insert(out.end(), data, data + size);
+        put32(out, crc32(&out[start], size + 4));
+    }
+
+    // PNG row filter (none, sub, up, average, paeth) of a row of bytes with bpp bytes per pixel
+    unsigned char filtered(int filter, const unsigned char *row, const unsigned char *previous, size_t i, size_t bpp)
+    {
+        int a = i >= bpp ? row[i - bpp] : 0;
+        int b = previous != nullptr ? previous[i] : 0;
+        int c = i >= bpp && previous != nullptr ? previous[i - bpp] : 0;
+        switch(filter)
+        {
+            case 1: return row[i] - a;
+            case 2: return row[i] - b;
+            case 3: return row[i] - ((a + b) >> 1);
+            case 4:
+            {
+                int p = a + b - c;
+                int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+                return row[i] - (pa <= pb && pa <= pc ? a : pb <= pc ? b : c);
+            }
+            default: return row[i];
+        }
+    }
+}
+
 std::vector<unsigned char> image_io::load(const std::string &path, unsigned int *width, unsigned int *height, unsigned int *nb_channels, bool flip)
 {
     std::vector<unsigned char> image;
@@ -16,38 +244,234 @@ std::vector<unsigned char> image_io::load(const std::string &path, unsigned int
     return image;
 }
 
-void image_io::write_gray(const std::string &path, const std::vector<float> &data, unsigned int width, unsigned int height)
+std::vector<unsigned char> image_io::gray_pixels(const std::vector<float> &data, unsigned int width, unsigned int height)
 {
     assert(data.size() == width * height && "data size does not match dimensions");
-    std::vector<unsigned char> normalized_data;
-    normalized_data.reserve(width * height * 4);
+    std::vector<unsigned char> pixels(data.size() * 4);
     float max = *std::max_element(data.begin(), data.end());
     float min = *std::min_element(data.begin(), data.end());
 
-    for(unsigned int i = 0; i < width * height; ++i)
+    util::parallel_for(0, data.size(), [&](unsigned int begin, unsigned int end)
+    {
+        for(unsigned int i = begin; i < end; ++i)
+        {
+            unsigned char value = 255 * ((data[i] - min) / (max - min));
+            for(unsigned int j = 0; j < 3; ++j)
+                pixels[4 * i + j] = value;
+            pixels[4 * i + 3] = 255;
+        }
+    }, 4096);
+    return pixels;
+}
+
+std::vector<unsigned char> image_io::color_pixels(const std::vector<Color> &data, unsigned int width, unsigned int height)
+{
+    assert(data.size() == width * height && "data size does not match dimensions");
+    std::vector<unsigned char> pixels(data.size() * 4);
+    util::parallel_for(0, data.size(), [&](unsigned int begin, unsigned int end)
+    {
+        for(unsigned int i = begin; i < end; ++i)
+        {
+            for(size_t j = 0; j < 4; ++j)
+                pixels[4 * i + j] = data[i][j] * 255;
+        }
+    }, 4096);
+    return pixels;
+}
+
+// the rows are given bottom up through a negative stride instead of stbi_flip_vertically_on_write, whose global
+// flag would make concurrent writes race
+bool image_io::write_png(const std::string &path, const std::vector<unsigned char> &pixels, unsigned int width, unsigned int height, unsigned int nb_channels)
+{
+    assert(pixels.size() == width * height * nb_channels && "pixel array size does not match dimensions");
+    int stride = width * nb_channels;
+    if(!stbi_write_png(path.c_str(), width, height, nb_channels, pixels.data() + (size_t)(height - 1) * stride, -stride))
     {
-        unsigned char value = 255 * ((data.at(i) - min) / (max - min));
-        for(unsigned int j = 0; j < 3; ++j)
-            normalized_data.push_back(value);
-        normalized_data.push_back(255);
+        fprintf(stderr, "[IMAGE WRITER] - could not write %s\n", path.c_str());
+        return false;
     }
+    return true;
+}
 
-    stbi_flip_vertically_on_write(true);
-    stbi_write_png(path.c_str(), width, height, 4, &normalized_data[0], width * sizeof(unsigned char) * 4);
+void image_io::write_gray(const std::string &path, const std::vector<float> &data, unsigned int width, unsigned int height)
+{
+    write_png(path, gray_pixels(data, width, height), width, height, 4);
 }
 
 void image_io::write_color(const std::string &path, const std::vector<Color> &data, unsigned int width, unsigned int height)
+{
+    write_png(path, color_pixels(data, width, height), width, height, 4);
+}
+
+bool image_io::load_heights(const std::string &path, std::vector<float> &heights, unsigned int *width, unsigned int *height, bool flip)
+{
+    std::string type = extension(path);
+    bool loaded = false;
+    if(type == "pfm")
+        loaded = load_pfm(path, heights, width, height, flip);
+    else if(type == "r16" || type == "r32" || type == "raw")
+        loaded = load_raw(path, type == "r16", heights, width, height, flip);
+    else
+    {
+        int w = 0, h = 0, nb_channels = 0;
+        stbi_set_flip_vertically_on_load(false);
+        if(stbi_is_16_bit(path.c_str()))
+        {
+            stbi_us *pixels = stbi_load_16(path.c_str(), &w, &h, &nb_channels, 0);
+            if(pixels != nullptr)
+            {
+                heights.resize((size_t)w * h);
+                convert_rows(pixels, w, h, nb_channels, 65535.0f, flip, heights.data());
+                stbi_image_free(pixels);
+                loaded = true;
+            }
+        }
+        else
+        {
+            unsigned char *pixels = stbi_load(path.c_str(), &w, &h, &nb_channels, 0);
+            if(pixels != nullptr)
+            {
+                heights.resize((size_t)w * h);
+                convert_rows(pixels, w, h, nb_channels, 255.0f, flip, heights.data());
+                stbi_image_free(pixels);
+                loaded = true;
+            }
+        }
+        *width = w;
+        *height = h;
+    }
+
+    if(!loaded)
+    {
+        fprintf(stderr, "[IMAGE LOADER] - could not load height map %s\n", path.c_str());
+        return false;
+    }
+    printf("[IMAGE LOADER] - height map loaded %s %d %d\n", path.c_str(), *width, *height);
+    return true;
+}
+
+// stb_image_write only writes 8 bit PNG : the rows are filtered here, each with the filter giving the smallest
+// sum of absolute differences (like libpng), then compressed with the deflate of stb
+bool image_io::write_gray16(const std::string &path, const std::vector<float> &data, unsigned int width, unsigned int height)
+{
+    assert(data.size() == width * height && "data size does not match dimensions");
+    std::vector<std::uint16_t> quantized = quantize_rows(data, width, height);
+
+    size_t row_size = (size_t)width * 2;
+    std::vector<unsigned char> bytes(row_size * height);
+    for(size_t v = 0; v < quantized.size(); ++v)
+    {
+        bytes[2 * v] = quantized[v] >> 8;
+        bytes[2 * v + 1] = quantized[v] & 0xFF;
+    }
+
+    std::vector<unsigned char> rows((row_size + 1) * height);
+    util::parallel_for(0, height, [&](unsigned int j_begin, unsigned int j_end)
+    {
+        std::vector<unsigned char> candidate(row_size);
+        for(unsigned int j = j_begin; j < j_end; ++j)
+        {
+            const unsigned char *row = &bytes[j * row_size];
+            const unsigned char *previous = j > 0 ? row - row_size : nullptr;
+            unsigned char *out = &rows[j * (row_size + 1)];
+            long best_sum = -1;
+            for(int filter = 0; filter < 5; ++filter)
+            {
+                long sum = 0;
+                for(size_t i = 0; i < row_size; ++i)
+                {
+                    candidate[i] = filtered(filter, row, previous, i, 2);
+                    sum += std::abs((signed char)candidate[i]);
+                }
+                if(best_sum < 0 || sum < best_sum)
+                {
+                    best_sum = sum;
+                    out[0] = filter;
+                    std::copy(candidate.begin(), candidate.end(), out + 1);
+                }
+            }
+        }
+    });
+
+    int compressed_size = 0;
+    unsigned char *compressed = stbi_zlib_compress(rows.data(), rows.size(), &compressed_size, stbi_write_png_compression_level);
+    if(compressed == nullptr)
+        return false;
+
+    static const unsigned char signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+    std::vector<unsigned char> png(signature, signature + 8);
+    std::vector<unsigned char> header;
+    put32(header, width);
+    put32(header, height);
+    header.push_back(16);   // bit depth
+    header.push_back(0);    // grayscale
+    header.push_back(0);
+    header.push_back(0);
+    header.push_back(0);
+    put_chunk(png, "IHDR", header.data(), header.size());
+    put_chunk(png, "IDAT", compressed, compressed_size);
+    put_chunk(png, "IEND", nullptr, 0);
+    free(compressed);
+
+    FILE *file = fopen(path.c_str(), "wb");
+    if(file == nullptr)
+    {
+        fprintf(stderr, "[IMAGE WRITER] - could not write %s\n", path.c_str());
+        return false;
+    }
+    bool written = fwrite(png.data(), 1, png.size(), file) == png.size();
+    return fclose(file) == 0 && written;
+}
+
+bool image_io::write_pfm(const std::string &path, const std::vector<float> &data, unsigned int width, unsigned int height)
 {
     assert(data.size() == width * height && "data size does not match dimensions");
-    std::vector<unsigned char> normalized_data;
-    normalized_data.reserve(width * height * 4);
+    FILE *file = fopen(path.c_str(), "wb");
+    if(file == nullptr)
+    {
+        fprintf(stderr, "[IMAGE WRITER] - could not write %s\n", path.c_str());
+        return false;
+    }
+    // negative scale : little endian. PFM rows go from the bottom, like the grid
+    fprintf(file, "Pf\n%u %u\n-1.0\n", width, height);
+    bool written = fwrite(data.data(), sizeof(float), data.size(), file) == data.size();
+    return fclose(file) == 0 && written;
+}
+
+bool image_io::write_raw(const std::string &path, const std::vector<float> &data, unsigned int width, unsigned int height, bool r16)
+{
+    assert(data.size() == width * height && "data size does not match dimensions");
+    FILE *file = fopen(path.c_str(), "wb");
+    if(file == nullptr)
+    {
+        fprintf(stderr, "[IMAGE WRITER] - could not write %s\n", path.c_str());
+        return false;
+    }
 
-    for(unsigned int i = 0; i < width * height; ++i)
+    bool written = true;
+    if(r16)
+    {
+        std::vector<std::uint16_t> quantized = quantize_rows(data, width, height);
+        written = fwrite(quantized.data(), sizeof(std::uint16_t), quantized.size(), file) == quantized.size();
+    }
+    else
     {
-        for(size_t j = 0; j < 4; ++j)
-            normalized_data.push_back(data.at(i)[j] * 255);
+        // rows from the top of the picture, as in the images
+        for(unsigned int j = height; j-- > 0 && written;)
+            written = fwrite(&data[(size_t)j * width], sizeof(float), width, file) == width;
     }
+    return fclose(file) == 0 && written;
+}
 
-    stbi_flip_vertically_on_write(true);
-    stbi_write_png(path.c_str(), width, height, 4, &normalized_data[0], width * sizeof(unsigned char) * 4);
+bool image_io::write_heights(const std::string &path, const std::vector<float> &data, unsigned int width, unsigned int height, unsigned int bit_depth)
+{
+    std::string type = extension(path);
+    if(type == "pfm")
+        return write_pfm(path, data, width, height);
+    if(type == "r16" || type == "r32" || type == "raw")
+        return write_raw(path, data, width, height, type == "r16");
+    if(bit_depth == 16)
+        return write_gray16(path, data, width, height);
+    write_gray(path, data, width, height);
+    return true;
 }
\ No newline at end of file
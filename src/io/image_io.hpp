@@ -13,8 +13,28 @@
 namespace image_io
 {
     std::vector<unsigned char> load(const std::string &path, unsigned int *width, unsigned int *height, unsigned int *nb_channels, bool flip);
+    // RGBA pixels of the exported images : gray values normalized between the minimum and maximum, or colors
+    std::vector<unsigned char> gray_pixels(const std::vector<float> &data, unsigned int width, unsigned int height);
+    std::vector<unsigned char> color_pixels(const std::vector<Color> &data, unsigned int width, unsigned int height);
+    // first row at the bottom of the picture, safe to call from several threads
+    bool write_png(const std::string &path, const std::vector<unsigned char> &pixels, unsigned int width, unsigned int height, unsigned int nb_channels);
+
     void write_gray(const std::string &path, const std::vector<float> &data, unsigned int width, unsigned int height);
     void write_color(const std::string &path, const std::vector<Color> &data, unsigned int width, unsigned int height);
+
+    // single channel heights, the first row being the bottom of the picture when flip is set (as with load).
+    // 8 and 16 bit images and raw R16 (.r16) are normalized to [0, 1], PFM (.pfm) and raw R32F (.r32, .raw) are
+    // read as stored. Raw files have no header : width and height are used when they match the file size, else
+    // the grid is assumed square
+    bool load_heights(const std::string &path, std::vector<float> &heights, unsigned int *width, unsigned int *height, bool flip);
+
+    // heights normalized between their minimum and maximum, as a 16 bit grayscale PNG
+    bool write_gray16(const std::string &path, const std::vector<float> &data, unsigned int width, unsigned int height);
+    bool write_pfm(const std::string &path, const std::vector<float> &data, unsigned int width, unsigned int height);
+    // little endian R32F, or R16 normalized between the minimum and maximum
+    bool write_raw(const std::string &path, const std::vector<float> &data, unsigned int width, unsigned int height, bool r16);
+    // picks the format from the extension (.pfm, .r16, .r32 and .raw), PNG otherwise with the given bit depth
+    bool write_heights(const std::string &path, const std::vector<float> &data, unsigned int width, unsigned int height, unsigned int bit_depth = 8);
 };
 
 #endif
\ No newline at end of file
@@ -1,4 +1,6 @@
 #include <iostream>
+#include <memory>
+#include <cassert>
 
 #include "display.hpp"
 #include "model.hpp"
@@ -8,9 +10,14 @@
 #include "image.hpp"
 #include "heightfield.hpp"
 #include "terrain_gui.hpp"
+#include "layer_export.hpp"
+#include "terrain_builder.hpp"
 
 void update_controller_state(ControlState &controller_state, const MouseState &mouse_state, const KeyboardState &keyboard_state);
-Scene create_scene(TerrainGuiState &gui_state);
+TerrainJob make_job(const TerrainGuiState &gui_state);
+TerrainLayer displayed_layer(const TerrainGuiState &gui_state);
+Scene create_scene(TerrainBuild &build, LayerExporter &exporter);
+Texture create_layer_texture(TerrainBuild &build, LayerExporter &exporter);
 
 int main()
 {
@@ -23,7 +30,18 @@ int main()
     create_gui(display.window());
 
     /* === init scene === */
-    Scene scene = create_scene(gui_state);
+    // terrains are built in the background, the first one is waited for. The layer files are written by a single
+    // worker : successive builds write the same paths, in order
+    LayerExporter exporter(1);
+    TerrainBuilder builder;
+    builder.request(make_job(gui_state), displayed_layer(gui_state));
+    std::unique_ptr<TerrainBuild> terrain = builder.wait();
+    assert(terrain && "failed to build the initial terrain");
+    Scene scene = create_scene(*terrain, exporter);
+    StagingBuffer staging;
+    staging.init();
+    std::vector<unsigned int> patches;
+    std::vector<LodPatch> drawn_patches;
 
     /* === create controller === */
     OrbiterController controller({0.0f, 0.0f, 0.0f}, 0.01f, 0.005f, {0.5f, 0.5f, 0.0f});
@@ -58,14 +76,56 @@ int main()
         
         if(gui_state.update)
         {
-            scene.destroy();
-            scene = create_scene(gui_state);
+            builder.request(make_job(gui_state), displayed_layer(gui_state));
             gui_state.update = false;
         }
-        
+        if(gui_state.cancel)
+        {
+            builder.cancel();
+            gui_state.cancel = false;
+        }
+
+        // the previous terrain is drawn until the next one is built. A terrain of the same size only uploads the
+        // vertices of the patches around its changed cells, a road edit the corridor of the old and new roads
+        std::unique_ptr<TerrainBuild> build = builder.take();
+        if(build)
+        {
+            Model &model = scene.models().front();
+            if(model.same_topology(build->lod))
+            {
+                model.update(build->lod, build->lod.vertex_ranges(build->changed), staging);
+                model.set_texture(create_layer_texture(*build, exporter));
+            }
+            else
+            {
+                scene.destroy();
+                scene = create_scene(*build, exporter);
+            }
+            terrain = std::move(build);
+        }
+
+        TerrainBuilder::Status status = builder.status();
+        gui_state.building = status.busy;
+        gui_state.progress = status.progress;
+        gui_state.stage = stage_name(status.stage);
+
         /* === render scene === */
         scene.camera().aspect_ratio = display.aspect_ratio();
         scene.camera().update(controller.position, controller.direction, controller.up);
+
+        // patches of the terrain at the level of detail of the current view, without those outside of it. The
+        // projection spans twice the camera fov vertically
+        const Camera &camera = scene.camera();
+        terrain->lod.select(camera.position(), 2.0f * camera.fov, display.window_height(), gui_state.lod_error, patches);
+        CullStats cull_stats = terrain->lod.cull(Frustum(camera.projection() * camera.view()), patches);
+        gui_state.nb_patches_tested = cull_stats.nb_tested;
+        gui_state.nb_patches_culled = cull_stats.nb_culled;
+        drawn_patches.clear();
+        for(unsigned int patch : patches)
+            drawn_patches.push_back(terrain->lod.patches()[patch]);
+        scene.models().front().set_patches(drawn_patches);
+        gui_state.nb_triangles = terrain->lod.nb_triangles(patches);
+
         scene.draw();
 
         /* === render gui === */
@@ -76,81 +136,91 @@ int main()
     }
 
     /* === cleanup === */
+    staging.destroy();
     scene.destroy();
     display.destroy();
 
     return 0;
 }
 
-Scene create_scene(TerrainGuiState &gui_state)
+TerrainJob make_job(const TerrainGuiState &gui_state)
+{
+    TerrainJob job;
+    //job.height_map = "../data/image/test2.jpg";
+    //job.blur = 2;
+
+    job.k = gui_state.k;
+    job.n = gui_state.n;
+    job.thermal_quantity = gui_state.thermal_quantity;
+    job.nb_iterations = gui_state.nb_iterations;
+    job.water_level = gui_state.water_level;
+
+    job.x1 = gui_state.x1;
+    job.y1 = gui_state.y1;
+    job.x2 = gui_state.x2;
+    job.y2 = gui_state.y2;
+    job.width = gui_state.width;
+    job.slope_cost = gui_state.slope_cost;
+    job.water_low_cost = gui_state.water_low_cost;
+    job.water_high_cost = gui_state.water_high_cost;
+    job.water_treshold = gui_state.water_treshold;
+    return job;
+}
+
+TerrainLayer displayed_layer(const TerrainGuiState &gui_state)
+{
+    TerrainLayer layer = TerrainLayer::height;
+    if(gui_state.texture)
+        layer = TerrainLayer::texture;
+    if(gui_state.height)
+        layer = TerrainLayer::height;
+    if(gui_state.slope)
+        layer = TerrainLayer::slope;
+    if(gui_state.laplacian)
+        layer = TerrainLayer::laplacian;
+    if(gui_state.wetness)
+        layer = TerrainLayer::wetness;
+    if(gui_state.stream_areas)
+        layer = TerrainLayer::stream_areas;
+    return layer;
+}
+
+// uploads a finished build, the only part of a terrain update that runs on the main thread
+Scene create_scene(TerrainBuild &build, LayerExporter &exporter)
 {
     /* === create shaders === */
     Shader shader = make_shader("../data/shader/basic_vertex.vs", "../data/shader/basic_fragment.fs");
 
     /* === create camera === */
     Camera camera;
-    
-    /* === create instances === */
-    //Image height_map("../data/image/test2.jpg");
-    //HeightField field(height_map, 0.15f, {0.0f, 0.0f}, {1.0f, 1.0f});
-    //field.blur(2);
-    
-    HeightField field({0.0f, 0.0f}, {1.0f, 1.0f}, 250, 250);  
-    field.perlin_noise(10.0f, 10.0f, 0.1f);
-    
-    for(int i = 0; i < gui_state.nb_iterations; ++i)
-    {
-        field.thermal_erosion(gui_state.thermal_quantity);
-        field.stream_power_erosion(gui_state.k, gui_state.n);
-    }
 
-    field.fill(gui_state.water_level);
-
-    if(gui_state.x1 != gui_state.x2 || gui_state.y1 != gui_state.y2)
-        field.road(gui_state.x1, gui_state.y1, gui_state.x2, gui_state.y2, gui_state.width,
-            gui_state.slope_cost, gui_state.water_low_cost, gui_state.water_high_cost, gui_state.water_treshold);
+    /* === create instances === */
+    Texture texture = create_layer_texture(build, exporter);
+    Matrix4<float> transform = Identity<float>();
+    Model model = make_model(build.lod, {transform}, shader, texture);
+    return Scene({model}, camera);
+}
 
-    std::string texture_path = "../data/image/height.png";
-    if(gui_state.texture)
-    {
-        texture_path = "../data/image/texture.png";
-        field.export_texture(texture_path);
-    }
-    if(gui_state.height)
-    {
-        texture_path = "../data/image/height.png";
-        field.export_data(texture_path);
-    }
-    if(gui_state.slope)
-    {
-        texture_path = "../data/image/slope.png";
-        field.export_gradient(texture_path);
-    }
-    if(gui_state.laplacian)
-    {
-        texture_path = "../data/image/laplacian.png";
-        field.export_laplacian(texture_path);
-    }
-    if(gui_state.wetness)
+// the displayed layer is uploaded from memory, scalar layers as float textures colormapped by the shader. The file
+// of a finished build is written in the background, previews are only displayed
+Texture create_layer_texture(TerrainBuild &build, LayerExporter &exporter)
+{
+    const HeightField &field = build.field;
+    std::string layer_path = std::string("../data/image/") + layer_name(build.layer) + ".png";
+    Texture texture;
+    if(build.layer == TerrainLayer::texture)
     {
-        texture_path = "../data/image/wetness.png";
-        field.export_wetness(texture_path);
+        texture = make_texture(*build.layer_image);
+        if(!build.preview)
+            exporter.write_image(build.layer_image, layer_path);
     }
-    if(gui_state.stream_areas)
+    else
     {
-        texture_path = "../data/image/stream_areas.png";
-        field.export_stream_areas(texture_path);
+        texture = make_texture(util::GridView<const float>(build.layer_values.data(), field.nx(), field.ny()));
+        if(!build.preview)
+            exporter.write_values(std::move(build.layer_values), field.nx(), field.ny(), layer_path);
     }
-
-    std::vector<Vector3<float>> positions;
-    std::vector<Vector2<float>> texture_coords;
-    std::vector<unsigned int> indices;
-    field.polygonize(positions, texture_coords, indices);
-    Texture texture = make_texture(texture_path);
-    Matrix4<float> transform = Identity<float>();
-
-    Model model = make_model(positions, texture_coords, indices, {transform}, shader, texture);
-    return Scene({model}, camera);
+    return texture;
 }
 
 // binds keys / mouse to controllers actions
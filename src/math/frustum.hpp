@@ -0,0 +1,179 @@
+#ifndef MESHTOOL_FRUSTUM
+#define MESHTOOL_FRUSTUM
+
+#include <vector>
+#include <cmath>
+
+#include "vector.hpp"
+#include "matrix.hpp"
+
+#if defined(__GNUC__) && defined(__SSE__)
+#define MESHTOOL_FRUSTUM_SSE
+#include <xmmintrin.h>
+#endif
+
+// declarations
+
+// axis aligned boxes as a structure of arrays of centers and half extents, the layout of the batch test
+struct BoxBatch
+{
+    void clear();
+    void push_back(const Vector3<float> &box_min, const Vector3<float> &box_max);
+    unsigned int size() const;
+
+    std::vector<float> cx, cy, cz;
+    std::vector<float> ex, ey, ez;
+};
+
+struct CullStats
+{
+    unsigned int nb_tested = 0;
+    unsigned int nb_culled = 0;
+};
+
+// the six clipping planes of a projection * view matrix, a x + b y + c z + d >= 0 inside
+class Frustum
+{
+public:
+    explicit Frustum(const Matrix4<float> &view_projection);
+
+    // false when the box is entirely behind one of the planes. Conservative : boxes outside near an edge or a
+    // corner of the frustum can pass
+    bool intersects(const Vector3<float> &box_min, const Vector3<float> &box_max) const;
+    // appends the indices of the boxes intersecting the frustum to visible, 4 boxes per step with SSE
+    CullStats cull(const BoxBatch &boxes, std::vector<unsigned int> &visible) const;
+    // the same test one box at a time, the reference of the SSE path
+    CullStats cull_scalar(const BoxBatch &boxes, std::vector<unsigned int> &visible) const;
+
+public:
+    float planes[6][4];
+
+private:
+    void cull_scalar(const BoxBatch &boxes, unsigned int first, std::vector<unsigned int> &visible, CullStats &stats) const;
+};
+
+// definitions
+
+inline void BoxBatch::clear()
+{
+    cx.clear(); cy.clear(); cz.clear();
+    ex.clear(); ey.clear(); ez.clear();
+}
+
+inline void BoxBatch::push_back(const Vector3<float> &box_min, const Vector3<float> &box_max)
+{
+    cx.push_back(0.5f * (box_min.x + box_max.x));
+    cy.push_back(0.5f * (box_min.y + box_max.y));
+    cz.push_back(0.5f * (box_min.z + box_max.z));
+    ex.push_back(0.5f * (box_max.x - box_min.x));
+    ey.push_back(0.5f * (box_max.y - box_min.y));
+    ez.push_back(0.5f * (box_max.z - box_min.z));
+}
+
+inline unsigned int BoxBatch::size() const
+{
+    return cx.size();
+}
+
+// clip coordinates are rows of the matrix times the point : -w <= x, y, z <= w gives the planes as sums and
+// differences of the last row with the others
+inline Frustum::Frustum(const Matrix4<float> &view_projection)
+{
+    const float (&m)[4][4] = view_projection.m;
+    for(unsigned int axis = 0; axis < 3; ++axis)
+    {
+        for(unsigned int k = 0; k < 4; ++k)
+        {
+            planes[2 * axis][k] = m[3][k] + m[axis][k];
+            planes[2 * axis + 1][k] = m[3][k] - m[axis][k];
+        }
+    }
+
+    for(float (&plane)[4] : planes)
+    {
+        float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+        if(length > 0.0f)
+        {
+            for(float &value : plane)
+                value /= length;
+        }
+    }
+}
+
+inline bool Frustum::intersects(const Vector3<float> &box_min, const Vector3<float> &box_max) const
+{
+    for(const float (&plane)[4] : planes)
+    {
+        // corner of the box the furthest along the plane normal
+        float x = plane[0] > 0.0f ? box_max.x : box_min.x;
+        float y = plane[1] > 0.0f ? box_max.y : box_min.y;
+        float z = plane[2] > 0.0f ? box_max.z : box_min.z;
+        if(plane[0] * x + plane[1] * y + plane[2] * z + plane[3] < 0.0f)
+            return false;
+    }
+    return true;
+}
+
+inline CullStats Frustum::cull(const BoxBatch &boxes, std::vector<unsigned int> &visible) const
+{
+    CullStats stats;
+    stats.nb_tested = boxes.size();
+
+    // a box is outside a plane when its center is further behind it than the projection of its half extents
+    unsigned int b = 0;
+#ifdef MESHTOOL_FRUSTUM_SSE
+    for(; b + 4 <= boxes.size(); b += 4)
+    {
+        __m128 cx = _mm_loadu_ps(&boxes.cx[b]), cy = _mm_loadu_ps(&boxes.cy[b]), cz = _mm_loadu_ps(&boxes.cz[b]);
+        __m128 ex = _mm_loadu_ps(&boxes.ex[b]), ey = _mm_loadu_ps(&boxes.ey[b]), ez = _mm_loadu_ps(&boxes.ez[b]);
+        __m128 outside = _mm_setzero_ps();
+        for(const float (&plane)[4] : planes)
+        {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(plane[0])), _mm_mul_ps(cy, _mm_set1_ps(plane[1]))),
+                _mm_add_ps(_mm_mul_ps(cz, _mm_set1_ps(plane[2])), _mm_set1_ps(plane[3])));
+            __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, _mm_set1_ps(std::abs(plane[0]))), _mm_mul_ps(ey, _mm_set1_ps(std::abs(plane[1])))),
+                _mm_mul_ps(ez, _mm_set1_ps(std::abs(plane[2]))));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+        }
+
+        int mask = _mm_movemask_ps(outside);
+        for(unsigned int k = 0; k < 4; ++k)
+        {
+            if(mask & (1 << k))
+                ++stats.nb_culled;
+            else
+                visible.push_back(b + k);
+        }
+    }
+#endif
+    cull_scalar(boxes, b, visible, stats);
+    return stats;
+}
+
+inline CullStats Frustum::cull_scalar(const BoxBatch &boxes, std::vector<unsigned int> &visible) const
+{
+    CullStats stats;
+    stats.nb_tested = boxes.size();
+    cull_scalar(boxes, 0, visible, stats);
+    return stats;
+}
+
+inline void Frustum::cull_scalar(const BoxBatch &boxes, unsigned int first, std::vector<unsigned int> &visible, CullStats &stats) const
+{
+    for(unsigned int b = first; b < boxes.size(); ++b)
+    {
+        bool outside = false;
+        for(const float (&plane)[4] : planes)
+        {
+            float distance = (boxes.cx[b] * plane[0] + boxes.cy[b] * plane[1]) + (boxes.cz[b] * plane[2] + plane[3]);
+            float radius = (boxes.ex[b] * std::abs(plane[0]) + boxes.ey[b] * std::abs(plane[1])) + boxes.ez[b] * std::abs(plane[2]);
+            outside = outside || distance + radius < 0.0f;
+        }
+        if(outside)
+            ++stats.nb_culled;
+        else
+            visible.push_back(b);
+    }
+}
+
+#endif
@@ -202,6 +202,10 @@ std::ostream &operator<<(std::ostream &os, const Vector3<T> &vector)
     return os;
 }
 
+template<typename T>
+Vector2<T>::Vector2() : x(0.0), y(0.0)
+{}
+
 template<typename T>
 Vector2<T>::Vector2(const T &x, const T &y) : x(x), y(y)
 {}
@@ -0,0 +1,133 @@
+#include "depression.hpp"
+
+#include <math.h>
+#include <cassert>
+#include <queue>
+#include <limits>
+#include <algorithm>
+#include <functional>
+
+#include "stencil.hpp"
+
+namespace
+{
+    typedef std::pair<float, unsigned int> Level;
+    typedef std::priority_queue<Level, std::vector<Level>, std::greater<Level>> Heap;
+}
+
+void DepressionFilling::reset(const std::vector<float> &heights, unsigned int nx, unsigned int ny)
+{
+    assert(heights.size() == nx * ny && "height array size does not match the provided dimensions");
+    nx_ = nx;
+    ny_ = ny;
+    filled_ = heights;
+    closed_.assign(nx * ny, 0);
+    pit_.clear();
+}
+
+void DepressionFilling::compute(const std::vector<float> &heights, unsigned int nx, unsigned int ny, FilledSurface surface)
+{
+    reset(heights, nx, ny);
+
+    // the borders drain out of the grid
+    Stencil<stencil::M18> neighbors(nx, ny, 1.0f, 1.0f);
+    Heap open;
+    for(unsigned int c = 0; c < nx * ny; ++c)
+    {
+        unsigned int i = c % nx;
+        unsigned int j = c / nx;
+        if(i == 0 || j == 0 || i == nx - 1 || j == ny - 1)
+        {
+            closed_[c] = 1;
+            open.push(Level(heights[c], c));
+        }
+    }
+
+    // cells of the pit queue are at the current spill level (or just above it for the drained surface),
+    // they can be processed in any order before the next rising cell
+    unsigned int pit_begin = 0;
+    while(!open.empty() || pit_begin < pit_.size())
+    {
+        unsigned int c;
+        if(pit_begin < pit_.size())
+            c = pit_[pit_begin++];
+        else
+        {
+            c = open.top().second;
+            open.pop();
+            pit_.clear();
+            pit_begin = 0;
+        }
+
+        float level = filled_[c];
+        if(surface == FilledSurface::drained)
+            level = nextafterf(level, std::numeric_limits<float>::infinity());
+        neighbors.for_each(c % nx, c / nx, [&](unsigned int, unsigned int n)
+        {
+            if(closed_[n])
+                return;
+            closed_[n] = 1;
+            if(heights[n] <= level)
+            {
+                filled_[n] = level;
+                pit_.push_back(n);
+            }
+            else
+                open.push(Level(heights[n], n));
+        });
+    }
+}
+
+void DepressionFilling::compute_quantized(const std::vector<float> &heights, unsigned int nx, unsigned int ny, float step)
+{
+    assert(step > 0.0f && "quantization step must be positive");
+    reset(heights, nx, ny);
+    if(nx * ny == 0)
+        return;
+
+    float min_height = *std::min_element(heights.begin(), heights.end());
+    float max_height = *std::max_element(heights.begin(), heights.end());
+    unsigned int nb_levels = (unsigned int)((max_height - min_height) / step) + 1;
+    auto level_of = [&](float height)
+    {
+        return std::min(nb_levels - 1, (unsigned int)((height - min_height) / step));
+    };
+
+    // each bucket is a queue : cells pushed on the current level while it is processed are handled in the same pass
+    Stencil<stencil::M18> neighbors(nx, ny, 1.0f, 1.0f);
+    std::vector<std::vector<unsigned int>> buckets(nb_levels);
+    for(unsigned int c = 0; c < nx * ny; ++c)
+    {
+        unsigned int i = c % nx;
+        unsigned int j = c / nx;
+        if(i == 0 || j == 0 || i == nx - 1 || j == ny - 1)
+        {
+            closed_[c] = 1;
+            buckets[level_of(heights[c])].push_back(c);
+        }
+    }
+
+    for(unsigned int b = 0; b < nb_levels; ++b)
+    {
+        std::vector<unsigned int> &bucket = buckets[b];
+        for(unsigned int k = 0; k < bucket.size(); ++k)
+        {
+            unsigned int c = bucket[k];
+            float level = filled_[c];
+            neighbors.for_each(c % nx, c / nx, [&](unsigned int, unsigned int n)
+            {
+                if(closed_[n])
+                    return;
+                closed_[n] = 1;
+                filled_[n] = std::max(heights[n], level);
+                buckets[std::max(b, level_of(filled_[n]))].push_back(n);
+            });
+        }
+        std::vector<unsigned int>().swap(bucket);
+    }
+}
+
+const std::vector<float> &DepressionFilling::filled() const
+{
+    return filled_;
+}
@@ -0,0 +1,38 @@
+#ifndef MESHTOOL_DEPRESSION
+#define MESHTOOL_DEPRESSION
+
+#include <vector>
+#include <cstdint>
+
+enum class FilledSurface
+{
+    flat,       // depressions are raised to their spill level, lakes are flat
+    drained     // each filled cell is raised just above the cell it drains to, so water can cross lakes and flats
+};
+
+// priority flood (Barnes et al. 2014) over the 8-connected grid : cells are flooded from the borders in increasing
+// order of level, each cell taking the level of the cell it was reached from when it is lower
+class DepressionFilling
+{
+public:
+    // binary heap for the rising cells, plain queue for the cells inside depressions : O(N log N)
+    void compute(const std::vector<float> &heights, unsigned int nx, unsigned int ny, FilledSurface surface = FilledSurface::flat);
+
+    // bucket queue on levels multiple of step : O(N + nb levels). Exact when the heights are themselves multiples
+    // of step (e.g. 8 or 16 bit height maps). Otherwise the cells of a bucket are flooded in arrival order rather
+    // than by height, and a filled height is never below the one of compute() and at most step above it
+    void compute_quantized(const std::vector<float> &heights, unsigned int nx, unsigned int ny, float step);
+
+    const std::vector<float> &filled() const;
+
+private:
+    void reset(const std::vector<float> &heights, unsigned int nx, unsigned int ny);
+
+private:
+    unsigned int nx_ = 0, ny_ = 0;
+    std::vector<float> filled_;
+    std::vector<std::uint8_t> closed_;
+    std::vector<unsigned int> pit_;
+};
+
+#endif
@@ -0,0 +1,146 @@
+#include "dirty_region.hpp"
+
+#include <cassert>
+#include <algorithm>
+
+DirtyRegion::DirtyRegion()
+{}
+
+DirtyRegion::DirtyRegion(unsigned int nx, unsigned int ny, unsigned int tile_size)
+    : nx_(nx), ny_(ny), tile_size_(tile_size), nb_tiles_x_((nx + tile_size - 1) / tile_size), nb_tiles_y_((ny + tile_size - 1) / tile_size),
+    tiles_(nb_tiles_x_ * nb_tiles_y_, 0)
+{
+    assert(tile_size > 0 && "incorrect dirty region tile size");
+}
+
+unsigned int DirtyRegion::nx() const
+{
+    return nx_;
+}
+
+unsigned int DirtyRegion::ny() const
+{
+    return ny_;
+}
+
+unsigned int DirtyRegion::tile_size() const
+{
+    return tile_size_;
+}
+
+void DirtyRegion::add(const GridRect &rect)
+{
+    unsigned int i1 = std::min(rect.i1, nx_);
+    unsigned int j1 = std::min(rect.j1, ny_);
+    if(rect.i0 >= i1 || rect.j0 >= j1)
+        return;
+
+    for(unsigned int tj = rect.j0 / tile_size_; tj <= (j1 - 1) / tile_size_; ++tj)
+    {
+        for(unsigned int ti = rect.i0 / tile_size_; ti <= (i1 - 1) / tile_size_; ++ti)
+            tiles_[tj * nb_tiles_x_ + ti] = 1;
+    }
+}
+
+void DirtyRegion::add_all()
+{
+    std::fill(tiles_.begin(), tiles_.end(), 1);
+}
+
+void DirtyRegion::merge(const DirtyRegion &other)
+{
+    if(other.empty())
+        return;
+
+    if(other.nx_ != nx_ || other.ny_ != ny_ || other.tile_size_ != tile_size_)
+    {
+        *this = DirtyRegion(other.nx_, other.ny_, other.tile_size_);
+        add_all();
+        return;
+    }
+    for(std::size_t t = 0; t < tiles_.size(); ++t)
+        tiles_[t] |= other.tiles_[t];
+}
+
+void DirtyRegion::clear()
+{
+    std::fill(tiles_.begin(), tiles_.end(), 0);
+}
+
+bool DirtyRegion::empty() const
+{
+    return std::find(tiles_.begin(), tiles_.end(), 1) == tiles_.end();
+}
+
+bool DirtyRegion::all() const
+{
+    return std::find(tiles_.begin(), tiles_.end(), 0) == tiles_.end();
+}
+
+std::vector<GridRect> DirtyRegion::rects() const
+{
+    // runs of the previous row of tiles still open, in tiles
+    std::vector<GridRect> rects;
+    std::vector<GridRect> open;
+    for(unsigned int tj = 0; tj <= nb_tiles_y_; ++tj)
+    {
+        std::vector<GridRect> runs;
+        for(unsigned int ti = 0; tj < nb_tiles_y_ && ti < nb_tiles_x_; ++ti)
+        {
+            if(!tiles_[tj * nb_tiles_x_ + ti])
+                continue;
+            if(!runs.empty() && runs.back().i1 == ti)
+                ++runs.back().i1;
+            else
+                runs.push_back({ti, tj, ti + 1, tj + 1});
+        }
+
+        // a run with the same columns as an open one extends it, the others close
+        std::vector<GridRect> next;
+        for(GridRect &run : runs)
+        {
+            auto same = std::find_if(open.begin(), open.end(), [&run](const GridRect &o) { return o.i0 == run.i0 && o.i1 == run.i1; });
+            if(same != open.end())
+            {
+                run.j0 = same->j0;
+                same->i1 = same->i0;
+            }
+            next.push_back(run);
+        }
+        for(const GridRect &o : open)
+        {
+            if(o.i1 > o.i0)
+                rects.push_back(o);
+        }
+        open.swap(next);
+    }
+
+    for(GridRect &rect : rects)
+    {
+        rect.i0 *= tile_size_;
+        rect.j0 *= tile_size_;
+        rect.i1 = std::min(rect.i1 * tile_size_, nx_);
+        rect.j1 = std::min(rect.j1 * tile_size_, ny_);
+    }
+    return rects;
+}
+
+std::vector<VertexRange> coalesce_ranges(std::vector<VertexRange> ranges, unsigned int max_gap)
+{
+    std::sort(ranges.begin(), ranges.end(), [](const VertexRange &a, const VertexRange &b) { return a.first < b.first; });
+
+    std::vector<VertexRange> merged;
+    for(const VertexRange &range : ranges)
+    {
+        if(range.count == 0)
+            continue;
+        if(!merged.empty() && range.first <= merged.back().first + merged.back().count + max_gap)
+        {
+            unsigned int end = std::max(merged.back().first + merged.back().count, range.first + range.count);
+            merged.back().count = end - merged.back().first;
+        }
+        else
+            merged.push_back(range);
+    }
+    return merged;
+}
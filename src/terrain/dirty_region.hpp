@@ -0,0 +1,56 @@
+#ifndef MESHTOOL_DIRTY_REGION
+#define MESHTOOL_DIRTY_REGION
+
+#include <vector>
+
+// cells [i0, i1) x [j0, j1) of a grid
+struct GridRect
+{
+    unsigned int i0, j0;
+    unsigned int i1, j1;
+};
+
+// elements [first, first + count) of a buffer
+struct VertexRange
+{
+    unsigned int first;
+    unsigned int count;
+};
+
+// cells of a grid modified since the last clear, kept as a mask of square tiles : marking a rectangle is constant
+// time per tile and overlapping edits merge by themselves. An empty region of another size merges as a no-op, a
+// non empty one marks the whole grid
+class DirtyRegion
+{
+public:
+    DirtyRegion();
+    DirtyRegion(unsigned int nx, unsigned int ny, unsigned int tile_size = 32);
+
+    unsigned int nx() const;
+    unsigned int ny() const;
+    unsigned int tile_size() const;
+
+    // the rectangle is clamped to the grid
+    void add(const GridRect &rect);
+    void add_all();
+    void merge(const DirtyRegion &other);
+    void clear();
+
+    bool empty() const;
+    bool all() const;
+    // rectangles covering the dirty tiles : runs of tiles along a row of tiles, merged with the same runs of the
+    // rows above. Tile borders are clamped to the grid
+    std::vector<GridRect> rects() const;
+
+private:
+    unsigned int nx_ = 0, ny_ = 0;
+    unsigned int tile_size_ = 32;
+    unsigned int nb_tiles_x_ = 0, nb_tiles_y_ = 0;
+    std::vector<unsigned char> tiles_;
+};
+
+// sorted ranges, overlapping ones and those separated by at most max_gap elements merged : uploading a few clean
+// elements is cheaper than one more copy
+std::vector<VertexRange> coalesce_ranges(std::vector<VertexRange> ranges, unsigned int max_gap = 0);
+
+#endif
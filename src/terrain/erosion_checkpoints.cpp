@@ -0,0 +1,130 @@
+#include "erosion_checkpoints.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include "terrain_file.hpp"
+
+ErosionCheckpoints::ErosionCheckpoints(unsigned int interval, std::size_t max_bytes, const std::string &directory) :
+    interval_(interval), max_bytes_(max_bytes), directory_(directory)
+{}
+
+unsigned int ErosionCheckpoints::interval() const
+{
+    return interval_;
+}
+
+bool ErosionCheckpoints::due(int iteration) const
+{
+    return interval_ > 0 && iteration > 0 && iteration % interval_ == 0;
+}
+
+int ErosionCheckpoints::restore(std::uint64_t key, int iteration, HeightField &field) const
+{
+    std::size_t size = (std::size_t)field.nx() * field.ny();
+
+    // memory first : the last entry of this key not after iteration
+    int found = 0;
+    std::map<Key, std::vector<float>>::const_iterator it = heights_.upper_bound(Key(key, iteration));
+    if(it != heights_.begin())
+    {
+        --it;
+        if(it->first.first == key && it->second.size() == size)
+            found = it->first.second;
+    }
+
+    // files can hold later checkpoints, from previous sessions : the exact count, then the stored multiples
+    if(!directory_.empty() && found < iteration)
+    {
+        std::vector<int> candidates;
+        candidates.push_back(iteration);
+        if(interval_ > 0)
+        {
+            for(int i = iteration - iteration % (int)interval_; i > found; i -= interval_)
+                candidates.push_back(i);
+        }
+        for(int candidate : candidates)
+        {
+            if(candidate > found && load(key, candidate, field))
+                return candidate;
+        }
+    }
+
+    if(found > 0)
+    {
+        util::GridView<float> view = field.mutable_view();
+        std::memcpy(view.data(), it->second.data(), size * sizeof(float));
+        field.heights_changed();
+    }
+    return found;
+}
+
+void ErosionCheckpoints::store(std::uint64_t key, int iteration, const HeightField &field)
+{
+    // a grid larger than the whole budget would be copied only to be evicted right away, it is only written
+    Key index(key, iteration);
+    if(heights_.count(index) == 0 && field.data().size() * sizeof(float) <= max_bytes_)
+    {
+        std::vector<float> &heights = heights_[index];
+        heights = field.data();
+        order_.push_back(index);
+        bytes_ += heights.size() * sizeof(float);
+
+        while(bytes_ > max_bytes_ && !order_.empty())
+        {
+            std::map<Key, std::vector<float>>::iterator oldest = heights_.find(order_.front());
+            bytes_ -= oldest->second.size() * sizeof(float);
+            heights_.erase(oldest);
+            order_.pop_front();
+        }
+    }
+
+    if(directory_.empty())
+        return;
+
+    TerrainFileInfo info;
+    info.nx = field.nx();
+    info.ny = field.ny();
+    info.p_min = field.p_min();
+    info.p_max = field.p_max();
+    TerrainFileOptions options;
+    options.compress = true;
+    util::GridView<const float> heights(field.data().data(), field.nx(), field.ny());
+    if(!write_terrain_file(path(key, iteration), info, {{TerrainFileLayer::height, heights}}, options))
+        fprintf(stderr, "[EROSION] - could not write the checkpoint %s\n", path(key, iteration).c_str());
+}
+
+void ErosionCheckpoints::clear()
+{
+    heights_.clear();
+    order_.clear();
+    bytes_ = 0;
+}
+
+std::string ErosionCheckpoints::path(std::uint64_t key, int iteration) const
+{
+    char name[64];
+    snprintf(name, sizeof(name), "/erosion_%016llx_%d.mtf", (unsigned long long)key, iteration);
+    return directory_ + name;
+}
+
+bool ErosionCheckpoints::load(std::uint64_t key, int iteration, HeightField &field) const
+{
+    // missing checkpoints are expected, only existing files are opened
+    std::string file_path = path(key, iteration);
+    if(!std::ifstream(file_path).good())
+        return false;
+    TerrainFile file;
+    if(!file.open(file_path))
+        return false;
+
+    std::vector<float> heights;
+    if(file.info().nx != field.nx() || file.info().ny != field.ny() || !file.read_layer(TerrainFileLayer::height, heights))
+        return false;
+
+    util::GridView<float> view = field.mutable_view();
+    std::memcpy(view.data(), heights.data(), heights.size() * sizeof(float));
+    field.heights_changed();
+    return true;
+}
@@ -0,0 +1,49 @@
+#ifndef MESHTOOL_EROSION_CHECKPOINTS
+#define MESHTOOL_EROSION_CHECKPOINTS
+
+#include <map>
+#include <deque>
+#include <vector>
+#include <string>
+#include <utility>
+#include <cstdint>
+
+#include "heightfield.hpp"
+
+// heights saved during erosion runs, indexed by a hash of the parameters the run depends on and by the iteration
+// count. A run restarts from the latest checkpoint at or before its iteration count instead of the base terrain,
+// so asking for a few more iterations only computes those. Checkpoints are kept in memory up to a budget, and
+// in compressed terrain files when a directory is given
+class ErosionCheckpoints
+{
+public:
+    explicit ErosionCheckpoints(unsigned int interval = 10, std::size_t max_bytes = 64u << 20, const std::string &directory = "");
+
+    unsigned int interval() const;
+    // true when the state after this iteration should be stored
+    bool due(int iteration) const;
+
+    // replaces the heights of the field with the latest checkpoint at or before iteration, returns its iteration
+    // count. 0 when there is none and the field is unchanged
+    int restore(std::uint64_t key, int iteration, HeightField &field) const;
+    void store(std::uint64_t key, int iteration, const HeightField &field);
+
+    void clear();
+
+private:
+    typedef std::pair<std::uint64_t, int> Key;
+
+    std::string path(std::uint64_t key, int iteration) const;
+    bool load(std::uint64_t key, int iteration, HeightField &field) const;
+
+private:
+    unsigned int interval_;
+    std::size_t max_bytes_;
+    std::string directory_;
+
+    std::map<Key, std::vector<float>> heights_;
+    std::deque<Key> order_;     // insertion order, the oldest checkpoints are evicted first
+    std::size_t bytes_ = 0;
+};
+
+#endif
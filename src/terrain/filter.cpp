@@ -0,0 +1,133 @@
+#include "filter.hpp"
+
+#include <math.h>
+#include <cassert>
+#include <algorithm>
+
+#include "parallel.hpp"
+
+namespace
+{
+    // sums are kept in double so that adding and removing values along a long row does not drift
+    void blur_rows(util::GridView<const float> in, util::GridView<float> out, unsigned int radius)
+    {
+        unsigned int nx = in.width();
+        util::parallel_for(0, in.height(), [&](unsigned int j_begin, unsigned int j_end)
+        {
+            for(unsigned int j = j_begin; j < j_end; ++j)
+            {
+                const float *row = in.row(j);
+                float *out_row = out.row(j);
+
+                // window [i - radius, i + radius] clipped to [0, nx - 1]
+                double sum = 0.0;
+                unsigned int last = std::min(radius, nx - 1);
+                for(unsigned int i = 0; i <= last; ++i)
+                    sum += row[i];
+                for(unsigned int i = 0; i < nx; ++i)
+                {
+                    unsigned int first = i > radius ? i - radius : 0;
+                    out_row[i] = (float)(sum / (last - first + 1));
+                    if(last + 1 < nx)
+                        sum += row[++last];
+                    if(i >= radius)
+                        sum -= row[i - radius];
+                }
+            }
+        });
+    }
+
+    // same running sum along the columns for the grid rows [j_begin, j_end), in holding the grid rows starting at
+    // first_row. Each thread slides a whole block of columns at once so the inner loops run over contiguous memory
+    void blur_columns(util::GridView<const float> in, unsigned int first_row, unsigned int ny, unsigned int j_begin, unsigned int j_end,
+        util::GridView<float> out, unsigned int radius)
+    {
+        util::parallel_for(0, in.width(), [&](unsigned int i_begin, unsigned int i_end)
+        {
+            unsigned int width = i_end - i_begin;
+            auto in_row = [&](unsigned int j) { return in.row(j - first_row) + i_begin; };
+
+            std::vector<double> sums(width, 0.0);
+            unsigned int last = std::min(j_begin + radius, ny - 1);
+            for(unsigned int j = j_begin > radius ? j_begin - radius : 0; j <= last; ++j)
+            {
+                const float *row = in_row(j);
+                for(unsigned int i = 0; i < width; ++i)
+                    sums[i] += row[i];
+            }
+
+            for(unsigned int j = j_begin; j < j_end; ++j)
+            {
+                unsigned int first = j > radius ? j - radius : 0;
+                double inverse_count = 1.0 / (last - first + 1);
+                float *out_row = out.row(j - j_begin) + i_begin;
+                for(unsigned int i = 0; i < width; ++i)
+                    out_row[i] = (float)(sums[i] * inverse_count);
+
+                if(j + 1 == j_end)
+                    break;
+                if(last + 1 < ny)
+                {
+                    const float *row = in_row(++last);
+                    for(unsigned int i = 0; i < width; ++i)
+                        sums[i] += row[i];
+                }
+                if(j >= radius)
+                {
+                    const float *row = in_row(j - radius);
+                    for(unsigned int i = 0; i < width; ++i)
+                        sums[i] -= row[i];
+                }
+            }
+        }, 64);
+    }
+}
+
+// the clipped window of a cell is the product of its clipped row and column intervals, so averaging the rows
+// then the columns gives exactly the mean over the window
+void box_blur(std::vector<float> &values, unsigned int nx, unsigned int ny, unsigned int radius)
+{
+    assert(values.size() == nx * ny && "value array size does not match the provided dimensions");
+    if(radius == 0 || nx == 0 || ny == 0)
+        return;
+
+    std::vector<float> tmp(nx * ny);
+    blur_rows(util::GridView<const float>(values.data(), nx, ny), util::GridView<float>(tmp.data(), nx, ny), radius);
+    blur_columns(util::GridView<const float>(tmp.data(), nx, ny), 0, ny, 0, ny, util::GridView<float>(values.data(), nx, ny), radius);
+}
+
+void box_blur_band(util::GridView<const float> band, unsigned int first_row, unsigned int ny, unsigned int j_begin, unsigned int j_end,
+    util::GridView<float> out, unsigned int radius)
+{
+    assert(first_row <= (j_begin > radius ? j_begin - radius : 0) && first_row + band.height() >= std::min(j_end + radius, ny)
+        && "band does not hold the blur windows");
+    assert(out.width() == band.width() && out.height() == j_end - j_begin && "output size does not match the blurred rows");
+
+    std::vector<float> tmp(band.width() * band.height());
+    util::GridView<float> rows(tmp.data(), band.width(), band.height());
+    blur_rows(band, rows, radius);
+    blur_columns(rows, first_row, ny, j_begin, j_end, out, radius);
+}
+
+// box widths from "Fast almost-gaussian filtering" (Kovesi 2010) : the first m passes use the odd width just
+// below the ideal one, the others the next odd width, so that the variances add up to sigma^2
+void gaussian_blur(std::vector<float> &values, unsigned int nx, unsigned int ny, float sigma, unsigned int nb_passes)
+{
+    assert(nb_passes > 0 && "at least one box pass is needed");
+    if(sigma <= 0.0f)
+        return;
+
+    float variance = 12.0f * sigma * sigma;
+    float ideal_width = sqrt(variance / nb_passes + 1.0f);
+    int lower_width = (int)floor(ideal_width);
+    if(lower_width % 2 == 0)
+        --lower_width;
+    int nb_lower = (int)round((variance - nb_passes * lower_width * lower_width - 4 * nb_passes * lower_width - 3 * (int)nb_passes)
+        / (-4.0f * lower_width - 4.0f));
+
+    for(int pass = 0; pass < (int)nb_passes; ++pass)
+    {
+        int width = pass < nb_lower ? lower_width : lower_width + 2;
+        box_blur(values, nx, ny, (unsigned int)(width - 1) / 2);
+    }
+}
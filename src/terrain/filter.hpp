@@ -0,0 +1,20 @@
+#ifndef MESHTOOL_FILTER
+#define MESHTOOL_FILTER
+
+#include <vector>
+
+#include "grid_view.hpp"
+
+// mean over the (2 * radius + 1)^2 window of each cell, clipped to the grid. The filter is separable and uses
+// running sums, so its cost does not depend on the radius
+void box_blur(std::vector<float> &values, unsigned int nx, unsigned int ny, unsigned int radius);
+
+// box blur of the grid rows [j_begin, j_end) of a grid of ny rows, when only the rows [first_row, first_row + band.height())
+// are available (they must cover the windows of the blurred rows). Used to blur grids streamed band by band
+void box_blur_band(util::GridView<const float> band, unsigned int first_row, unsigned int ny, unsigned int j_begin, unsigned int j_end,
+    util::GridView<float> out, unsigned int radius);
+
+// gaussian of standard deviation sigma (in cells) approximated by nb_passes box blurs of matching variance
+void gaussian_blur(std::vector<float> &values, unsigned int nx, unsigned int ny, float sigma, unsigned int nb_passes = 3);
+
+#endif
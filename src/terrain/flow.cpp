@@ -0,0 +1,139 @@
+#include "flow.hpp"
+
+#include <cassert>
+#include <utility>
+
+#include "parallel.hpp"
+
+void FlowAccumulation::compute(const std::vector<float> &heights, unsigned int nx, unsigned int ny, float scale_x, float scale_y, FlowDirection direction)
+{
+    assert(heights.size() == nx * ny && "height array size does not match the provided dimensions");
+    nx_ = nx;
+    ny_ = ny;
+    stencil_ = Stencil<stencil::M18>(nx, ny, scale_x, scale_y);
+
+    compute_receivers(heights, direction);
+    accumulate(heights);
+}
+
+void FlowAccumulation::restore(std::vector<float> &&areas, unsigned int nx, unsigned int ny)
+{
+    assert(areas.size() == nx * ny && "area array size does not match the provided dimensions");
+    nx_ = nx;
+    ny_ = ny;
+    areas_ = std::move(areas);
+    receivers_.clear();
+    donors_.clear();
+}
+
+const std::vector<float> &FlowAccumulation::areas() const
+{
+    return areas_;
+}
+
+const std::vector<std::uint8_t> &FlowAccumulation::receivers() const
+{
+    return receivers_;
+}
+
+void FlowAccumulation::compute_receivers(const std::vector<float> &heights, FlowDirection direction)
+{
+    receivers_.assign(nx_ * ny_, 0);
+    donors_.assign(nx_ * ny_, 0);
+
+    util::parallel_for(0, ny_, [&](unsigned int j_begin, unsigned int j_end)
+    {
+        for(unsigned int j = j_begin; j < j_end; ++j)
+        {
+            for(unsigned int i = 0; i < nx_; ++i)
+            {
+                unsigned int c = j * nx_ + i;
+                float h = heights[c];
+                std::uint8_t mask = 0;
+                float steepest = 0.0f;
+                stencil_.for_each(i, j, [&](unsigned int k, unsigned int n)
+                {
+                    float slope = (heights[n] - h) * stencil_.inverse_distance(k);
+                    if(slope >= 0.0f)
+                        return;
+                    if(direction == FlowDirection::multiple)
+                        mask |= 1 << k;
+                    else if(slope < steepest)
+                    {
+                        steepest = slope;
+                        mask = 1 << k;
+                    }
+                });
+                receivers_[c] = mask;
+            }
+        }
+    });
+
+    // a cell's donors are the neighbors listing it as a receiver
+    util::parallel_for(0, ny_, [&](unsigned int j_begin, unsigned int j_end)
+    {
+        for(unsigned int j = j_begin; j < j_end; ++j)
+        {
+            for(unsigned int i = 0; i < nx_; ++i)
+            {
+                std::uint8_t count = 0;
+                stencil_.for_each(i, j, [&](unsigned int k, unsigned int n)
+                {
+                    if(receivers_[n] & (1 << stencil_.opposite(k)))
+                        ++count;
+                });
+                donors_[j * nx_ + i] = count;
+            }
+        }
+    });
+}
+
+void FlowAccumulation::accumulate(const std::vector<float> &heights)
+{
+    areas_.assign(nx_ * ny_, 1.0f);
+    stack_.resize(nx_ * ny_);
+
+    // cells are scanned in memory order : each source starts a cascade down to the first receiver still waiting
+    // for another donor, which keeps the accesses local compared to a breadth first traversal
+    unsigned int nb_processed = 0;
+    for(unsigned int source = 0; source < nx_ * ny_; ++source)
+    {
+        if(donors_[source] != 0)
+            continue;
+
+        unsigned int top = 0;
+        stack_[top++] = source;
+        donors_[source] = 1;    // never ready again
+        while(top > 0)
+        {
+            unsigned int c = stack_[--top];
+            ++nb_processed;
+            std::uint8_t mask = receivers_[c];
+            if(mask == 0)
+                continue;
+
+            float h = heights[c];
+            float total_slope = 0.0f;
+            for(unsigned int k = 0; k < 8; ++k)
+            {
+                if(mask & (1 << k))
+                    total_slope += (heights[c + stencil_.offset(k)] - h) * stencil_.inverse_distance(k);
+            }
+
+            for(unsigned int k = 0; k < 8; ++k)
+            {
+                if(!(mask & (1 << k)))
+                    continue;
+                unsigned int r = c + stencil_.offset(k);
+                float slope = (heights[r] - h) * stencil_.inverse_distance(k);
+                areas_[r] += areas_[c] * (slope / total_slope);
+                if(--donors_[r] == 0)
+                {
+                    stack_[top++] = r;
+                    donors_[r] = 1;
+                }
+            }
+        }
+    }
+    assert(nb_processed == nx_ * ny_ && "flow graph is not acyclic");
+}
@@ -0,0 +1,43 @@
+#ifndef MESHTOOL_FLOW
+#define MESHTOOL_FLOW
+
+#include <vector>
+#include <array>
+#include <cstdint>
+
+#include "stencil.hpp"
+
+enum class FlowDirection
+{
+    multiple,   // water is shared between all lower neighbors, proportionally to the slope
+    single      // D8 : all the water goes to the steepest lower neighbor
+};
+
+// flow accumulation over the 8-connected grid. Receivers and donors are computed once per height state,
+// then cells are visited in topological order (a cell is processed once all its donors are), which replaces
+// the sort of every cell by height.
+class FlowAccumulation
+{
+public:
+    void compute(const std::vector<float> &heights, unsigned int nx, unsigned int ny, float scale_x, float scale_y, FlowDirection direction);
+
+    // areas saved from an earlier compute(), the receivers are not restored
+    void restore(std::vector<float> &&areas, unsigned int nx, unsigned int ny);
+
+    const std::vector<float> &areas() const;
+    const std::vector<std::uint8_t> &receivers() const;
+
+private:
+    void compute_receivers(const std::vector<float> &heights, FlowDirection direction);
+    void accumulate(const std::vector<float> &heights);
+
+private:
+    unsigned int nx_ = 0, ny_ = 0;
+    Stencil<stencil::M18> stencil_;
+    std::vector<std::uint8_t> receivers_;    // bit k is set when neighbor k receives water from the cell
+    std::vector<std::uint8_t> donors_;       // number of neighbors sending water to the cell
+    std::vector<unsigned int> stack_;
+    std::vector<float> areas_;
+};
+
+#endif
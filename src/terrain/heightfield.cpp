@@ -1,4 +1,10 @@
 #include "heightfield.hpp"
+#include "parallel.hpp"
+#include "filter.hpp"
+#include "depression.hpp"
+#include "stencil.hpp"
+#include "tiled_field.hpp"
+#include "mesh.hpp"
 
 HeightField::HeightField(const Vector2<float> &p_min, const Vector2<float> &p_max, unsigned int nx, unsigned int ny)
     : ScalarField(p_min, p_max, nx, ny), water_(std::vector<float>(nx * ny, 0.0f))
@@ -7,14 +13,25 @@ HeightField::HeightField(const Vector2<float> &p_min, const Vector2<float> &p_ma
 HeightField::HeightField(const Image &height_map, float scale_z, const Vector2<float> &p_min, const Vector2<float> &p_max)
     : ScalarField(p_min, p_max, height_map.width(), height_map.height()), water_(std::vector<float>(height_map.width() * height_map.height(), 0.0f))
 {
-    std::vector<unsigned char> pixels = height_map.pixels();
-    std::vector<float> mapped_pixels;
-    mapped_pixels.reserve(nx_ * ny_);
-    for(unsigned int i = 0; i < nx_ * ny_ * height_map.nb_channels(); i += 3)
-        mapped_pixels.push_back((pixels.at(i) / 255.0f) * scale_z);
-    data_ = mapped_pixels;
+    // heights come from the first channel, read in place
+    util::GridView<const unsigned char> pixels = height_map.view();
+    util::GridView<float> heights = mutable_view();
+    util::parallel_for(0, ny_, [&](unsigned int j_begin, unsigned int j_end)
+    {
+        for(unsigned int j = j_begin; j < j_end; ++j)
+        {
+            const unsigned char *row = pixels.row(j);
+            float *out = heights.row(j);
+            for(unsigned int i = 0; i < nx_; ++i)
+                out[i] = (row[i * pixels.nb_channels()] / 255.0f) * scale_z;
+        }
+    });
 }
 
+HeightField::HeightField(std::vector<float> &&heights, const Vector2<float> &p_min, const Vector2<float> &p_max, unsigned int nx, unsigned int ny)
+    : ScalarField(std::move(heights), p_min, p_max, nx, ny), water_(std::vector<float>(nx * ny, 0.0f))
+{}
+
 void HeightField::polygonize(std::vector<Vector3<float>> &positions, std::vector<Vector2<float>> &texture_coords, std::vector<unsigned int> &indices) const
 {
     positions.clear();
@@ -52,63 +69,155 @@ void HeightField::polygonize(std::vector<Vector3<float>> &positions, std::vector
 
 void HeightField::perlin_noise(float fx, float fy, float height)
 {
-    assert(height > 0.0f && "incorrect height value");
-    for(unsigned int j = 0; j < ny_; ++j)
+    NoiseParameters parameters;
+    parameters.frequency_x = fx;
+    parameters.frequency_y = fy;
+    parameters.amplitude = height;
+    perlin_noise(parameters);
+}
+
+void HeightField::perlin_noise(const NoiseParameters &parameters)
+{
+    assert(parameters.amplitude > 0.0f && "incorrect height value");
+    NoiseGenerator generator(parameters.seed);
+    generator.generate(data_, nx_, ny_, parameters);
+    heights_changed();
+}
+
+void HeightField::thermal_erosion(float quantity, ThermalErosionMode mode, unsigned int tile_size)
+{
+    if(mode == ThermalErosionMode::parallel)
     {
-        for(unsigned int i = 0; i < nx_; ++i)
-            data_.at(index(i, j)) = (noise(i / (nx_ / fx), j / (ny_ / fy), 40)) / (1 / height);
+        thermal_erosion_parallel(quantity, tile_size);
+        return;
     }
+
+    std::vector<unsigned int> cells = sorted_cells();
+    Stencil<stencil::M14> stencil(nx_, ny_, scale_x_, scale_y_);
+
+    for(unsigned int c : cells)
+    {
+        // sediment goes to the neighbor of steepest descent
+        float h = data_[c];
+        float min_slope = 0.0f;
+        int lowest = -1;
+        stencil.for_each(c % nx_, c / nx_, [&](unsigned int k, unsigned int n)
+        {
+            float slope = (data_[n] - h) / stencil.distance(k);
+            if(slope < min_slope)
+            {
+                min_slope = slope;
+                lowest = n;
+            }
+        });
+        if(lowest >= 0)
+        {
+            float moved_sediment = data_[c] * quantity;
+            data_[lowest] += moved_sediment;
+            data_[c] -= moved_sediment;
+        }
+    }
+    heights_changed();
 }
 
-void HeightField::thermal_erosion(float quantity)
+// Jacobi version of the thermal erosion : each cell sends sediment to its lowest 4-neighbor according to the
+// previous heights, then each cell gathers what it received in a fixed neighbor order. Tiles are processed
+// independently, recomputing the outflows of a one cell halo instead of sharing them between threads.
+void HeightField::thermal_erosion_parallel(float quantity, unsigned int tile_size)
 {
-    std::vector<Cell> cells = sorted_cells();
+    Stencil<stencil::M14> stencil(nx_, ny_, scale_x_, scale_y_);
+    const unsigned char none = 4;
+
+    TileLayout layout(nx_, ny_, tile_size == 0 ? nx_ : std::min(tile_size, nx_), tile_size == 0 ? 1 : std::min(tile_size, ny_));
 
-    for(const Cell &cell : cells)
+    std::vector<float> next(nx_ * ny_);
+    layout.parallel_for_each([&](const Tile &tile)
     {
-        Vicinity vicinity = vicinity_M14(cell);
-        float min_slope = 1000000.0f;
-        unsigned int lowest_cell_index = 0;
-        for(unsigned int i = 0; i < vicinity.neighbors.size(); ++i)
+        int i0 = tile.i_begin;
+        int j0 = tile.j_begin;
+        int i1 = tile.i_end;
+        int j1 = tile.j_end;
+
+        // outflow direction of the tile cells and of their halo
+        int halo_width = i1 - i0 + 2;
+        std::vector<unsigned char> targets(halo_width * (j1 - j0 + 2), none);
+        for(int j = std::max(j0 - 1, 0); j < std::min(j1 + 1, (int)ny_); ++j)
         {
-            if(vicinity.neighbors.at(i).slope < min_slope)
+            for(int i = std::max(i0 - 1, 0); i < std::min(i1 + 1, (int)nx_); ++i)
             {
-                min_slope = vicinity.neighbors.at(i).slope;
-                lowest_cell_index = i;
+                float h = data_[j * nx_ + i];
+                float min_slope = 0.0f;
+                unsigned char target = none;
+                stencil.for_each(i, j, [&](unsigned int k, unsigned int n)
+                {
+                    float slope = (data_[n] - h) / stencil.distance(k);
+                    if(slope < min_slope)
+                    {
+                        min_slope = slope;
+                        target = k;
+                    }
+                });
+                targets[(j - j0 + 1) * halo_width + (i - i0 + 1)] = target;
             }
         }
-        const Cell &lowest_cell = vicinity.neighbors.at(lowest_cell_index);
-        if(lowest_cell.slope < 0)
+
+        // gather, neighbor k sends to this cell when its target is the opposite direction 3 - k
+        for(int j = j0; j < j1; ++j)
         {
-            float moved_sediment = data_.at(index(cell.i, cell.j)) * quantity;
-            data_.at(index(lowest_cell.i, lowest_cell.j)) += moved_sediment;
-            data_.at(index(cell.i, cell.j)) -= moved_sediment;
+            for(int i = i0; i < i1; ++i)
+            {
+                unsigned int c = j * nx_ + i;
+                int t = (j - j0 + 1) * halo_width + (i - i0 + 1);
+                float h = data_[c];
+                if(targets[t] != none)
+                    h -= data_[c] * quantity;
+                for(unsigned int k = 0; k < stencil.size; ++k)
+                {
+                    if(targets[t + stencil.dj(k) * halo_width + stencil.di(k)] == stencil.opposite(k))
+                        h += data_[c + stencil.offset(k)] * quantity;
+                }
+                next[c] = h;
+            }
         }
-    }
+    });
+
+    data_.swap(next);
+    heights_changed();
 }
 
 void HeightField::stream_power_erosion(float k, float n)
 {
-    std::vector<float> areas = stream_areas();
-    for(unsigned int j = 0; j < ny_; ++j)
+    const std::vector<float> &areas = stream_areas();
+    std::vector<float> cell_slopes = slopes();
+    util::parallel_for(0, nx_ * ny_, [&](unsigned int begin, unsigned int end)
     {
-        for(unsigned int i = 0; i < nx_; ++i)
-            data_.at(index(i, j)) -= k * std::pow(areas.at(index(i, j)), 0.5f) * std::pow(slope(i, j), n);            
-    }
+        for(unsigned int c = begin; c < end; ++c)
+            data_[c] -= k * std::pow(areas[c], 0.5f) * std::pow(cell_slopes[c], n);
+    }, 4096);
+    heights_changed();
 }
 
 void HeightField::road(unsigned int i, unsigned int j, unsigned int gi, unsigned int gj, int width,
-    float slope_cost, float water_low_cost, float water_high_cost, float water_treshold)
+    float slope_cost, float water_low_cost, float water_high_cost, float water_treshold, RoadSearch search)
 {
-    std::vector<Cell> path = shortest_path(i, j, gi, gj, slope_cost, water_low_cost, water_high_cost, water_treshold);
-    for(const Cell &cell : path)
+    RoadCosts costs;
+    costs.slope_cost = slope_cost;
+    costs.water_low_cost = water_low_cost;
+    costs.water_high_cost = water_high_cost;
+    costs.water_treshold = water_treshold;
+    std::vector<unsigned int> path = shortest_path(i, j, gi, gj, costs, search);
+    for(unsigned int cell : path)
     {
+        std::pair<unsigned int, unsigned int> ij = coords(cell);
+        int i0 = std::max(0, (int)ij.first - width);
+        int j0 = std::max(0, (int)ij.second - width);
+        heights_changed({(unsigned int)i0, (unsigned int)j0, ij.first + width + 1, ij.second + width + 1});
         for(int j = -width; j <= width; ++j)
         {
             for(int i = -width; i <= width; ++i)
             {
-                int sni = cell.i + i;
-                int snj = cell.j + j;
+                int sni = ij.first + i;
+                int snj = ij.second + j;
                 if(sni >= 0 && sni < (int)nx_ && snj >= 0 && snj < (int)ny_)
                 {
                     data_.at(index(sni, snj)) = -0.0005f + value(sni, snj) + water_.at(index(sni, snj)); // TODO : improve
@@ -121,302 +230,254 @@ void HeightField::road(unsigned int i, unsigned int j, unsigned int gi, unsigned
 
 void HeightField::blur(unsigned int size)
 {
-    std::vector<float> tmp;
-    tmp.reserve(nx_ * ny_);
-    for(unsigned int j = 0; j < ny_; ++j)
-    {
-        for(unsigned int i = 0; i < nx_; ++i)
-        {
-            unsigned int nb = 0;
-            float total = 0.0f;
-            for(int jk = -size; jk <= (int)size; ++jk)
-            {
-                int snj = j + jk;
-                if(snj >= 0 && snj < (int)ny_)
-                {
-                    for(int ik = -size; ik <= (int)size; ++ik)
-                    {
-                        int sni = i + ik;
-                        if(sni >= 0 && sni < (int)nx_)
-                        {
-                            ++nb;
-                            total += value((unsigned int)sni, (unsigned int)snj);
-                        }
-                    }
-                }
-            }
-            tmp.push_back(total / nb);
-        }
-    }
-    data_ = tmp;
+    box_blur(data_, nx_, ny_, size);
+    heights_changed();
 }
 
-void HeightField::fill(float height)
+void HeightField::gaussian_blur(float sigma)
 {
-    for(unsigned int i = 0; i < nx_ * ny_; ++i)
+    ::gaussian_blur(data_, nx_, ny_, sigma);
+    heights_changed();
+}
+
+void HeightField::fill(float height, bool lakes, float step)
+{
+    // sea below the given level, lakes up to the spill level of each closed depression
+    const std::vector<float> *levels = &data_;
+    DepressionFilling filling;
+    if(lakes)
     {
-        if(data_.at(i) < height)
-            water_.at(i) = height - data_.at(i);
+        if(step > 0.0f)
+            filling.compute_quantized(data_, nx_, ny_, step);
+        else
+            filling.compute(data_, nx_, ny_);
+        levels = &filling.filled();
     }
+
+    for(unsigned int i = 0; i < nx_ * ny_; ++i)
+        water_[i] = std::max(height, (*levels)[i]) - data_[i];
 }
 
-void HeightField::export_stream_areas(const std::string &path) const
+void HeightField::set_flow_direction(FlowDirection direction)
 {
-    std::vector<float> areas = stream_areas();
-    for(int i = 0; i < areas.size(); ++i)
-        areas.at(i) = sqrt(areas.at(i));
-    image_io::write_gray(path, areas, nx_, ny_);
+    if(direction == flow_direction_)
+        return;
+    flow_direction_ = direction;
+    heights_changed();
 }
 
-void HeightField::export_wetness(const std::string &path) const
+void HeightField::set_flow_routing(bool across_depressions)
 {
-    std::vector<float> areas = stream_areas();
-    for(unsigned int j = 0; j < ny_; ++j)
+    if(across_depressions == flow_across_depressions_)
+        return;
+    flow_across_depressions_ = across_depressions;
+    heights_changed();
+}
+
+std::vector<float> HeightField::layer_values(TerrainLayer layer) const
+{
+    switch(layer)
     {
-        for(unsigned int i = 0; i < nx_; ++i)
-            areas.at(index(i, j)) = sqrt(log(areas.at(index(i, j)) / (slope(i, j) + 0.00001f)));
+        case TerrainLayer::height: return data_;
+        case TerrainLayer::slope: return slopes();
+        case TerrainLayer::laplacian: return laplacians();
+        case TerrainLayer::wetness:
+        {
+            std::vector<float> areas = stream_areas();
+            std::vector<float> cell_slopes = slopes();
+            for(unsigned int c = 0; c < nx_ * ny_; ++c)
+                areas[c] = sqrt(log(areas[c] / (cell_slopes[c] + 0.00001f)));
+            return areas;
+        }
+        case TerrainLayer::stream_areas:
+        {
+            std::vector<float> areas = stream_areas();
+            for(unsigned int i = 0; i < areas.size(); ++i)
+                areas.at(i) = sqrt(areas.at(i));
+            return areas;
+        }
+        default:
+            assert(false && "the texture layer has colors, not values");
+            return std::vector<float>();
     }
-    image_io::write_gray(path, areas, nx_, ny_);
 }
 
-void HeightField::export_texture(const std::string &path) const
+std::vector<Color> HeightField::texture_colors() const
 {
     std::vector<Color> colors;
-    std::vector<float> areas = stream_areas();
+    const std::vector<float> &areas = stream_areas();
+    std::vector<float> cell_slopes = slopes();
 
     colors.reserve(nx_ * ny_);
 
-    for(unsigned int j = 0; j < ny_; ++j)
+    for(unsigned int c = 0; c < nx_ * ny_; ++c)
     {
-        for(unsigned int i = 0; i < nx_; ++i)
-        {
-            Color water_color = (Color(0.5f, 0.6f, 1.0f));
-            Color rock_color = Color(0.9f, 0.7f, 0.3f) * slope(i, j);
-            Color vegetation_color = Color(0.4f, 0.8f, 0.2f) * (1.0f - slope(i, j));
-            Color final_color = (vegetation_color + rock_color) - log(areas.at(index(i, j)) / (slope(i, j) + 0.00001f)) / 10.0f;
-            final_color = mix(final_color, water_color, water_.at(index(i, j)) * 50.0f);
-            colors.push_back(final_color);
-        }
+        Color water_color = (Color(0.5f, 0.6f, 1.0f));
+        Color rock_color = Color(0.9f, 0.7f, 0.3f) * cell_slopes[c];
+        Color vegetation_color = Color(0.4f, 0.8f, 0.2f) * (1.0f - cell_slopes[c]);
+        Color final_color = (vegetation_color + rock_color) - log(areas[c] / (cell_slopes[c] + 0.00001f)) / 10.0f;
+        final_color = mix(final_color, water_color, water_[c] * 50.0f);
+        colors.push_back(final_color);
     }
-    image_io::write_color(path, colors, nx_, ny_);
+    return colors;
 }
 
-Vector3<float> HeightField::normal(unsigned int i, unsigned int j) const
+Image HeightField::layer_image(TerrainLayer layer) const
 {
-    Vector2<float> grad = gradient(i, j);
-    return normalize(Vector3<float>(-grad.x, -grad.y, 1.0f));
+    std::vector<unsigned char> pixels = layer == TerrainLayer::texture ? image_io::color_pixels(texture_colors(), nx_, ny_)
+        : image_io::gray_pixels(layer_values(layer), nx_, ny_);
+    return Image(std::move(pixels), nx_, ny_, 4);
 }
 
-Vector3<float> HeightField::point(unsigned int i, unsigned int j) const
+void HeightField::export_stream_areas(const std::string &path) const
 {
-    return Vector3<float>(i * scale_x_, j * scale_y_, value(i, j));
+    image_io::write_gray(path, layer_values(TerrainLayer::stream_areas), nx_, ny_);
 }
 
-std::vector<HeightField::Cell> HeightField::sorted_cells() const
+void HeightField::export_wetness(const std::string &path) const
 {
-    std::vector<Cell> cells;
-    cells.reserve(nx_ * ny_);
-    
-    for(unsigned int j = 0; j < ny_; ++j)
-    {
-        for(unsigned int i = 0; i < nx_; ++i)
-            cells.push_back({i, j, value(i, j), 0.0f});
-    }
+    image_io::write_gray(path, layer_values(TerrainLayer::wetness), nx_, ny_);
+}
 
-    std::sort(cells.begin(), cells.end(), 
-        [](const Cell &lhs, const Cell &rhs)
-        {
-            return lhs.height > rhs.height;
-        }
-    );
+void HeightField::export_texture(const std::string &path) const
+{
+    image_io::write_color(path, texture_colors(), nx_, ny_);
+}
 
-    return cells;
+Vector3<float> HeightField::normal(unsigned int i, unsigned int j) const
+{
+    return grid_normal(view(), scale_x_, scale_y_, i, j);
 }
 
-std::vector<float> HeightField::stream_areas() const
+std::vector<Vector3<float>> HeightField::normals() const
 {
-    std::vector<float> areas(nx_ * ny_, 1.0f);
-    std::vector<Cell> cells = sorted_cells();
-    
-    for(const Cell &cell : cells)
-    {
-        Vicinity vicinity = vicinity_M18(cell);
-        float total_slope = 0.0f;
-        for(unsigned int i = 0; i < vicinity.neighbors.size(); ++i)
-        {
-            if(vicinity.neighbors.at(i).slope < 0.0f)
-                total_slope += vicinity.neighbors.at(i).slope;
-        }
-        if(total_slope != 0.0f)
-        {
-            for(unsigned int i = 0; i < vicinity.neighbors.size(); ++i)
-            {
-                const Cell &n = vicinity.neighbors.at(i);
-                if(n.slope < 0.0f)
-                    areas.at(index(n.i, n.j)) += areas.at(index(cell.i, cell.j)) * (n.slope / total_slope);
-            }
-        }
-    }
-    return areas;
+    return grid_normals(view(), scale_x_, scale_y_);
 }
 
-float HeightField::directional_slope(unsigned int i, unsigned int j, unsigned int ni, unsigned int nj) const
+bool HeightField::save(const std::string &path, const TerrainFileOptions &options) const
 {
-    float distance = length(Vector2<float>(i * scale_x_, j * scale_y_) - Vector2<float>(ni * scale_x_, nj * scale_y_));
-    return (value(ni, nj) - value(i, j)) / distance;
+    TerrainFileInfo info;
+    info.nx = nx_;
+    info.ny = ny_;
+    info.p_min = p_min_;
+    info.p_max = p_max_;
+    info.flow_direction = flow_direction_;
+    info.flow_across_depressions = flow_across_depressions_;
+
+    std::vector<std::pair<TerrainFileLayer, util::GridView<const float>>> layers;
+    layers.push_back(std::make_pair(TerrainFileLayer::height, view()));
+    layers.push_back(std::make_pair(TerrainFileLayer::water, util::GridView<const float>(water_.data(), nx_, ny_)));
+    if(options.stream_areas)
+        layers.push_back(std::make_pair(TerrainFileLayer::stream_areas, util::GridView<const float>(stream_areas().data(), nx_, ny_)));
+    return write_terrain_file(path, info, layers, options);
 }
 
-HeightField::Vicinity HeightField::vicinity_M14(const Cell &cell) const
+bool HeightField::load(const std::string &path)
 {
-    Vicinity vicinity;
-    vicinity.neighbors.reserve(4);
-    for(int j = -1; j <= 1; ++j)
+    TerrainFile file;
+    if(!file.open(path))
+        return false;
+
+    const TerrainFileInfo &info = file.info();
+    std::vector<float> heights, water, areas;
+    if(!file.read_layer(TerrainFileLayer::height, heights))
     {
-        for(int i = -1; i <= 1; ++i)
-        {
-            if((i != 0 || j != 0) && (std::abs(i) + std::abs(j)) != 2)
-            {
-                int sni = cell.i + i;
-                int snj = cell.j + j;
-                if(sni >= 0 && sni < (int)nx_ && snj >= 0 && snj < (int)ny_)
-                {
-                    unsigned int ni = (unsigned int)sni;
-                    unsigned int nj = (unsigned int)snj;
-                    Cell n_cell = {ni, nj, value(ni, nj), directional_slope(cell.i, cell.j, ni, nj)};
-                    vicinity.neighbors.push_back(n_cell);
-                }
-            }
-        }
+        fprintf(stderr, "[HEIGHTFIELD] - %s has no readable height layer\n", path.c_str());
+        return false;
+    }
+    if(!file.has_layer(TerrainFileLayer::water))
+        water.assign(heights.size(), 0.0f);
+    else if(!file.read_layer(TerrainFileLayer::water, water))
+        return false;
+    bool has_areas = file.has_layer(TerrainFileLayer::stream_areas);
+    if(has_areas && !file.read_layer(TerrainFileLayer::stream_areas, areas))
+        return false;
+
+    data_.swap(heights);
+    water_.swap(water);
+    p_min_ = info.p_min;
+    p_max_ = info.p_max;
+    nx_ = info.nx;
+    ny_ = info.ny;
+    scale_x_ = (p_max_.x - p_min_.x) / (nx_ - 1);
+    scale_y_ = (p_max_.y - p_min_.y) / (ny_ - 1);
+    flow_direction_ = info.flow_direction;
+    flow_across_depressions_ = info.flow_across_depressions;
+
+    heights_changed();
+    if(has_areas)
+    {
+        flow_.restore(std::move(areas), nx_, ny_);
+        flow_valid_ = true;
     }
-    return vicinity;
+    return true;
 }
 
-HeightField::Vicinity HeightField::vicinity_M18(const Cell &cell) const
+Vector3<float> HeightField::point(unsigned int i, unsigned int j) const
 {
-    Vicinity vicinity;
-    vicinity.neighbors.reserve(8);
-    for(int j = -1; j <= 1; ++j)
-    {
-        for(int i = -1; i <= 1; ++i)
-        {
-            if(i != 0 || j != 0)
-            {
-                int sni = cell.i + i;
-                int snj = cell.j + j;
-                if(sni >= 0 && sni < (int)nx_ && snj >= 0 && snj < (int)ny_)
-                {
-                    unsigned int ni = (unsigned int)sni;
-                    unsigned int nj = (unsigned int)snj;
-                    Cell n_cell = {ni, nj, value(ni, nj), directional_slope(cell.i, cell.j, ni, nj)};
-                    vicinity.neighbors.push_back(n_cell);
-                }
-            }
-        }
-    }
-    return vicinity;
+    return Vector3<float>(i * scale_x_, j * scale_y_, value(i, j));
 }
 
-HeightField::Vicinity HeightField::vicinity_M2(const Cell &cell) const
+std::vector<unsigned int> HeightField::sorted_cells() const
 {
-    Vicinity vicinity;
-    vicinity.neighbors.reserve(16);
-    for(int j = -2; j <= 2; ++j)
-    {
-        for(int i = -2; i <= 2; ++i)
+    std::vector<unsigned int> cells(nx_ * ny_);
+    for(unsigned int c = 0; c < nx_ * ny_; ++c)
+        cells[c] = c;
+
+    std::sort(cells.begin(), cells.end(), 
+        [this](unsigned int lhs, unsigned int rhs)
         {
-            if(i != 0 || j != 0)
-            {
-                int sni = cell.i + i;
-                int snj = cell.j + j;
-                if(sni >= 0 && sni < (int)nx_ && snj >= 0 && snj < (int)ny_)
-                {
-                    unsigned int ni = (unsigned int)sni;
-                    unsigned int nj = (unsigned int)snj;
-                    Cell n_cell = {ni, nj, value(ni, nj), directional_slope(cell.i, cell.j, ni, nj)};
-                    if(abs(i) <= 1 && abs(j) <= 1)
-                        vicinity.neighbors.push_back(n_cell);
-                    else if(abs(i) + abs(j) == 3)
-                        vicinity.neighbors.push_back(n_cell);
-                }
-            }
+            return data_[lhs] > data_[rhs];
         }
-    }
-    return vicinity;
+    );
+
+    return cells;
 }
 
-HeightField::Vicinity HeightField::vicinity_M3(const Cell &cell) const
+const std::vector<float> &HeightField::stream_areas() const
 {
-    Vicinity vicinity;
-    vicinity.neighbors.reserve(32);
-    for(int j = -3; j <= 3; ++j)
+    if(!flow_valid_)
     {
-        for(int i = -3; i <= 3; ++i)
+        if(flow_across_depressions_)
         {
-            if(i != 0 || j != 0)
-            {
-                int sni = cell.i + i;
-                int snj = cell.j + j;
-                if(sni >= 0 && sni < (int)nx_ && snj >= 0 && snj < (int)ny_)
-                {
-                    unsigned int ni = (unsigned int)sni;
-                    unsigned int nj = (unsigned int)snj;
-                    Cell n_cell = {ni, nj, value(ni, nj), directional_slope(cell.i, cell.j, ni, nj)};
-                    if(abs(i) <= 1 && abs(j) <= 1)
-                        vicinity.neighbors.push_back(n_cell);
-                    else if((abs(i) == 2 || abs(j) == 2) && (abs(i) + abs(j) == 3))
-                        vicinity.neighbors.push_back(n_cell);
-                    else if((abs(i) == 3 || abs(j) == 3) && ((abs(i) + abs(j) == 4) || (abs(i) + abs(j) == 5)))
-                        vicinity.neighbors.push_back(n_cell);
-                }
-            }
+            // water crosses lakes and flats on a filled surface with a strict descent towards the outlet
+            DepressionFilling filling;
+            filling.compute(data_, nx_, ny_, FilledSurface::drained);
+            flow_.compute(filling.filled(), nx_, ny_, scale_x_, scale_y_, flow_direction_);
         }
+        else
+            flow_.compute(data_, nx_, ny_, scale_x_, scale_y_, flow_direction_);
+        flow_valid_ = true;
     }
-    return vicinity;
+    return flow_.areas();
 }
 
-DijkstraAdjacencyList HeightField::create_graph(float slope_cost, float water_low_cost, float water_high_cost, float water_treshold) const
+void HeightField::heights_changed()
 {
-    DijkstraAdjacencyList list(nx_ * ny_);
-    for(unsigned int j = 0; j < ny_; ++j)
-    {
-        for(unsigned int i = 0; i < nx_; ++i)
-        {
-            Cell cell = {i, j, value(i, j), slope(i, j)};
-            Vicinity vicinity = vicinity_M2(cell);
-            for(unsigned int k = 0; k < vicinity.neighbors.size(); ++k)
-            {
-                const Cell &neighbor = vicinity.neighbors.at(k);
-                float distance = length(point(neighbor.i, neighbor.j) - point(i, j));
-                float neighbor_slope = std::abs(slope(neighbor.i, neighbor.j));
-                float water;
-                if(water_.at(index(i, j)) < water_treshold)
-                    water = water_.at(index(i, j)) * water_low_cost;
-                else
-                    water = water_.at(index(i, j)) * water_high_cost;
-
-                float cost = distance * (1 + (neighbor_slope * slope_cost) + water);
-                list.at(index(i, j)).push_back(DijkstraNeighbor(index(neighbor.i, neighbor.j), cost));
-            }
-        }
-    }
-    return list;
+    heights_changed({0, 0, nx_, ny_});
 }
 
-std::vector<HeightField::Cell> HeightField::shortest_path(unsigned int i, unsigned int j, unsigned int gi, unsigned int gj,
-    float slope_cost, float water_low_cost, float water_high_cost, float water_treshold) const
+void HeightField::heights_changed(const GridRect &rect)
 {
-    std::vector<Cell> cells;
-    DijkstraAdjacencyList adjacency_list = create_graph(slope_cost, water_low_cost, water_high_cost, water_treshold);
-    std::vector<DijkstraWeight> min_distance;
-    std::vector<DijkstraVertex> previous;
-    compute_paths(index(i, j), adjacency_list, min_distance, previous);
-    std::list<DijkstraVertex> path = get_shortest_path_to(index(gi, gj), previous);
-    cells.reserve(path.size());
-    for(const DijkstraVertex &vertex : path)
-    {
-        std::pair<unsigned int, unsigned int> ij = coords(vertex);
-        Cell cell = {ij.first, ij.second, value(ij.first, ij.second), slope(ij.first, ij.second)};
-        cells.push_back(cell);
-    }
-    return cells;
+    flow_valid_ = false;
+    if(dirty_.nx() != nx_ || dirty_.ny() != ny_)
+        dirty_ = DirtyRegion(nx_, ny_);
+    dirty_.add(rect);
+}
+
+const DirtyRegion &HeightField::dirty_region() const
+{
+    return dirty_;
+}
+
+void HeightField::clear_dirty_region()
+{
+    dirty_.clear();
+}
+
+std::vector<unsigned int> HeightField::shortest_path(unsigned int i, unsigned int j, unsigned int gi, unsigned int gj, const RoadCosts &costs, RoadSearch search) const
+{
+    std::vector<float> cell_slopes = slopes();
+    RoadPlanner planner(data_, water_, cell_slopes, nx_, ny_, scale_x_, scale_y_);
+    return planner.find_path(index(i, j), index(gi, gj), costs, search);
 }
\ No newline at end of file
@@ -4,61 +4,102 @@
 #include <array>
 
 #include "scalarfield.hpp"
-#include "perlin_noise.hpp"
-#include "dijkstra.hpp"
+#include "noise.hpp"
+#include "flow.hpp"
+#include "road_planner.hpp"
 #include "image.hpp"
 #include "color.hpp"
+#include "terrain_file.hpp"
+#include "dirty_region.hpp"
 
-class HeightField : public ScalarField
-{
-struct Cell
+enum class ThermalErosionMode
 {
-    unsigned int i, j;
-    float height;
-    float slope;
+    sequential,     // cells are eroded one after the other from the highest, each seeing the previous updates
+    parallel        // every cell reads the heights of the previous step, the result does not depend on the thread count
 };
 
-struct Vicinity
+// maps derived from the field, displayed by the viewer and exported by the jobs
+enum class TerrainLayer
 {
-    std::vector<Cell> neighbors;
+    texture,
+    height,
+    slope,
+    laplacian,
+    wetness,
+    stream_areas
 };
 
+class HeightField : public ScalarField
+{
 public:
     HeightField(const Vector2<float> &p_min, const Vector2<float> &p_max, unsigned int nx, unsigned int ny);
     HeightField(const Image &height_map, float scale_z, const Vector2<float> &p_min, const Vector2<float> &p_max);
+    HeightField(std::vector<float> &&heights, const Vector2<float> &p_min, const Vector2<float> &p_max, unsigned int nx, unsigned int ny);
     
     void polygonize(std::vector<Vector3<float>> &positions, std::vector<Vector2<float>> &textures_coords, std::vector<unsigned int> &indices) const;
     
     void perlin_noise(float fx, float fy, float height);
-    void thermal_erosion(float quantity);
+    void perlin_noise(const NoiseParameters &parameters);
+    void thermal_erosion(float quantity, ThermalErosionMode mode = ThermalErosionMode::sequential, unsigned int tile_size = 64);
     void stream_power_erosion(float k, float n);
-    void road(unsigned int i, unsigned int j, unsigned int gi, unsigned int gj, int width, float slope_cost, float water_low_cost, float water_high_cost, float water_treshold);
+    void road(unsigned int i, unsigned int j, unsigned int gi, unsigned int gj, int width, float slope_cost, float water_low_cost, float water_high_cost, float water_treshold,
+        RoadSearch search = RoadSearch::astar);
     void blur(unsigned int size);
-    void fill(float height);
+    void gaussian_blur(float sigma);
+    void fill(float height, bool lakes = true, float step = 0.0f);
+    void set_flow_direction(FlowDirection direction);
+    void set_flow_routing(bool across_depressions);
     
+    // values of a scalar layer (every layer but texture) and colors of the texture layer
+    std::vector<float> layer_values(TerrainLayer layer) const;
+    std::vector<Color> texture_colors() const;
+    // RGBA image of a layer as it is exported, first row at the bottom of the picture. Layers depending on the
+    // flow can be computed from several threads once stream_areas() was called
+    Image layer_image(TerrainLayer layer) const;
+
     void export_stream_areas(const std::string &path) const;
     void export_wetness(const std::string &path) const;
     void export_texture(const std::string &path) const;
+
+    // native terrain file with the heights, the water and optionally the stream areas. load replaces the whole
+    // field, including its extents and flow settings, and keeps it unchanged on failure
+    bool save(const std::string &path, const TerrainFileOptions &options = TerrainFileOptions()) const;
+    bool load(const std::string &path);
     
     Vector3<float> point(unsigned int i, unsigned int j) const;
+    // normal of the polygonized surface, area weighted over the triangles around the vertex
     Vector3<float> normal(unsigned int i, unsigned int j) const;
+    std::vector<Vector3<float>> normals() const;
+
+    // flow accumulation of the current heights, computed on first use
+    const std::vector<float> &stream_areas() const;
+
+    // to call once the heights written through mutable_view() are all written : invalidates the cached flow and
+    // marks the cells dirty. The edits of this class call it themselves
+    void heights_changed();
+    void heights_changed(const GridRect &rect);
+
+    // cells whose height changed since the last clear : the road corridor for road(), the whole grid for the
+    // other edits
+    const DirtyRegion &dirty_region() const;
+    void clear_dirty_region();
 
 private:
-    std::vector<float> stream_areas() const;
-    std::vector<Cell> sorted_cells() const;
-    float directional_slope(unsigned int i, unsigned int j, unsigned int ni, unsigned int nj) const;
+    std::vector<unsigned int> sorted_cells() const;
+    void thermal_erosion_parallel(float quantity, unsigned int tile_size);
     
-    Vicinity vicinity_M14(const Cell &cell) const;
-    Vicinity vicinity_M18(const Cell &cell) const;
-    Vicinity vicinity_M2(const Cell &cell) const;
-    Vicinity vicinity_M3(const Cell &cell) const;
-    
-    DijkstraAdjacencyList create_graph(float slope_cost, float water_low_cost, float water_high_cost, float water_treshold) const;
-    std::vector<Cell> shortest_path(unsigned int i, unsigned int j, unsigned int gi, unsigned int gj, 
-        float slope_cost, float water_low_cost, float water_high_cost, float water_treshold) const;
+    std::vector<unsigned int> shortest_path(unsigned int i, unsigned int j, unsigned int gi, unsigned int gj, const RoadCosts &costs, RoadSearch search) const;
 
 private:
     std::vector<float> water_;
+    FlowDirection flow_direction_ = FlowDirection::multiple;
+    bool flow_across_depressions_ = false;
+
+    // flow accumulation of the current heights, recomputed lazily after heights_changed()
+    mutable FlowAccumulation flow_;
+    mutable bool flow_valid_ = false;
+
+    DirtyRegion dirty_ = DirtyRegion(nx_, ny_);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,113 @@
+#include "layer_export.hpp"
+
+#include <chrono>
+#include <algorithm>
+
+namespace
+{
+    const char *names[] = {"texture", "height", "slope", "laplacian", "wetness", "stream_areas"};
+}
+
+const char *layer_name(TerrainLayer layer)
+{
+    return names[(unsigned int)layer];
+}
+
+bool parse_layer(const std::string &name, TerrainLayer &layer)
+{
+    for(unsigned int l = 0; l < sizeof(names) / sizeof(names[0]); ++l)
+    {
+        if(name == names[l])
+        {
+            layer = (TerrainLayer)l;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool uses_flow(TerrainLayer layer)
+{
+    return layer == TerrainLayer::texture || layer == TerrainLayer::wetness || layer == TerrainLayer::stream_areas;
+}
+
+LayerExporter::LayerExporter(unsigned int nb_workers) : pool_(nb_workers)
+{}
+
+LayerExporter::~LayerExporter()
+{
+    wait();
+}
+
+std::vector<std::shared_ptr<const Image>> LayerExporter::export_layers(const HeightField &field, const std::vector<LayerOutput> &outputs)
+{
+    // the flow cache is filled once here, the layer tasks then only read it
+    for(const LayerOutput &output : outputs)
+    {
+        if(uses_flow(output.layer))
+        {
+            field.stream_areas();
+            break;
+        }
+    }
+
+    std::vector<std::future<std::shared_ptr<const Image>>> computed;
+    for(const LayerOutput &output : outputs)
+    {
+        TerrainLayer layer = output.layer;
+        computed.push_back(pool_.submit([&field, layer]() { return std::shared_ptr<const Image>(new Image(field.layer_image(layer))); }));
+    }
+
+    std::vector<std::shared_ptr<const Image>> images;
+    for(unsigned int o = 0; o < outputs.size(); ++o)
+    {
+        images.push_back(computed[o].get());
+        if(outputs[o].path.empty())
+            continue;
+
+        // PNG encoding is sequential in stb, the files are encoded concurrently instead
+        write_image(images.back(), outputs[o].path);
+    }
+    return images;
+}
+
+void LayerExporter::write_image(std::shared_ptr<const Image> image, const std::string &path)
+{
+    drop_finished();
+    writes_.push_back(pool_.submit([image, path]()
+    {
+        return image_io::write_png(path, image->pixels(), image->width(), image->height(), image->nb_channels());
+    }));
+}
+
+void LayerExporter::write_values(std::vector<float> &&values, unsigned int width, unsigned int height, const std::string &path)
+{
+    drop_finished();
+    std::shared_ptr<std::vector<float>> shared = std::make_shared<std::vector<float>>(std::move(values));
+    writes_.push_back(pool_.submit([shared, width, height, path]()
+    {
+        return image_io::write_png(path, image_io::gray_pixels(*shared, width, height), width, height, 4);
+    }));
+}
+
+bool LayerExporter::wait()
+{
+    bool written = !failed_;
+    for(std::future<bool> &write : writes_)
+        written = write.get() && written;
+    writes_.clear();
+    failed_ = false;
+    return written;
+}
+
+void LayerExporter::drop_finished()
+{
+    std::vector<std::future<bool>>::iterator pending = std::remove_if(writes_.begin(), writes_.end(), [this](std::future<bool> &write)
+    {
+        if(write.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            return false;
+        failed_ = !write.get() || failed_;
+        return true;
+    });
+    writes_.erase(pending, writes_.end());
+}
@@ -0,0 +1,53 @@
+#ifndef MESHTOOL_LAYER_EXPORT
+#define MESHTOOL_LAYER_EXPORT
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <future>
+
+#include "heightfield.hpp"
+#include "worker_pool.hpp"
+
+const char *layer_name(TerrainLayer layer);
+bool parse_layer(const std::string &name, TerrainLayer &layer);
+// the layer reads the stream areas of the field
+bool uses_flow(TerrainLayer layer);
+
+struct LayerOutput
+{
+    TerrainLayer layer;
+    std::string path;   // empty : the image is only computed
+};
+
+// computes layers in parallel, then encodes and writes their PNG files in the background on a worker pool, so
+// the caller can upload the returned images right away instead of reading the files back
+class LayerExporter
+{
+public:
+    explicit LayerExporter(unsigned int nb_workers = util::nb_threads());
+    ~LayerExporter();
+
+    // returns the images of the outputs, in the same order, once they are all computed. The field is not used
+    // after the call returns
+    std::vector<std::shared_ptr<const Image>> export_layers(const HeightField &field, const std::vector<LayerOutput> &outputs);
+
+    // queues the PNG of an image computed by the caller
+    void write_image(std::shared_ptr<const Image> image, const std::string &path);
+    // queues the gray PNG of scalar layer values computed by the caller
+    void write_values(std::vector<float> &&values, unsigned int width, unsigned int height, const std::string &path);
+
+    // waits for the pending writes, false when one of them failed since the last wait
+    bool wait();
+
+private:
+    // forgets the writes already done, a caller that never waits does not keep one future per write
+    void drop_finished();
+
+private:
+    util::WorkerPool pool_;
+    std::vector<std::future<bool>> writes_;
+    bool failed_ = false;
+};
+
+#endif
@@ -0,0 +1,502 @@
+#include "mapped_field.hpp"
+
+#include <cassert>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "filter.hpp"
+#include "stencil.hpp"
+#include "parallel.hpp"
+
+namespace
+{
+    const char magic[8] = {'M', 'T', 'H', 'F', 'T', 'I', 'L', 'E'};
+    const std::uint32_t version = 1;
+    const std::size_t header_size = 4096;   // tiles start on a page boundary
+
+    struct Header
+    {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t nx, ny;
+        std::uint32_t tile_size;
+        float p_min_x, p_min_y;
+        float p_max_x, p_max_y;
+    };
+}
+
+MappedHeightField::MappedHeightField() : layout_(0, 0, 1, 1)
+{}
+
+MappedHeightField::~MappedHeightField()
+{
+    close();
+}
+
+bool MappedHeightField::create(const std::string &path, unsigned int nx, unsigned int ny, const Vector2<float> &p_min, const Vector2<float> &p_max,
+    unsigned int tile_size)
+{
+    assert(tile_size >= 32 && (tile_size & (tile_size - 1)) == 0 && "tile size must be a power of two of at least 32");
+    close();
+    nx_ = nx;
+    ny_ = ny;
+    tile_size_ = tile_size;
+    p_min_ = p_min;
+    p_max_ = p_max;
+    if(!map(path, true, true))
+        return false;
+
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.nx = nx;
+    header.ny = ny;
+    header.tile_size = tile_size;
+    header.p_min_x = p_min.x;
+    header.p_min_y = p_min.y;
+    header.p_max_x = p_max.x;
+    header.p_max_y = p_max.y;
+    std::memcpy(mapping_, &header, sizeof(header));
+    return true;
+}
+
+bool MappedHeightField::open(const std::string &path, bool writable)
+{
+    close();
+    int file = ::open(path.c_str(), O_RDONLY);
+    Header header;
+    bool valid = file >= 0 && pread(file, &header, sizeof(header), 0) == (ssize_t)sizeof(header)
+        && std::memcmp(header.magic, magic, sizeof(magic)) == 0 && header.version == version;
+    if(file >= 0)
+        ::close(file);
+    if(!valid)
+    {
+        fprintf(stderr, "[MAPPED FIELD] - %s is not a tiled height field\n", path.c_str());
+        return false;
+    }
+
+    // the header sizes the mapping and divides the indices : the same constraints as create
+    if(header.nx == 0 || header.ny == 0 || header.tile_size < 32 || (header.tile_size & (header.tile_size - 1)) != 0)
+    {
+        fprintf(stderr, "[MAPPED FIELD] - %s : invalid %ux%u grid with tiles of %u\n", path.c_str(), header.nx, header.ny, header.tile_size);
+        return false;
+    }
+
+    nx_ = header.nx;
+    ny_ = header.ny;
+    tile_size_ = header.tile_size;
+    p_min_ = Vector2<float>(header.p_min_x, header.p_min_y);
+    p_max_ = Vector2<float>(header.p_max_x, header.p_max_y);
+    return map(path, writable, false);
+}
+
+bool MappedHeightField::map(const std::string &path, bool writable, bool create)
+{
+    layout_ = TileLayout(nx_, ny_, tile_size_, tile_size_);
+    mapping_size_ = header_size + (std::size_t)layout_.nb_tiles() * tile_size_ * tile_size_ * sizeof(float);
+    writable_ = writable;
+
+    file_ = ::open(path.c_str(), writable ? (O_RDWR | (create ? O_CREAT | O_TRUNC : 0)) : O_RDONLY, 0644);
+    if(file_ < 0)
+    {
+        fprintf(stderr, "[MAPPED FIELD] - could not open %s\n", path.c_str());
+        return false;
+    }
+
+    struct stat status;
+    if(create ? ftruncate(file_, mapping_size_) != 0 : (fstat(file_, &status) != 0 || (std::size_t)status.st_size < mapping_size_))
+    {
+        fprintf(stderr, "[MAPPED FIELD] - %s : file size does not match a %ux%u grid\n", path.c_str(), nx_, ny_);
+        close();
+        return false;
+    }
+
+    void *mapping = mmap(nullptr, mapping_size_, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, file_, 0);
+    if(mapping == MAP_FAILED)
+    {
+        fprintf(stderr, "[MAPPED FIELD] - could not map %s\n", path.c_str());
+        close();
+        return false;
+    }
+    mapping_ = (unsigned char *)mapping;
+
+    resident_.assign(layout_.nb_tiles(), 0);
+    lru_entries_.assign(layout_.nb_tiles(), lru_.end());
+    lru_.clear();
+    resident_limit_ = 4 * layout_.nb_tiles_x();
+    return true;
+}
+
+void MappedHeightField::close()
+{
+    if(mapping_ != nullptr)
+    {
+        if(writable_)
+            msync(mapping_, mapping_size_, MS_SYNC);
+        munmap(mapping_, mapping_size_);
+        mapping_ = nullptr;
+    }
+    if(file_ >= 0)
+    {
+        ::close(file_);
+        file_ = -1;
+    }
+    lru_.clear();
+    resident_.clear();
+    lru_entries_.clear();
+}
+
+bool MappedHeightField::is_open() const
+{
+    return mapping_ != nullptr;
+}
+
+float MappedHeightField::value(unsigned int i, unsigned int j)
+{
+    assert(i < nx_ && j < ny_ && "indices out of bounds");
+    unsigned int t = (j / tile_size_) * layout_.nb_tiles_x() + i / tile_size_;
+    touch(t);
+    return tile_data(t)[(j % tile_size_) * tile_size_ + i % tile_size_];
+}
+
+util::GridView<float> MappedHeightField::tile(unsigned int t)
+{
+    assert(writable_ && "the field is mapped read only");
+    touch(t);
+    Tile bounds = layout_.tile(t);
+    return util::GridView<float>(tile_data(t), bounds.width(), bounds.height(), 1, tile_size_);
+}
+
+void MappedHeightField::read_rows(unsigned int j_begin, util::GridView<float> rows)
+{
+    assert(rows.width() == nx_ && j_begin + rows.height() <= ny_ && "rows out of the grid");
+    for(unsigned int tj = j_begin / tile_size_; tj * tile_size_ < j_begin + rows.height(); ++tj)
+    {
+        unsigned int row_begin = std::max(j_begin, tj * tile_size_);
+        unsigned int row_end = std::min(j_begin + rows.height(), (tj + 1) * tile_size_);
+        for(unsigned int ti = 0; ti < layout_.nb_tiles_x(); ++ti)
+        {
+            unsigned int t = tj * layout_.nb_tiles_x() + ti;
+            Tile bounds = layout_.tile(t);
+            touch(t);
+            const float *data = tile_data(t);
+            for(unsigned int j = row_begin; j < row_end; ++j)
+            {
+                const float *src = data + (j - bounds.j_begin) * tile_size_;
+                std::copy(src, src + bounds.width(), rows.row(j - j_begin) + bounds.i_begin);
+            }
+        }
+    }
+}
+
+void MappedHeightField::write_rows(unsigned int j_begin, util::GridView<const float> rows)
+{
+    assert(writable_ && "the field is mapped read only");
+    assert(rows.width() == nx_ && j_begin + rows.height() <= ny_ && "rows out of the grid");
+    for(unsigned int tj = j_begin / tile_size_; tj * tile_size_ < j_begin + rows.height(); ++tj)
+    {
+        unsigned int row_begin = std::max(j_begin, tj * tile_size_);
+        unsigned int row_end = std::min(j_begin + rows.height(), (tj + 1) * tile_size_);
+        for(unsigned int ti = 0; ti < layout_.nb_tiles_x(); ++ti)
+        {
+            unsigned int t = tj * layout_.nb_tiles_x() + ti;
+            Tile bounds = layout_.tile(t);
+            touch(t);
+            float *data = tile_data(t);
+            for(unsigned int j = row_begin; j < row_end; ++j)
+            {
+                const float *src = rows.row(j - j_begin) + bounds.i_begin;
+                std::copy(src, src + bounds.width(), data + (j - bounds.j_begin) * tile_size_);
+            }
+        }
+    }
+}
+
+void MappedHeightField::assign(util::GridView<const float> heights)
+{
+    assert(heights.width() == nx_ && heights.height() == ny_ && "view dimensions do not match the field");
+    write_rows(0, heights);
+}
+
+void MappedHeightField::copy_to(util::GridView<float> heights)
+{
+    assert(heights.width() == nx_ && heights.height() == ny_ && "view dimensions do not match the field");
+    read_rows(0, heights);
+}
+
+// rows above the band were already written back : their original values are kept from the previous band, which
+// is why the radius can not exceed the tile size
+template<typename Function>
+void MappedHeightField::for_each_band(unsigned int radius, const Function &function)
+{
+    assert(radius <= tile_size_ && "band radius larger than a tile");
+    std::vector<float> previous, current, out;
+    unsigned int previous_first = 0;
+    for(unsigned int tj = 0; tj < layout_.nb_tiles_y(); ++tj)
+    {
+        unsigned int j_begin = tj * tile_size_;
+        unsigned int j_end = std::min(j_begin + tile_size_, ny_);
+        unsigned int first = j_begin > radius ? j_begin - radius : 0;
+        unsigned int last = std::min(j_end + radius, ny_);
+
+        current.resize((std::size_t)(last - first) * nx_);
+        if(first < j_begin)
+            std::copy(&previous[(std::size_t)(first - previous_first) * nx_], &previous[(std::size_t)(j_begin - previous_first) * nx_], current.begin());
+        read_rows(j_begin, util::GridView<float>(&current[(std::size_t)(j_begin - first) * nx_], nx_, last - j_begin));
+
+        out.resize((std::size_t)(j_end - j_begin) * nx_);
+        function(util::GridView<const float>(current.data(), nx_, last - first), first, j_begin, j_end, util::GridView<float>(out.data(), nx_, j_end - j_begin));
+        write_rows(j_begin, util::GridView<const float>(out.data(), nx_, j_end - j_begin));
+
+        previous.swap(current);
+        previous_first = first;
+    }
+}
+
+void MappedHeightField::perlin_noise(const NoiseParameters &parameters)
+{
+    NoiseGenerator generator(parameters.seed);
+    std::vector<float> band;
+    for(unsigned int tj = 0; tj < layout_.nb_tiles_y(); ++tj)
+    {
+        unsigned int j_begin = tj * tile_size_;
+        unsigned int j_end = std::min(j_begin + tile_size_, ny_);
+        band.resize((std::size_t)(j_end - j_begin) * nx_);
+        util::GridView<float> rows(band.data(), nx_, j_end - j_begin);
+        generator.generate(rows, ny_, j_begin, parameters);
+        write_rows(j_begin, rows);
+    }
+}
+
+void MappedHeightField::blur(unsigned int radius)
+{
+    if(radius == 0)
+        return;
+    for_each_band(radius, [&](util::GridView<const float> band, unsigned int first, unsigned int j_begin, unsigned int j_end, util::GridView<float> out)
+    {
+        box_blur_band(band, first, ny_, j_begin, j_end, out, radius);
+    });
+}
+
+// outflows are needed one row around the band, which needs the heights two rows around it
+void MappedHeightField::thermal_erosion(float quantity)
+{
+    Stencil<stencil::M14> stencil(nx_, ny_, scale_x(), scale_y());
+    const unsigned char none = 4;
+    std::vector<unsigned char> targets;
+
+    for_each_band(2, [&](util::GridView<const float> band, unsigned int first, unsigned int j_begin, unsigned int j_end, util::GridView<float> out)
+    {
+        auto height = [&](std::size_t c) { return band.data()[c - (std::size_t)first * nx_]; };
+
+        unsigned int target_first = j_begin > 0 ? j_begin - 1 : 0;
+        unsigned int target_last = std::min(j_end + 1, ny_);
+        targets.resize((std::size_t)(target_last - target_first) * nx_);
+        util::parallel_for(target_first, target_last, [&](unsigned int row_begin, unsigned int row_end)
+        {
+            for(unsigned int j = row_begin; j < row_end; ++j)
+            {
+                for(unsigned int i = 0; i < nx_; ++i)
+                {
+                    float h = height((std::size_t)j * nx_ + i);
+                    float min_slope = 0.0f;
+                    unsigned char target = none;
+                    stencil.for_each(i, j, [&](unsigned int k, std::size_t n)
+                    {
+                        float slope = (height(n) - h) / stencil.distance(k);
+                        if(slope < min_slope)
+                        {
+                            min_slope = slope;
+                            target = k;
+                        }
+                    });
+                    targets[(std::size_t)(j - target_first) * nx_ + i] = target;
+                }
+            }
+        });
+
+        util::parallel_for(j_begin, j_end, [&](unsigned int row_begin, unsigned int row_end)
+        {
+            for(unsigned int j = row_begin; j < row_end; ++j)
+            {
+                for(unsigned int i = 0; i < nx_; ++i)
+                {
+                    std::size_t c = (std::size_t)j * nx_ + i;
+                    std::size_t t = (std::size_t)(j - target_first) * nx_ + i;
+                    float h = height(c);
+                    if(targets[t] != none)
+                        h -= height(c) * quantity;
+                    for(unsigned int k = 0; k < stencil.size; ++k)
+                    {
+                        int ni = (int)i + stencil.di(k);
+                        int nj = (int)j + stencil.dj(k);
+                        if(ni < 0 || ni >= (int)nx_ || nj < 0 || nj >= (int)ny_)
+                            continue;
+                        if(targets[t + stencil.dj(k) * (int)nx_ + stencil.di(k)] == stencil.opposite(k))
+                            h += height(c + stencil.offset(k)) * quantity;
+                    }
+                    out.row(j - j_begin)[i] = h;
+                }
+            }
+        });
+    });
+}
+
+// rows are written from the top of the terrain, like the raw files of image_io
+bool MappedHeightField::export_raw(const std::string &path)
+{
+    FILE *file = fopen(path.c_str(), "wb");
+    if(file == nullptr)
+    {
+        fprintf(stderr, "[MAPPED FIELD] - could not write %s\n", path.c_str());
+        return false;
+    }
+
+    std::vector<float> band;
+    bool written = true;
+    for(unsigned int tj = layout_.nb_tiles_y(); tj-- > 0 && written;)
+    {
+        unsigned int j_begin = tj * tile_size_;
+        unsigned int nb_rows = std::min(tile_size_, ny_ - j_begin);
+        band.resize((std::size_t)nb_rows * nx_);
+        read_rows(j_begin, util::GridView<float>(band.data(), nx_, nb_rows));
+        for(unsigned int r = nb_rows; r-- > 0 && written;)
+            written = fwrite(&band[(std::size_t)r * nx_], sizeof(float), nx_, file) == nx_;
+    }
+    fclose(file);
+    return written;
+}
+
+// rows are written from the top of the terrain, like the images exported by HeightField
+bool MappedHeightField::export_pgm(const std::string &path)
+{
+    std::vector<float> band;
+    float min = 0.0f, max = 0.0f;
+    for(unsigned int j_begin = 0; j_begin < ny_; j_begin += tile_size_)
+    {
+        unsigned int nb_rows = std::min(tile_size_, ny_ - j_begin);
+        band.resize((std::size_t)nb_rows * nx_);
+        read_rows(j_begin, util::GridView<float>(band.data(), nx_, nb_rows));
+        std::pair<std::vector<float>::iterator, std::vector<float>::iterator> range = std::minmax_element(band.begin(), band.end());
+        min = j_begin == 0 ? *range.first : std::min(min, *range.first);
+        max = j_begin == 0 ? *range.second : std::max(max, *range.second);
+    }
+
+    FILE *file = fopen(path.c_str(), "wb");
+    if(file == nullptr)
+    {
+        fprintf(stderr, "[MAPPED FIELD] - could not write %s\n", path.c_str());
+        return false;
+    }
+    fprintf(file, "P5\n%u %u\n65535\n", nx_, ny_);
+
+    std::vector<unsigned char> row(nx_ * 2);
+    float scale = max > min ? 65535.0f / (max - min) : 0.0f;
+    bool written = true;
+    for(unsigned int tj = layout_.nb_tiles_y(); tj-- > 0 && written;)
+    {
+        unsigned int j_begin = tj * tile_size_;
+        unsigned int nb_rows = std::min(tile_size_, ny_ - j_begin);
+        band.resize((std::size_t)nb_rows * nx_);
+        read_rows(j_begin, util::GridView<float>(band.data(), nx_, nb_rows));
+        for(unsigned int r = nb_rows; r-- > 0 && written;)
+        {
+            // 16 bit PGM values are big endian
+            for(unsigned int i = 0; i < nx_; ++i)
+            {
+                unsigned int value = (unsigned int)((band[(std::size_t)r * nx_ + i] - min) * scale + 0.5f);
+                row[2 * i] = (unsigned char)(value >> 8);
+                row[2 * i + 1] = (unsigned char)(value & 0xFF);
+            }
+            written = fwrite(row.data(), 1, row.size(), file) == row.size();
+        }
+    }
+    fclose(file);
+    return written;
+}
+
+void MappedHeightField::set_resident_limit(unsigned int nb_tiles)
+{
+    resident_limit_ = nb_tiles;
+    while(resident_limit_ > 0 && lru_.size() > resident_limit_)
+    {
+        release(lru_.back());
+    }
+}
+
+unsigned int MappedHeightField::nb_resident_tiles() const
+{
+    return lru_.size();
+}
+
+void MappedHeightField::touch(unsigned int t)
+{
+    if(resident_[t])
+    {
+        lru_.splice(lru_.begin(), lru_, lru_entries_[t]);
+        return;
+    }
+    lru_.push_front(t);
+    lru_entries_[t] = lru_.begin();
+    resident_[t] = 1;
+    if(resident_limit_ > 0 && lru_.size() > resident_limit_)
+        release(lru_.back());
+}
+
+// pages of a shared file mapping are written back by the system, dropping them only lowers the resident set
+void MappedHeightField::release(unsigned int t)
+{
+    std::size_t tile_bytes = (std::size_t)tile_size_ * tile_size_ * sizeof(float);
+    if(tile_bytes % sysconf(_SC_PAGESIZE) == 0)
+        madvise(tile_data(t), tile_bytes, MADV_DONTNEED);
+    lru_.erase(lru_entries_[t]);
+    lru_entries_[t] = lru_.end();
+    resident_[t] = 0;
+}
+
+float *MappedHeightField::tile_data(unsigned int t) const
+{
+    return (float *)(mapping_ + header_size + (std::size_t)t * tile_size_ * tile_size_ * sizeof(float));
+}
+
+const TileLayout &MappedHeightField::layout() const
+{
+    return layout_;
+}
+
+unsigned int MappedHeightField::nx() const
+{
+    return nx_;
+}
+
+unsigned int MappedHeightField::ny() const
+{
+    return ny_;
+}
+
+Vector2<float> MappedHeightField::p_min() const
+{
+    return p_min_;
+}
+
+Vector2<float> MappedHeightField::p_max() const
+{
+    return p_max_;
+}
+
+float MappedHeightField::scale_x() const
+{
+    return (p_max_.x - p_min_.x) / (nx_ - 1);
+}
+
+float MappedHeightField::scale_y() const
+{
+    return (p_max_.y - p_min_.y) / (ny_ - 1);
+}
@@ -0,0 +1,95 @@
+#ifndef MESHTOOL_MAPPED_FIELD
+#define MESHTOOL_MAPPED_FIELD
+
+#include <string>
+#include <vector>
+#include <list>
+#include <cstdint>
+
+#include "vector.hpp"
+#include "grid_view.hpp"
+#include "tiled_field.hpp"
+#include "noise.hpp"
+
+// height field stored in a memory mapped file, for terrains larger than the memory. The file holds a header
+// followed by square tiles of tile_size^2 floats (the last column and row of tiles are padded), each tile being
+// contiguous and page aligned. Tiles are paged in by the system when touched, and the least recently used ones
+// are released once more than the resident limit are in use. Operations stream over the grid one band of tiles
+// at a time, so their memory use only depends on the grid width.
+// Not thread safe : a mapped field must be used from a single thread (the band kernels are multithreaded).
+class MappedHeightField
+{
+public:
+    MappedHeightField();
+    ~MappedHeightField();
+    MappedHeightField(const MappedHeightField &) = delete;
+    MappedHeightField &operator=(const MappedHeightField &) = delete;
+
+    // creates (or truncates) the file, heights are 0
+    bool create(const std::string &path, unsigned int nx, unsigned int ny, const Vector2<float> &p_min, const Vector2<float> &p_max,
+        unsigned int tile_size = 256);
+    bool open(const std::string &path, bool writable = true);
+    void close();
+    bool is_open() const;
+
+    float value(unsigned int i, unsigned int j);
+    util::GridView<float> tile(unsigned int t);
+
+    // row major copies of the grid rows [j_begin, j_begin + rows.height())
+    void read_rows(unsigned int j_begin, util::GridView<float> rows);
+    void write_rows(unsigned int j_begin, util::GridView<const float> rows);
+
+    void assign(util::GridView<const float> heights);
+    void copy_to(util::GridView<float> heights);
+
+    void perlin_noise(const NoiseParameters &parameters);
+    void blur(unsigned int radius);
+    // same rule as HeightField::thermal_erosion in parallel mode
+    void thermal_erosion(float quantity);
+
+    // raw R32F heights (see image_io::write_raw)
+    bool export_raw(const std::string &path);
+    // 16 bit binary PGM of the heights normalized between their minimum and maximum
+    bool export_pgm(const std::string &path);
+
+    // 0 keeps every touched tile resident
+    void set_resident_limit(unsigned int nb_tiles);
+    unsigned int nb_resident_tiles() const;
+
+    const TileLayout &layout() const;
+    unsigned int nx() const;
+    unsigned int ny() const;
+    Vector2<float> p_min() const;
+    Vector2<float> p_max() const;
+    float scale_x() const;
+    float scale_y() const;
+
+private:
+    bool map(const std::string &path, bool writable, bool create);
+    void touch(unsigned int t);
+    void release(unsigned int t);
+    float *tile_data(unsigned int t) const;
+
+    // calls function(band, first_row, j_begin, j_end, out) for each band of tile rows [j_begin, j_end), band holding
+    // the original grid rows [first_row, ...) around it, then writes out back to the file
+    template<typename Function>
+    void for_each_band(unsigned int radius, const Function &function);
+
+private:
+    int file_ = -1;
+    unsigned char *mapping_ = nullptr;
+    std::size_t mapping_size_ = 0;
+    bool writable_ = false;
+
+    unsigned int nx_ = 0, ny_ = 0;
+    unsigned int tile_size_ = 0;
+    Vector2<float> p_min_, p_max_;
+    TileLayout layout_;
+
+    unsigned int resident_limit_ = 0;
+    std::list<unsigned int> lru_;
+    std::vector<std::list<unsigned int>::iterator> lru_entries_;
+    std::vector<std::uint8_t> resident_;
+};
+
+#endif
@@ -0,0 +1,368 @@
+#include "noise.hpp"
+
+#include <math.h>
+#include <cassert>
+#include <random>
+#include <algorithm>
+
+#include "parallel.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MESHTOOL_NOISE_X86
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    const int reference_permutation[256] = {
+        151,160,137,91,90,15,131,13,201,95,96,53,194,233,7,225,140,36,103,30,69,142,
+        8,99,37,240,21,10,23,190,6,148,247,120,234,75,0,26,197,62,94,252,219,203,117,
+        35,11,32,57,177,33,88,237,149,56,87,174,20,125,136,171,168,68,175,74,165,71,
+        134,139,48,27,166,77,146,158,231,83,111,229,122,60,211,133,230,220,105,92,41,
+        55,46,245,40,244,102,143,54,65,25,63,161,1,216,80,73,209,76,132,187,208,89,18,
+        169,200,196,135,130,116,188,159,86,164,100,109,198,173,186,3,64,52,217,226,250,
+        124,123,5,202,38,147,118,126,255,82,85,212,207,206,59,227,47,16,58,17,182,189,
+        28,42,223,183,170,213,119,248,152,2,44,154,163,70,221,153,101,155,167,43,172,9,
+        129,22,39,253,19,98,108,110,79,113,224,232,178,185,112,104,218,246,97,228,251,
+        34,242,193,238,210,144,12,191,179,162,241,81,51,145,235,249,14,239,107,49,192,
+        214,31,181,199,106,157,184,84,204,176,115,121,50,45,127,4,150,254,138,236,205,
+        93,222,114,67,29,24,72,243,141,128,195,78,66,215,61,156,180
+    };
+
+    // the 2D noise is the z = 40 slice of the original 3D perlin noise, each octave uses its own slice
+    int slice(unsigned int octave)
+    {
+        return (40 + 59 * octave) & 255;
+    }
+
+    enum class Backend { scalar, sse41, avx2 };
+
+    Backend detect_backend()
+    {
+#ifdef MESHTOOL_NOISE_X86
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2"))
+            return Backend::avx2;
+        if(__builtin_cpu_supports("sse4.1"))
+            return Backend::sse41;
+#endif
+        return Backend::scalar;
+    }
+
+    Backend backend()
+    {
+        static const Backend selected = detect_backend();
+        return selected;
+    }
+
+    inline float fade(float t)
+    {
+        return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+    }
+
+    inline float lerp(float t, float a, float b)
+    {
+        return a + t * (b - a);
+    }
+
+    inline float grad(int hash, float x, float y)
+    {
+        int h = hash & 15;
+        float u = h < 8 ? x : y;
+        float v = h < 4 ? y : h == 12 || h == 14 ? x : 0.0f;
+        return ((h & 1) == 0 ? u : -u) + ((h & 2) == 0 ? v : -v);
+    }
+
+    inline float noise_2d(const int *p, int z, float x, float y)
+    {
+        float fx = floorf(x);
+        float fy = floorf(y);
+        int X = (int)fx & 255;
+        int Y = (int)fy & 255;
+        x -= fx;
+        y -= fy;
+
+        float u = fade(x);
+        float v = fade(y);
+
+        int A = p[X] + Y, AA = p[A] + z, AB = p[A + 1] + z;
+        int B = p[X + 1] + Y, BA = p[B] + z, BB = p[B + 1] + z;
+
+        return lerp(v, lerp(u, grad(p[AA], x, y), grad(p[BA], x - 1.0f, y)),
+                       lerp(u, grad(p[AB], x, y - 1.0f), grad(p[BB], x - 1.0f, y - 1.0f)));
+    }
+
+    void noise_row_scalar(const int *p, int z, float *row, unsigned int begin, unsigned int end, float period_x, float y, float frequency)
+    {
+        for(unsigned int i = begin; i < end; ++i)
+            row[i] = noise_2d(p, z, ((float)i / period_x) * frequency, y);
+    }
+
+#ifdef MESHTOOL_NOISE_X86
+    // --- AVX2 : 8 cells per iteration, permutation lookups through gathers ---
+
+    __attribute__((target("avx2"))) inline __m256 fade8(__m256 t)
+    {
+        __m256 t3 = _mm256_mul_ps(_mm256_mul_ps(t, t), t);
+        __m256 poly = _mm256_add_ps(_mm256_mul_ps(t, _mm256_sub_ps(_mm256_mul_ps(t, _mm256_set1_ps(6.0f)), _mm256_set1_ps(15.0f))), _mm256_set1_ps(10.0f));
+        return _mm256_mul_ps(t3, poly);
+    }
+
+    __attribute__((target("avx2"))) inline __m256 lerp8(__m256 t, __m256 a, __m256 b)
+    {
+        return _mm256_add_ps(a, _mm256_mul_ps(t, _mm256_sub_ps(b, a)));
+    }
+
+    __attribute__((target("avx2"))) inline __m256 grad8(__m256i hash, __m256 x, __m256 y)
+    {
+        __m256i h = _mm256_and_si256(hash, _mm256_set1_epi32(15));
+        __m256 h_lt_8 = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(8), h));
+        __m256 h_lt_4 = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(4), h));
+        __m256 h_12_14 = _mm256_castsi256_ps(_mm256_or_si256(_mm256_cmpeq_epi32(h, _mm256_set1_epi32(12)), _mm256_cmpeq_epi32(h, _mm256_set1_epi32(14))));
+
+        __m256 u = _mm256_blendv_ps(y, x, h_lt_8);
+        __m256 v = _mm256_blendv_ps(_mm256_and_ps(x, h_12_14), y, h_lt_4);
+
+        __m256 sign_u = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(h, _mm256_set1_epi32(1)), 31));
+        __m256 sign_v = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(h, _mm256_set1_epi32(2)), 30));
+        return _mm256_add_ps(_mm256_xor_ps(u, sign_u), _mm256_xor_ps(v, sign_v));
+    }
+
+    __attribute__((target("avx2"))) void noise_row_avx2(const int *p, int z, float *row, unsigned int nx, float period_x, float y, float frequency)
+    {
+        float fy = floorf(y);
+        int Y = (int)fy & 255;
+        float yf = y - fy;
+
+        const __m256i vY = _mm256_set1_epi32(Y);
+        const __m256i vZ = _mm256_set1_epi32(z);
+        const __m256i one = _mm256_set1_epi32(1);
+        const __m256 vy0 = _mm256_set1_ps(yf);
+        const __m256 vy1 = _mm256_set1_ps(yf - 1.0f);
+        const __m256 v = _mm256_set1_ps(fade(yf));
+        const __m256 vperiod = _mm256_set1_ps(period_x);
+        const __m256 vfrequency = _mm256_set1_ps(frequency);
+        const __m256 lanes = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+
+        unsigned int i = 0;
+        for(; i + 8 <= nx; i += 8)
+        {
+            __m256 x = _mm256_mul_ps(_mm256_div_ps(_mm256_add_ps(_mm256_set1_ps((float)i), lanes), vperiod), vfrequency);
+            __m256 fx = _mm256_floor_ps(x);
+            __m256i X = _mm256_and_si256(_mm256_cvttps_epi32(fx), _mm256_set1_epi32(255));
+            __m256 x0 = _mm256_sub_ps(x, fx);
+            __m256 x1 = _mm256_sub_ps(x0, _mm256_set1_ps(1.0f));
+            __m256 u = fade8(x0);
+
+            __m256i A = _mm256_add_epi32(_mm256_i32gather_epi32(p, X, 4), vY);
+            __m256i B = _mm256_add_epi32(_mm256_i32gather_epi32(p, _mm256_add_epi32(X, one), 4), vY);
+            __m256i AA = _mm256_add_epi32(_mm256_i32gather_epi32(p, A, 4), vZ);
+            __m256i AB = _mm256_add_epi32(_mm256_i32gather_epi32(p, _mm256_add_epi32(A, one), 4), vZ);
+            __m256i BA = _mm256_add_epi32(_mm256_i32gather_epi32(p, B, 4), vZ);
+            __m256i BB = _mm256_add_epi32(_mm256_i32gather_epi32(p, _mm256_add_epi32(B, one), 4), vZ);
+
+            __m256 g_aa = grad8(_mm256_i32gather_epi32(p, AA, 4), x0, vy0);
+            __m256 g_ba = grad8(_mm256_i32gather_epi32(p, BA, 4), x1, vy0);
+            __m256 g_ab = grad8(_mm256_i32gather_epi32(p, AB, 4), x0, vy1);
+            __m256 g_bb = grad8(_mm256_i32gather_epi32(p, BB, 4), x1, vy1);
+
+            _mm256_storeu_ps(row + i, lerp8(v, lerp8(u, g_aa, g_ba), lerp8(u, g_ab, g_bb)));
+        }
+        noise_row_scalar(p, z, row, i, nx, period_x, y, frequency);
+    }
+
+    // --- SSE4.1 : 4 cells per iteration, permutation lookups through scalar loads ---
+
+    __attribute__((target("sse4.1"))) inline __m128i gather4(const int *table, __m128i indices)
+    {
+        alignas(16) int lanes[4];
+        _mm_store_si128((__m128i *)lanes, indices);
+        return _mm_setr_epi32(table[lanes[0]], table[lanes[1]], table[lanes[2]], table[lanes[3]]);
+    }
+
+    __attribute__((target("sse4.1"))) inline __m128 fade4(__m128 t)
+    {
+        __m128 t3 = _mm_mul_ps(_mm_mul_ps(t, t), t);
+        __m128 poly = _mm_add_ps(_mm_mul_ps(t, _mm_sub_ps(_mm_mul_ps(t, _mm_set1_ps(6.0f)), _mm_set1_ps(15.0f))), _mm_set1_ps(10.0f));
+        return _mm_mul_ps(t3, poly);
+    }
+
+    __attribute__((target("sse4.1"))) inline __m128 lerp4(__m128 t, __m128 a, __m128 b)
+    {
+        return _mm_add_ps(a, _mm_mul_ps(t, _mm_sub_ps(b, a)));
+    }
+
+    __attribute__((target("sse4.1"))) inline __m128 grad4(__m128i hash, __m128 x, __m128 y)
+    {
+        __m128i h = _mm_and_si128(hash, _mm_set1_epi32(15));
+        __m128 h_lt_8 = _mm_castsi128_ps(_mm_cmplt_epi32(h, _mm_set1_epi32(8)));
+        __m128 h_lt_4 = _mm_castsi128_ps(_mm_cmplt_epi32(h, _mm_set1_epi32(4)));
+        __m128 h_12_14 = _mm_castsi128_ps(_mm_or_si128(_mm_cmpeq_epi32(h, _mm_set1_epi32(12)), _mm_cmpeq_epi32(h, _mm_set1_epi32(14))));
+
+        __m128 u = _mm_blendv_ps(y, x, h_lt_8);
+        __m128 v = _mm_blendv_ps(_mm_and_ps(x, h_12_14), y, h_lt_4);
+
+        __m128 sign_u = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(1)), 31));
+        __m128 sign_v = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(2)), 30));
+        return _mm_add_ps(_mm_xor_ps(u, sign_u), _mm_xor_ps(v, sign_v));
+    }
+
+    __attribute__((target("sse4.1"))) void noise_row_sse41(const int *p, int z, float *row, unsigned int nx, float period_x, float y, float frequency)
+    {
+        float fy = floorf(y);
+        int Y = (int)fy & 255;
+        float yf = y - fy;
+
+        const __m128i vY = _mm_set1_epi32(Y);
+        const __m128i vZ = _mm_set1_epi32(z);
+        const __m128i one = _mm_set1_epi32(1);
+        const __m128 vy0 = _mm_set1_ps(yf);
+        const __m128 vy1 = _mm_set1_ps(yf - 1.0f);
+        const __m128 v = _mm_set1_ps(fade(yf));
+        const __m128 vperiod = _mm_set1_ps(period_x);
+        const __m128 vfrequency = _mm_set1_ps(frequency);
+        const __m128 lanes = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+
+        unsigned int i = 0;
+        for(; i + 4 <= nx; i += 4)
+        {
+            __m128 x = _mm_mul_ps(_mm_div_ps(_mm_add_ps(_mm_set1_ps((float)i), lanes), vperiod), vfrequency);
+            __m128 fx = _mm_floor_ps(x);
+            __m128i X = _mm_and_si128(_mm_cvttps_epi32(fx), _mm_set1_epi32(255));
+            __m128 x0 = _mm_sub_ps(x, fx);
+            __m128 x1 = _mm_sub_ps(x0, _mm_set1_ps(1.0f));
+            __m128 u = fade4(x0);
+
+            __m128i A = _mm_add_epi32(gather4(p, X), vY);
+            __m128i B = _mm_add_epi32(gather4(p, _mm_add_epi32(X, one)), vY);
+            __m128i AA = _mm_add_epi32(gather4(p, A), vZ);
+            __m128i AB = _mm_add_epi32(gather4(p, _mm_add_epi32(A, one)), vZ);
+            __m128i BA = _mm_add_epi32(gather4(p, B), vZ);
+            __m128i BB = _mm_add_epi32(gather4(p, _mm_add_epi32(B, one)), vZ);
+
+            __m128 g_aa = grad4(gather4(p, AA), x0, vy0);
+            __m128 g_ba = grad4(gather4(p, BA), x1, vy0);
+            __m128 g_ab = grad4(gather4(p, AB), x0, vy1);
+            __m128 g_bb = grad4(gather4(p, BB), x1, vy1);
+
+            _mm_storeu_ps(row + i, lerp4(v, lerp4(u, g_aa, g_ba), lerp4(u, g_ab, g_bb)));
+        }
+        noise_row_scalar(p, z, row, i, nx, period_x, y, frequency);
+    }
+#endif
+}
+
+NoiseGenerator::NoiseGenerator(unsigned int seed)
+{
+    std::array<int, 256> permutation;
+    std::copy(reference_permutation, reference_permutation + 256, permutation.begin());
+    if(seed != 0)
+    {
+        // explicit Fisher-Yates so that a seed gives the same terrain with every standard library
+        std::mt19937 engine(seed);
+        for(unsigned int i = 255; i > 0; --i)
+            std::swap(permutation[i], permutation[engine() % (i + 1)]);
+    }
+    for(unsigned int i = 0; i < 512; ++i)
+        permutation_[i] = permutation[i & 255];
+}
+
+float NoiseGenerator::noise(float x, float y, unsigned int octave) const
+{
+    return noise_2d(permutation_.data(), slice(octave), x, y);
+}
+
+float NoiseGenerator::fractal(float x, float y, const NoiseParameters &parameters) const
+{
+    float total = 0.0f;
+    float amplitude = 1.0f;
+    float frequency = 1.0f;
+    for(unsigned int o = 0; o < parameters.octaves; ++o)
+    {
+        float n = noise(x * frequency, y * frequency, o);
+        switch(parameters.type)
+        {
+            case(NoiseType::fbm) : total += amplitude * n; break;
+            case(NoiseType::ridged) : total += amplitude * (1.0f - fabsf(n)) * (1.0f - fabsf(n)); break;
+            case(NoiseType::billow) : total += amplitude * (2.0f * fabsf(n) - 1.0f); break;
+        }
+        amplitude *= parameters.gain;
+        frequency *= parameters.lacunarity;
+    }
+    return total * parameters.amplitude;
+}
+
+void NoiseGenerator::generate(std::vector<float> &heights, unsigned int nx, unsigned int ny, const NoiseParameters &parameters) const
+{
+    heights.resize(nx * ny);
+    generate(util::GridView<float>(heights.data(), nx, ny), ny, 0, parameters);
+}
+
+void NoiseGenerator::generate(util::GridView<float> rows, unsigned int ny, unsigned int j_begin, const NoiseParameters &parameters) const
+{
+    assert(parameters.frequency_x > 0.0f && parameters.frequency_y > 0.0f && "incorrect noise frequency");
+    assert(j_begin + rows.height() <= ny && "rows out of the grid");
+    unsigned int nx = rows.width();
+    float period_x = nx / parameters.frequency_x;
+    float period_y = ny / parameters.frequency_y;
+
+    util::parallel_for(0, rows.height(), [&](unsigned int r_begin, unsigned int r_end)
+    {
+        std::vector<float> octave_row(nx);
+        for(unsigned int r = r_begin; r < r_end; ++r)
+        {
+            unsigned int j = j_begin + r;
+            float *row = rows.row(r);
+            std::fill(row, row + nx, 0.0f);
+            float amplitude = 1.0f;
+            float frequency = 1.0f;
+            for(unsigned int o = 0; o < parameters.octaves; ++o)
+            {
+                noise_row(&octave_row[0], nx, period_x, ((float)j / period_y) * frequency, frequency, o);
+                switch(parameters.type)
+                {
+                    case(NoiseType::fbm) :
+                        for(unsigned int i = 0; i < nx; ++i)
+                            row[i] += amplitude * octave_row[i];
+                        break;
+                    case(NoiseType::ridged) :
+                        for(unsigned int i = 0; i < nx; ++i)
+                            row[i] += amplitude * (1.0f - fabsf(octave_row[i])) * (1.0f - fabsf(octave_row[i]));
+                        break;
+                    case(NoiseType::billow) :
+                        for(unsigned int i = 0; i < nx; ++i)
+                            row[i] += amplitude * (2.0f * fabsf(octave_row[i]) - 1.0f);
+                        break;
+                }
+                amplitude *= parameters.gain;
+                frequency *= parameters.lacunarity;
+            }
+            for(unsigned int i = 0; i < nx; ++i)
+                row[i] *= parameters.amplitude;
+        }
+    }, 4);
+}
+
+const char *NoiseGenerator::backend()
+{
+    switch(::backend())
+    {
+        case(Backend::avx2) : return "avx2";
+        case(Backend::sse41) : return "sse4.1";
+        default : return "scalar";
+    }
+}
+
+void NoiseGenerator::noise_row(float *row, unsigned int nx, float period_x, float y, float frequency, unsigned int octave) const
+{
+    const int *p = permutation_.data();
+    int z = slice(octave);
+    switch(::backend())
+    {
+#ifdef MESHTOOL_NOISE_X86
+        case(Backend::avx2) : noise_row_avx2(p, z, row, nx, period_x, y, frequency); break;
+        case(Backend::sse41) : noise_row_sse41(p, z, row, nx, period_x, y, frequency); break;
+#endif
+        default : noise_row_scalar(p, z, row, 0, nx, period_x, y, frequency); break;
+    }
+}
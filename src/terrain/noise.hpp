@@ -0,0 +1,54 @@
+#ifndef MESHTOOL_NOISE
+#define MESHTOOL_NOISE
+
+#include <array>
+#include <vector>
+
+#include "grid_view.hpp"
+
+enum class NoiseType
+{
+    fbm,        // sum of octaves of perlin noise
+    ridged,     // sharp crests : (1 - |noise|)^2 per octave
+    billow      // rounded bumps : 2 * |noise| - 1 per octave
+};
+
+struct NoiseParameters
+{
+    // number of noise periods along each axis of the grid
+    float frequency_x = 10.0f;
+    float frequency_y = 10.0f;
+    float amplitude = 0.1f;
+    unsigned int octaves = 1;
+    float lacunarity = 2.0f;
+    float gain = 0.5f;
+    NoiseType type = NoiseType::fbm;
+    unsigned int seed = 0;
+};
+
+// 2D perlin noise evaluated 8 (AVX2) or 4 (SSE4.1) cells at a time, the instruction set being selected at runtime.
+// Seed 0 uses Ken Perlin's reference permutation, any other seed shuffles it.
+class NoiseGenerator
+{
+public:
+    NoiseGenerator(unsigned int seed = 0);
+
+    float noise(float x, float y, unsigned int octave = 0) const;
+    float fractal(float x, float y, const NoiseParameters &parameters) const;
+
+    // fills the nx * ny row major grid, cell (i, j) sampling the fractal at (i * frequency_x / nx, j * frequency_y / ny)
+    void generate(std::vector<float> &heights, unsigned int nx, unsigned int ny, const NoiseParameters &parameters) const;
+
+    // same for the rows [j_begin, j_begin + rows.height()) of a rows.width() * ny grid
+    void generate(util::GridView<float> rows, unsigned int ny, unsigned int j_begin, const NoiseParameters &parameters) const;
+
+    static const char *backend();
+
+private:
+    void noise_row(float *row, unsigned int nx, float period_x, float y, float frequency, unsigned int octave) const;
+
+private:
+    std::array<int, 512> permutation_;
+};
+
+#endif
@@ -0,0 +1,175 @@
+#include "road_planner.hpp"
+
+#include <math.h>
+#include <cassert>
+#include <queue>
+#include <limits>
+#include <algorithm>
+#include <functional>
+
+namespace
+{
+    const float infinity = std::numeric_limits<float>::infinity();
+
+    struct HeapEntry
+    {
+        float key;
+        float distance;
+        unsigned int cell;
+
+        bool operator>(const HeapEntry &other) const
+        {
+            return key > other.key;
+        }
+    };
+
+    typedef std::priority_queue<HeapEntry, std::vector<HeapEntry>, std::greater<HeapEntry>> Heap;
+}
+
+RoadPlanner::RoadPlanner(const std::vector<float> &heights, const std::vector<float> &water, const std::vector<float> &slopes,
+    unsigned int nx, unsigned int ny, float scale_x, float scale_y)
+    : heights_(heights), water_(water), slopes_(slopes), nx_(nx), ny_(ny), scale_x_(scale_x), scale_y_(scale_y),
+    stencil_(nx, ny, scale_x, scale_y)
+{
+    assert(heights.size() == nx * ny && water.size() == nx * ny && slopes.size() == nx * ny && "layer sizes do not match the grid");
+}
+
+std::vector<unsigned int> RoadPlanner::find_path(unsigned int start, unsigned int goal, const RoadCosts &costs, RoadSearch search)
+{
+    assert(start < nx_ * ny_ && goal < nx_ * ny_ && "road end points out of bounds");
+
+    // the horizontal distance is a lower bound of the cost only when no factor can lower it
+    bool admissible = costs.slope_cost >= 0.0f && costs.water_low_cost >= 0.0f && costs.water_high_cost >= 0.0f;
+    switch(search)
+    {
+        case(RoadSearch::dijkstra) : return unidirectional(start, goal, costs, false);
+        case(RoadSearch::astar) : return unidirectional(start, goal, costs, admissible);
+        case(RoadSearch::bidirectional) :
+            if(admissible)
+                return bidirectional(start, goal, costs);
+            return unidirectional(start, goal, costs, false);
+    }
+    return std::vector<unsigned int>();
+}
+
+unsigned int RoadPlanner::nb_settled() const
+{
+    return nb_settled_;
+}
+
+float RoadPlanner::edge_cost(unsigned int from, unsigned int to, unsigned int k, const RoadCosts &costs) const
+{
+    float dz = heights_[to] - heights_[from];
+    float distance = sqrt(stencil_.squared_distance(k) + dz * dz);
+    float water = water_[from] * (water_[from] < costs.water_treshold ? costs.water_low_cost : costs.water_high_cost);
+    return distance * (1 + (std::abs(slopes_[to]) * costs.slope_cost) + water);
+}
+
+float RoadPlanner::distance_xy(unsigned int from, unsigned int to) const
+{
+    float dx = ((int)(to % nx_) - (int)(from % nx_)) * scale_x_;
+    float dy = ((int)(to / nx_) - (int)(from / nx_)) * scale_y_;
+    return sqrt(dx * dx + dy * dy);
+}
+
+std::vector<unsigned int> RoadPlanner::unidirectional(unsigned int start, unsigned int goal, const RoadCosts &costs, bool guided)
+{
+    std::vector<float> &distances = distances_[0];
+    std::vector<int> &previous = previous_[0];
+    distances.assign(nx_ * ny_, infinity);
+    previous.assign(nx_ * ny_, -1);
+    nb_settled_ = 0;
+
+    Heap heap;
+    distances[start] = 0.0f;
+    heap.push({guided ? distance_xy(start, goal) : 0.0f, 0.0f, start});
+    while(!heap.empty())
+    {
+        HeapEntry top = heap.top();
+        heap.pop();
+        if(top.distance > distances[top.cell])
+            continue;
+        ++nb_settled_;
+        if(top.cell == goal)
+            break;
+
+        stencil_.for_each(top.cell % nx_, top.cell / nx_, [&](unsigned int k, unsigned int n)
+        {
+            float distance = top.distance + edge_cost(top.cell, n, k, costs);
+            if(distance < distances[n])
+            {
+                distances[n] = distance;
+                previous[n] = top.cell;
+                heap.push({distance + (guided ? distance_xy(n, goal) : 0.0f), distance, n});
+            }
+        });
+    }
+
+    std::vector<unsigned int> path;
+    for(int cell = goal; cell != -1; cell = previous[cell])
+        path.push_back(cell);
+    std::reverse(path.begin(), path.end());
+    return path;
+}
+
+// forward potential p(v) = (|v - goal| - |v - start|) / 2 and backward potential -p(v) are both consistent,
+// the search stops once the smallest keys of both sides add up to the best meeting distance
+std::vector<unsigned int> RoadPlanner::bidirectional(unsigned int start, unsigned int goal, const RoadCosts &costs)
+{
+    for(unsigned int side = 0; side < 2; ++side)
+    {
+        distances_[side].assign(nx_ * ny_, infinity);
+        previous_[side].assign(nx_ * ny_, -1);
+    }
+    nb_settled_ = 0;
+
+    Heap heaps[2];
+    distances_[0][start] = 0.0f;
+    distances_[1][goal] = 0.0f;
+    heaps[0].push({distance_xy(start, goal) / 2.0f, 0.0f, start});
+    heaps[1].push({distance_xy(start, goal) / 2.0f, 0.0f, goal});
+
+    float best = start == goal ? 0.0f : infinity;
+    unsigned int meeting = start;
+    while(!heaps[0].empty() && !heaps[1].empty())
+    {
+        if(heaps[0].top().key + heaps[1].top().key >= best)
+            break;
+
+        unsigned int side = heaps[0].top().key <= heaps[1].top().key ? 0 : 1;
+        std::vector<float> &distances = distances_[side];
+        const std::vector<float> &other_distances = distances_[1 - side];
+        HeapEntry top = heaps[side].top();
+        heaps[side].pop();
+        if(top.distance > distances[top.cell])
+            continue;
+        ++nb_settled_;
+
+        stencil_.for_each(top.cell % nx_, top.cell / nx_, [&](unsigned int k, unsigned int n)
+        {
+            // the backward search follows edges n -> top.cell
+            float cost = side == 0 ? edge_cost(top.cell, n, k, costs) : edge_cost(n, top.cell, stencil_.opposite(k), costs);
+            float distance = top.distance + cost;
+            if(distance < distances[n])
+            {
+                distances[n] = distance;
+                previous_[side][n] = top.cell;
+                float potential = (distance_xy(n, goal) - distance_xy(n, start)) / 2.0f;
+                heaps[side].push({distance + (side == 0 ? potential : -potential), distance, n});
+                if(distance + other_distances[n] < best)
+                {
+                    best = distance + other_distances[n];
+                    meeting = n;
+                }
+            }
+        });
+    }
+
+    std::vector<unsigned int> path;
+    for(int cell = meeting; cell != -1; cell = previous_[0][cell])
+        path.push_back(cell);
+    std::reverse(path.begin(), path.end());
+    for(int cell = previous_[1][meeting]; cell != -1; cell = previous_[1][cell])
+        path.push_back(cell);
+    return path;
+}
@@ -0,0 +1,59 @@
+#ifndef MESHTOOL_ROAD_PLANNER
+#define MESHTOOL_ROAD_PLANNER
+
+#include <vector>
+
+#include "stencil.hpp"
+
+enum class RoadSearch
+{
+    dijkstra,       // plain best first search, stops when the goal is settled
+    astar,          // guided by the horizontal distance to the goal
+    bidirectional   // A* from both ends with averaged potentials
+};
+
+struct RoadCosts
+{
+    float slope_cost = 0.0f;
+    float water_low_cost = 1.0f;
+    float water_high_cost = 100.0f;
+    float water_treshold = 0.01f;
+};
+
+// shortest path search over the implicit grid graph linking each cell to its 16 neighbors of the 5x5 vicinity
+// (8 adjacent cells and 8 knight moves). Edge costs are computed on the fly :
+// cost(c, n) = |n - c| * (1 + slope(n) * slope_cost + water(c) * water_cost)
+class RoadPlanner
+{
+public:
+    RoadPlanner(const std::vector<float> &heights, const std::vector<float> &water, const std::vector<float> &slopes,
+        unsigned int nx, unsigned int ny, float scale_x, float scale_y);
+
+    // cells of the path from start to goal, both included
+    std::vector<unsigned int> find_path(unsigned int start, unsigned int goal, const RoadCosts &costs, RoadSearch search = RoadSearch::astar);
+
+    // number of cells settled by the last search
+    unsigned int nb_settled() const;
+
+private:
+    float edge_cost(unsigned int from, unsigned int to, unsigned int k, const RoadCosts &costs) const;
+    float distance_xy(unsigned int from, unsigned int to) const;
+
+    std::vector<unsigned int> unidirectional(unsigned int start, unsigned int goal, const RoadCosts &costs, bool guided);
+    std::vector<unsigned int> bidirectional(unsigned int start, unsigned int goal, const RoadCosts &costs);
+
+private:
+    const std::vector<float> &heights_;
+    const std::vector<float> &water_;
+    const std::vector<float> &slopes_;
+    unsigned int nx_, ny_;
+    float scale_x_, scale_y_;
+
+    Stencil<stencil::M2> stencil_;
+
+    std::vector<float> distances_[2];
+    std::vector<int> previous_[2];
+    unsigned int nb_settled_ = 0;
+};
+
+#endif
@@ -1,4 +1,7 @@
 #include "scalarfield.hpp"
+#include "parallel.hpp"
+
+#include <utility>
 
 ScalarField::ScalarField(const Vector2<float> &p_min, const Vector2<float> &p_max, unsigned int nx, unsigned int ny)
     : p_min_(p_min), p_max_(p_max), nx_(nx), ny_(ny)
@@ -8,6 +11,14 @@ ScalarField::ScalarField(const Vector2<float> &p_min, const Vector2<float> &p_ma
     scale_y_ = (p_max_.y - p_min_.y) / (ny_ - 1);
 }
 
+ScalarField::ScalarField(std::vector<float> &&data, const Vector2<float> &p_min, const Vector2<float> &p_max, unsigned int nx, unsigned int ny)
+    : data_(std::move(data)), p_min_(p_min), p_max_(p_max), nx_(nx), ny_(ny)
+{
+    assert(data_.size() == nx_ * ny_ && "data size does not match the provided dimensions");
+    scale_x_ = (p_max_.x - p_min_.x) / (nx_ - 1);
+    scale_y_ = (p_max_.y - p_min_.y) / (ny_ - 1);
+}
+
 float ScalarField::value(unsigned int i, unsigned int j) const
 {
     return data_.at(index(i, j));
@@ -43,33 +54,113 @@ float ScalarField::laplacian(unsigned int i, unsigned int j) const
     return num / (scale_x_ * scale_y_);
 }
 
-void ScalarField::export_data(const std::string &path) const
+std::vector<Vector2<float>> ScalarField::gradients() const
 {
-    image_io::write_gray(path, data_, nx_, ny_);
+    std::vector<Vector2<float>> grads(nx_ * ny_);
+    float dx = 2 * scale_x_;
+    float dy = 2 * scale_y_;
+    util::parallel_for(0, ny_, [&](unsigned int j_begin, unsigned int j_end)
+    {
+        for(unsigned int j = j_begin; j < j_end; ++j)
+        {
+            Vector2<float> *out = &grads[j * nx_];
+            if(j == 0 || j == ny_ - 1 || nx_ < 3)
+            {
+                for(unsigned int i = 0; i < nx_; ++i)
+                    out[i] = gradient(i, j);
+                continue;
+            }
+
+            // interior : neighbors are always in the grid
+            const float *row = &data_[j * nx_];
+            const float *row_up = row - nx_;
+            const float *row_down = row + nx_;
+            out[0] = gradient(0, j);
+            for(unsigned int i = 1; i < nx_ - 1; ++i)
+            {
+                out[i].x = (row[i - 1] - row[i + 1]) / dx;
+                out[i].y = (row_up[i] - row_down[i]) / dy;
+            }
+            out[nx_ - 1] = gradient(nx_ - 1, j);
+        }
+    });
+    return grads;
+}
+
+std::vector<float> ScalarField::slopes() const
+{
+    std::vector<float> result(nx_ * ny_);
+    float dx = 2 * scale_x_;
+    float dy = 2 * scale_y_;
+    util::parallel_for(0, ny_, [&](unsigned int j_begin, unsigned int j_end)
+    {
+        for(unsigned int j = j_begin; j < j_end; ++j)
+        {
+            float *out = &result[j * nx_];
+            if(j == 0 || j == ny_ - 1 || nx_ < 3)
+            {
+                for(unsigned int i = 0; i < nx_; ++i)
+                    out[i] = slope(i, j);
+                continue;
+            }
+
+            const float *row = &data_[j * nx_];
+            const float *row_up = row - nx_;
+            const float *row_down = row + nx_;
+            out[0] = slope(0, j);
+            for(unsigned int i = 1; i < nx_ - 1; ++i)
+            {
+                float grad_x = (row[i - 1] - row[i + 1]) / dx;
+                float grad_y = (row_up[i] - row_down[i]) / dy;
+                out[i] = sqrt(grad_x * grad_x + grad_y * grad_y);
+            }
+            out[nx_ - 1] = slope(nx_ - 1, j);
+        }
+    });
+    return result;
+}
+
+std::vector<float> ScalarField::laplacians() const
+{
+    std::vector<float> result(nx_ * ny_);
+    float area = scale_x_ * scale_y_;
+    util::parallel_for(0, ny_, [&](unsigned int j_begin, unsigned int j_end)
+    {
+        for(unsigned int j = j_begin; j < j_end; ++j)
+        {
+            float *out = &result[j * nx_];
+            if(j == 0 || j == ny_ - 1 || nx_ < 3)
+            {
+                for(unsigned int i = 0; i < nx_; ++i)
+                    out[i] = laplacian(i, j);
+                continue;
+            }
+
+            const float *row = &data_[j * nx_];
+            const float *row_up = row - nx_;
+            const float *row_down = row + nx_;
+            out[0] = laplacian(0, j);
+            for(unsigned int i = 1; i < nx_ - 1; ++i)
+                out[i] = (row[i - 1] + row[i + 1] + row_up[i] + row_down[i] - (4 * row[i])) / area;
+            out[nx_ - 1] = laplacian(nx_ - 1, j);
+        }
+    });
+    return result;
+}
+
+void ScalarField::export_data(const std::string &path, unsigned int bit_depth) const
+{
+    image_io::write_heights(path, data_, nx_, ny_, bit_depth);
 }
 
 void ScalarField::export_gradient(const std::string &path) const
 {
-    std::vector<float> magnitudes;
-    magnitudes.reserve(nx_ * ny_);
-    for(unsigned int j = 0; j < ny_; ++j)
-    {
-        for(unsigned int i = 0; i < nx_; ++i)
-            magnitudes.push_back(slope(i, j));
-    }
-    image_io::write_gray(path, magnitudes, nx_, ny_);
+    image_io::write_gray(path, slopes(), nx_, ny_);
 }
 
 void ScalarField::export_laplacian(const std::string &path) const
 {
-    std::vector<float> laplacians;
-    laplacians.reserve(nx_ * ny_);
-    for(unsigned int j = 0; j < ny_ ; ++j)
-    {
-        for(unsigned int i = 0; i < nx_; ++i)
-            laplacians.push_back(laplacian(i, j));
-    }
-    image_io::write_gray(path, laplacians, nx_, ny_);
+    image_io::write_gray(path, laplacians(), nx_, ny_);
 }
 
 unsigned int ScalarField::index(unsigned int i, unsigned int j) const
@@ -82,15 +173,25 @@ std::pair<unsigned int, unsigned int> ScalarField::coords(unsigned int index) co
 {
     assert(index < nx_ * ny_ && "index out of bounds");
     unsigned int i = index % nx_;
-    unsigned int j = (index - i) / ny_;
+    unsigned int j = (index - i) / nx_;
     return std::make_pair(i, j);
 }
 
-std::vector<float> ScalarField::data() const
+const std::vector<float> &ScalarField::data() const
 {
     return data_;
 }
 
+util::GridView<const float> ScalarField::view() const
+{
+    return util::GridView<const float>(data_.data(), nx_, ny_);
+}
+
+util::GridView<float> ScalarField::mutable_view()
+{
+    return util::GridView<float>(data_.data(), nx_, ny_);
+}
+
 Vector2<float> ScalarField::p_min() const
 {
     return p_min_;
@@ -5,22 +5,36 @@
 
 #include "vector.hpp"
 #include "image_io.hpp"
+#include "grid_view.hpp"
 
 class ScalarField
 {
 public:
     ScalarField(const Vector2<float> &p_min, const Vector2<float> &p_max, unsigned int nx, unsigned int ny);
+    // adopts the values without copying them
+    ScalarField(std::vector<float> &&data, const Vector2<float> &p_min, const Vector2<float> &p_max, unsigned int nx, unsigned int ny);
 
     float value(unsigned int i, unsigned int j) const;
     Vector2<float> gradient(unsigned int i, unsigned int j) const;
     float slope(unsigned int i, unsigned int j) const;
     float laplacian(unsigned int i, unsigned int j) const;
 
-    void export_data(const std::string &path) const;
+    // whole field versions of the accessors above, computed in one multithreaded pass
+    std::vector<Vector2<float>> gradients() const;
+    std::vector<float> slopes() const;
+    std::vector<float> laplacians() const;
+
+    // format from the extension (see image_io::write_heights), bit_depth 16 for 16 bit PNG
+    void export_data(const std::string &path, unsigned int bit_depth = 8) const;
     void export_gradient(const std::string &path) const;
     void export_laplacian(const std::string &path) const;
 
-    std::vector<float> data() const;
+    const std::vector<float> &data() const;
+    util::GridView<const float> view() const;
+    // writable values, derived fields caching results of them are told of the writes separately (see
+    // HeightField::heights_changed)
+    util::GridView<float> mutable_view();
+
     Vector2<float> p_min() const;
     Vector2<float> p_max() const;
     unsigned int nx() const;
@@ -0,0 +1,22 @@
+#include "stencil.hpp"
+
+// storage of the constant tables, needed in C++11 as soon as they are indexed at run time
+constexpr unsigned int stencil::M14::size;
+constexpr unsigned int stencil::M14::radius;
+constexpr int stencil::M14::di[];
+constexpr int stencil::M14::dj[];
+
+constexpr unsigned int stencil::M18::size;
+constexpr unsigned int stencil::M18::radius;
+constexpr int stencil::M18::di[];
+constexpr int stencil::M18::dj[];
+
+constexpr unsigned int stencil::M2::size;
+constexpr unsigned int stencil::M2::radius;
+constexpr int stencil::M2::di[];
+constexpr int stencil::M2::dj[];
+
+constexpr unsigned int stencil::M3::size;
+constexpr unsigned int stencil::M3::radius;
+constexpr int stencil::M3::di[];
+constexpr int stencil::M3::dj[];
@@ -0,0 +1,202 @@
+#ifndef MESHTOOL_STENCIL
+#define MESHTOOL_STENCIL
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <math.h>
+
+// neighborhood shapes, offsets are listed row by row so the opposite of neighbor k is always neighbor size - 1 - k
+namespace stencil
+{
+    // 4 adjacent cells
+    struct M14
+    {
+        static constexpr unsigned int size = 4;
+        static constexpr unsigned int radius = 1;
+        static constexpr int di[size] = {0, -1, 1, 0};
+        static constexpr int dj[size] = {-1, 0, 0, 1};
+    };
+
+    // 8 adjacent cells
+    struct M18
+    {
+        static constexpr unsigned int size = 8;
+        static constexpr unsigned int radius = 1;
+        static constexpr int di[size] = {-1, 0, 1, -1, 1, -1, 0, 1};
+        static constexpr int dj[size] = {-1, -1, -1, 0, 0, 1, 1, 1};
+    };
+
+    // 8 adjacent cells and 8 knight moves
+    struct M2
+    {
+        static constexpr unsigned int size = 16;
+        static constexpr unsigned int radius = 2;
+        static constexpr int di[size] = {-1, 1, -2, -1, 0, 1, 2, -1, 1, -2, -1, 0, 1, 2, -1, 1};
+        static constexpr int dj[size] = {-2, -2, -1, -1, -1, -1, -1, 0, 0, 1, 1, 1, 1, 1, 2, 2};
+    };
+
+    // M2 and the 16 cells of the 7x7 ring at distance sqrt(10) or sqrt(13)
+    struct M3
+    {
+        static constexpr unsigned int size = 32;
+        static constexpr unsigned int radius = 3;
+        static constexpr int di[size] = {-2, -1, 1, 2, -3, -1, 1, 3, -3, -2, -1, 0, 1, 2, 3, -1, 1, -3, -2, -1, 0, 1, 2, 3, -3, -1, 1, 3, -2, -1, 1, 2};
+        static constexpr int dj[size] = {-3, -3, -3, -3, -2, -2, -2, -2, -1, -1, -1, -1, -1, -1, -1, 0, 0, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3};
+    };
+}
+
+// stencil bound to a grid : linear offsets and distances are computed once from the constant tables, iterating
+// over the neighbors of an interior cell is then a fixed size loop without bounds checks nor allocation
+template<typename Shape>
+class Stencil
+{
+public:
+    static constexpr unsigned int size = Shape::size;
+
+    Stencil();
+    Stencil(unsigned int nx, unsigned int ny, float scale_x, float scale_y);
+
+    static int di(unsigned int k);
+    static int dj(unsigned int k);
+    static unsigned int opposite(unsigned int k);
+
+    int offset(unsigned int k) const;
+    float distance(unsigned int k) const;
+    float squared_distance(unsigned int k) const;
+    float inverse_distance(unsigned int k) const;
+
+    // the whole stencil of cell (i, j) is inside the grid
+    bool interior(unsigned int i, unsigned int j) const;
+
+    // bit k is set when neighbor k of cell (i, j) is inside the grid
+    std::uint32_t valid(unsigned int i, unsigned int j) const;
+
+    // calls function(k, n) for each neighbor n of cell (i, j) inside the grid, in stencil order. n is a std::size_t,
+    // mapped grids can exceed 2^32 cells
+    template<typename Function>
+    void for_each(unsigned int i, unsigned int j, const Function &function) const;
+
+private:
+    unsigned int nx_, ny_;
+    std::array<int, Shape::size> offsets_;
+    std::array<float, Shape::size> distances_;
+    std::array<float, Shape::size> squared_distances_;
+    std::array<float, Shape::size> inverse_distances_;
+};
+
+template<typename Shape>
+constexpr unsigned int Stencil<Shape>::size;
+
+template<typename Shape>
+Stencil<Shape>::Stencil() : nx_(0), ny_(0)
+{
+    offsets_.fill(0);
+    distances_.fill(0.0f);
+    squared_distances_.fill(0.0f);
+    inverse_distances_.fill(0.0f);
+}
+
+template<typename Shape>
+Stencil<Shape>::Stencil(unsigned int nx, unsigned int ny, float scale_x, float scale_y) : nx_(nx), ny_(ny)
+{
+    for(unsigned int k = 0; k < size; ++k)
+    {
+        offsets_[k] = Shape::dj[k] * (int)nx + Shape::di[k];
+        float dx = Shape::di[k] * scale_x;
+        float dy = Shape::dj[k] * scale_y;
+        squared_distances_[k] = dx * dx + dy * dy;
+        distances_[k] = sqrt(squared_distances_[k]);
+        inverse_distances_[k] = 1.0f / distances_[k];
+    }
+}
+
+template<typename Shape>
+inline int Stencil<Shape>::di(unsigned int k)
+{
+    return Shape::di[k];
+}
+
+template<typename Shape>
+inline int Stencil<Shape>::dj(unsigned int k)
+{
+    return Shape::dj[k];
+}
+
+template<typename Shape>
+inline unsigned int Stencil<Shape>::opposite(unsigned int k)
+{
+    return size - 1 - k;
+}
+
+template<typename Shape>
+inline int Stencil<Shape>::offset(unsigned int k) const
+{
+    return offsets_[k];
+}
+
+template<typename Shape>
+inline float Stencil<Shape>::distance(unsigned int k) const
+{
+    return distances_[k];
+}
+
+template<typename Shape>
+inline float Stencil<Shape>::squared_distance(unsigned int k) const
+{
+    return squared_distances_[k];
+}
+
+template<typename Shape>
+inline float Stencil<Shape>::inverse_distance(unsigned int k) const
+{
+    return inverse_distances_[k];
+}
+
+template<typename Shape>
+inline bool Stencil<Shape>::interior(unsigned int i, unsigned int j) const
+{
+    return i >= Shape::radius && j >= Shape::radius && i + Shape::radius < nx_ && j + Shape::radius < ny_;
+}
+
+template<typename Shape>
+inline std::uint32_t Stencil<Shape>::valid(unsigned int i, unsigned int j) const
+{
+    if(interior(i, j))
+        return size >= 32 ? 0xFFFFFFFFu : (1u << (size & 31)) - 1;
+
+    std::uint32_t mask = 0;
+    for(unsigned int k = 0; k < size; ++k)
+    {
+        int ni = (int)i + Shape::di[k];
+        int nj = (int)j + Shape::dj[k];
+        if(ni >= 0 && ni < (int)nx_ && nj >= 0 && nj < (int)ny_)
+            mask |= 1u << k;
+    }
+    return mask;
+}
+
+template<typename Shape>
+template<typename Function>
+inline void Stencil<Shape>::for_each(unsigned int i, unsigned int j, const Function &function) const
+{
+    assert(i < nx_ && j < ny_ && "indices out of bounds");
+    std::size_t c = (std::size_t)j * nx_ + i;
+    if(interior(i, j))
+    {
+        for(unsigned int k = 0; k < size; ++k)
+            function(k, c + offsets_[k]);
+        return;
+    }
+
+    for(unsigned int k = 0; k < size; ++k)
+    {
+        int ni = (int)i + Shape::di[k];
+        int nj = (int)j + Shape::dj[k];
+        if(ni >= 0 && ni < (int)nx_ && nj >= 0 && nj < (int)ny_)
+            function(k, (std::size_t)nj * nx_ + ni);
+    }
+}
+
+#endif
@@ -0,0 +1,253 @@
+#include "terrain_builder.hpp"
+
+#include <algorithm>
+
+namespace
+{
+    bool same_point(const Vector2<float> &a, const Vector2<float> &b)
+    {
+        return a.x == b.x && a.y == b.y;
+    }
+
+    bool same_noise(const NoiseParameters &a, const NoiseParameters &b)
+    {
+        return a.frequency_x == b.frequency_x && a.frequency_y == b.frequency_y && a.amplitude == b.amplitude && a.octaves == b.octaves
+            && a.lacunarity == b.lacunarity && a.gain == b.gain && a.type == b.type && a.seed == b.seed;
+    }
+
+    // true when the parameters a field stage depends on are the same in both jobs
+    bool same_stage(unsigned int stage, const TerrainJob &a, const TerrainJob &b)
+    {
+        switch((TerrainStage)stage)
+        {
+        case TerrainStage::base:
+            return a.nx == b.nx && a.ny == b.ny && same_point(a.p_min, b.p_min) && same_point(a.p_max, b.p_max) && same_noise(a.noise, b.noise)
+                && a.height_map == b.height_map && a.terrain_file == b.terrain_file && a.scale_z == b.scale_z
+                && a.blur == b.blur && a.gaussian_blur == b.gaussian_blur;
+        case TerrainStage::erosion:
+            return a.k == b.k && a.n == b.n && a.thermal_quantity == b.thermal_quantity && a.thermal_mode == b.thermal_mode
+                && a.nb_iterations == b.nb_iterations && a.flow == b.flow && a.flow_across_depressions == b.flow_across_depressions;
+        case TerrainStage::water:
+            return a.water_level == b.water_level && a.lakes == b.lakes && a.lake_step == b.lake_step;
+        case TerrainStage::road:
+            return a.x1 == b.x1 && a.y1 == b.y1 && a.x2 == b.x2 && a.y2 == b.y2 && a.width == b.width && a.slope_cost == b.slope_cost
+                && a.water_low_cost == b.water_low_cost && a.water_high_cost == b.water_high_cost && a.water_treshold == b.water_treshold
+                && a.road_search == b.road_search;
+        default:
+            return false;
+        }
+    }
+
+    void build_layer(TerrainBuild &build, TerrainLayer layer)
+    {
+        build.layer = layer;
+        build.layer_values.clear();
+        build.layer_image.reset();
+        if(layer == TerrainLayer::texture)
+            build.layer_image = std::make_shared<const Image>(build.field.layer_image(layer));
+        else
+            build.layer_values = build.field.layer_values(layer);
+    }
+
+    void build_mesh(TerrainBuild &build)
+    {
+        build.lod = TerrainLod(build.field);
+    }
+
+    DirtyRegion whole_grid(const HeightField &field)
+    {
+        DirtyRegion region(field.nx(), field.ny());
+        region.add_all();
+        return region;
+    }
+}
+
+TerrainPipeline::TerrainPipeline() : fields_(nb_field_stages, HeightField({0.0f, 0.0f}, {1.0f, 1.0f}, 2, 2)), returned_changes_(nb_field_stages)
+{}
+
+bool TerrainPipeline::run_stage(unsigned int stage, const TerrainJob &job, TerrainProgress *progress)
+{
+    if(stage == (unsigned int)TerrainStage::base)
+    {
+        if(progress && !progress->begin(TerrainStage::base))
+            return false;
+        return build_terrain(job, fields_[stage]);
+    }
+
+    fields_[stage] = fields_[stage - 1];
+    fields_[stage].clear_dirty_region();
+    switch((TerrainStage)stage)
+    {
+    case TerrainStage::erosion: return erode_terrain(job, fields_[stage], progress, &checkpoints_);
+    case TerrainStage::water: return fill_terrain(job, fields_[stage], progress);
+    case TerrainStage::road: return road_terrain(job, fields_[stage], progress);
+    default: return false;
+    }
+}
+
+std::unique_ptr<TerrainBuild> TerrainPipeline::build(const TerrainJob &job, TerrainLayer layer, TerrainProgress *progress)
+{
+    unsigned int first = 0;
+    while(first < nb_valid_ && same_stage(first, job_, job))
+        ++first;
+
+    if(first < nb_field_stages)
+    {
+        job_ = job;
+        nb_valid_ = first;
+        first_changed_ = std::min(first_changed_, first);
+        layer_valid_ = false;
+        mesh_valid_ = false;
+        for(unsigned int stage = first; stage < nb_field_stages; ++stage)
+        {
+            if(!run_stage(stage, job, progress))
+                return nullptr;
+            nb_valid_ = stage + 1;
+        }
+        last_.field = fields_[nb_field_stages - 1];
+    }
+
+    if(!layer_valid_ || last_.layer != layer)
+    {
+        if(progress && !progress->begin(TerrainStage::layer))
+            return nullptr;
+        build_layer(last_, layer);
+        layer_valid_ = true;
+    }
+
+    if(!mesh_valid_)
+    {
+        if(progress && !progress->begin(TerrainStage::mesh))
+            return nullptr;
+        build_mesh(last_);
+        mesh_valid_ = true;
+    }
+
+    // the base stage makes a new terrain, the previous changes of another grid size mark it all
+    const HeightField &field = last_.field;
+    last_.changed = DirtyRegion(field.nx(), field.ny());
+    if(first_changed_ == (unsigned int)TerrainStage::base)
+        last_.changed.add_all();
+    for(unsigned int stage = first_changed_; stage < nb_field_stages; ++stage)
+    {
+        last_.changed.merge(returned_changes_[stage]);
+        last_.changed.merge(fields_[stage].dirty_region());
+        returned_changes_[stage] = fields_[stage].dirty_region();
+    }
+    first_changed_ = nb_field_stages;
+    return std::unique_ptr<TerrainBuild>(new TerrainBuild(last_));
+}
+
+TerrainBuilder::TerrainBuilder(unsigned int preview_interval)
+{
+    progress_.preview_interval = preview_interval;
+    progress_.preview = [this](const HeightField &field, int)
+    {
+        std::unique_ptr<TerrainBuild> build(new TerrainBuild());
+        build->field = field;
+        build_layer(*build, running_layer_);
+        build_mesh(*build);
+        build->changed = whole_grid(field);
+        build->preview = true;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(!requested_)
+        {
+            dropped_changes_ = DirtyRegion();
+            ready_ = std::move(build);
+        }
+    };
+    thread_ = std::thread(&TerrainBuilder::run, this);
+}
+
+TerrainBuilder::~TerrainBuilder()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        progress_.cancelled = true;
+    }
+    condition_.notify_all();
+    thread_.join();
+}
+
+void TerrainBuilder::request(const TerrainJob &job, TerrainLayer layer)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        job_ = job;
+        layer_ = layer;
+        requested_ = true;
+        // the running build stops at its next step, the worker then starts this one
+        progress_.cancelled = true;
+    }
+    condition_.notify_all();
+}
+
+void TerrainBuilder::cancel()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    requested_ = false;
+    progress_.cancelled = true;
+}
+
+TerrainBuilder::Status TerrainBuilder::status() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    Status status;
+    status.busy = busy_ || requested_;
+    status.stage = (TerrainStage)progress_.stage.load();
+    unsigned int nb_steps = progress_.nb_steps;
+    status.progress = nb_steps > 0 ? std::min(1.0f, (float)progress_.step / nb_steps) : 0.0f;
+    return status;
+}
+
+std::unique_ptr<TerrainBuild> TerrainBuilder::take()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return std::move(ready_);
+}
+
+std::unique_ptr<TerrainBuild> TerrainBuilder::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    condition_.wait(lock, [this]() { return !requested_ && !busy_; });
+    return std::move(ready_);
+}
+
+void TerrainBuilder::run()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while(true)
+    {
+        condition_.wait(lock, [this]() { return stopping_ || requested_; });
+        if(stopping_)
+            return;
+
+        TerrainJob job = job_;
+        TerrainLayer layer = layer_;
+        running_layer_ = layer;
+        requested_ = false;
+        busy_ = true;
+        progress_.cancelled = false;
+        lock.unlock();
+
+        std::unique_ptr<TerrainBuild> build = pipeline_.build(job, layer, &progress_);
+
+        lock.lock();
+        busy_ = false;
+        // a build finished after a newer request is outdated. The changes of the builds the caller did not take
+        // carry over to the next one it takes
+        if(build && !requested_)
+        {
+            build->changed.merge(dropped_changes_);
+            if(ready_)
+                build->changed.merge(ready_->changed);
+            dropped_changes_ = DirtyRegion();
+            ready_ = std::move(build);
+        }
+        else if(build)
+            dropped_changes_.merge(build->changed);
+        condition_.notify_all();
+    }
+}
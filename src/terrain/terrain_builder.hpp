@@ -0,0 +1,108 @@
+#ifndef MESHTOOL_TERRAIN_BUILDER
+#define MESHTOOL_TERRAIN_BUILDER
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "terrain_job.hpp"
+#include "image.hpp"
+#include "terrain_lod.hpp"
+
+// CPU side of a viewer terrain : the mesh and the displayed layer, ready to be uploaded
+struct TerrainBuild
+{
+    HeightField field = HeightField({0.0f, 0.0f}, {1.0f, 1.0f}, 2, 2);
+    TerrainLayer layer = TerrainLayer::height;
+    std::vector<float> layer_values;            // scalar layers
+    std::shared_ptr<const Image> layer_image;   // texture layer
+
+    TerrainLod lod;
+    // cells whose height differs from the previous build handed over, to update the displayed mesh in place
+    DirtyRegion changed;
+    // intermediate state of a long erosion run, replaced by the finished build
+    bool preview = false;
+};
+
+// the build as a chain of cached stages : base terrain -> erosion -> water -> road -> layer and mesh. A stage
+// reruns only when the job parameters it depends on changed, or when a stage before it reran
+class TerrainPipeline
+{
+public:
+    TerrainPipeline();
+
+    // nullptr when a step failed or the build was cancelled, the stages done so far stay cached. Erosion runs
+    // resume from the checkpoints of previous runs with fewer iterations
+    std::unique_ptr<TerrainBuild> build(const TerrainJob &job, TerrainLayer layer, TerrainProgress *progress = nullptr);
+
+private:
+    // field stages, each one starting from a copy of the previous output
+    static const unsigned int nb_field_stages = 4;
+    bool run_stage(unsigned int stage, const TerrainJob &job, TerrainProgress *progress);
+
+private:
+    ErosionCheckpoints checkpoints_;
+    TerrainJob job_;                    // parameters of the cached stages
+    std::vector<HeightField> fields_;   // output of each field stage
+    unsigned int nb_valid_ = 0;         // leading field stages matching job_
+    bool layer_valid_ = false;
+    bool mesh_valid_ = false;
+    TerrainBuild last_;                 // layer and mesh of the last road output
+
+    // changes of each field stage to its input, as they were in the last returned build, and the first stage
+    // rerun since. The heights can only differ between two builds where either of them changed them
+    std::vector<DirtyRegion> returned_changes_;
+    unsigned int first_changed_ = 0;
+};
+
+// builds terrains on a background thread. The caller keeps its current terrain until take() hands over the next
+// one, a new request cancels the build in progress. Long erosion runs also hand over their intermediate states
+// every preview_interval iterations, without water and road
+class TerrainBuilder
+{
+public:
+    struct Status
+    {
+        bool busy;
+        TerrainStage stage;
+        float progress;     // in the current stage, between 0 and 1
+    };
+
+    explicit TerrainBuilder(unsigned int preview_interval = 10);
+    ~TerrainBuilder();
+    TerrainBuilder(const TerrainBuilder &) = delete;
+    TerrainBuilder &operator=(const TerrainBuilder &) = delete;
+
+    void request(const TerrainJob &job, TerrainLayer layer);
+    void cancel();
+
+    Status status() const;
+    // the last finished build, once. nullptr while none is ready
+    std::unique_ptr<TerrainBuild> take();
+    // blocks until the pending requests are built, then take()
+    std::unique_ptr<TerrainBuild> wait();
+
+private:
+    void run();
+
+private:
+    // only used by the worker thread
+    TerrainPipeline pipeline_;
+    TerrainLayer running_layer_ = TerrainLayer::height;
+
+    mutable std::mutex mutex_;
+    std::condition_variable condition_;
+    std::thread thread_;
+    bool stopping_ = false;
+    bool requested_ = false;
+    bool busy_ = false;
+    TerrainJob job_;
+    TerrainLayer layer_ = TerrainLayer::height;
+    TerrainProgress progress_;
+    std::unique_ptr<TerrainBuild> ready_;
+    DirtyRegion dropped_changes_;       // of the outdated builds never handed over
+};
+
+#endif
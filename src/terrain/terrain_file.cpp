@@ -0,0 +1,434 @@
+#include "terrain_file.hpp"
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "compression.hpp"
+#include "tiled_field.hpp"
+#include "parallel.hpp"
+
+// the file is little endian, like the hosts running the SSE kernels : headers and payloads are written as in memory
+namespace
+{
+    const char magic[8] = {'M', 'T', 'T', 'E', 'R', 'R', 'A', 'N'};
+    const std::uint32_t version = 1;
+    const std::size_t alignment = 4096;
+    // an LZ4 length extension byte stands for at most 255 decompressed bytes
+    const std::size_t max_lz_ratio = 255;
+
+    struct FileHeader
+    {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t nx, ny;
+        float p_min_x, p_min_y;
+        float p_max_x, p_max_y;
+        std::uint32_t flow_direction;
+        std::uint32_t flow_across_depressions;
+        std::uint32_t nb_layers;
+    };
+
+    struct FileLayer
+    {
+        std::uint32_t layer;
+        std::uint32_t encoding;
+        std::uint32_t compressed;
+        std::uint32_t tile_size;
+        float offset, scale;
+        std::uint64_t data_offset, data_size;
+    };
+
+    std::size_t aligned(std::size_t size)
+    {
+        return (size + alignment - 1) / alignment * alignment;
+    }
+
+    std::size_t element_size(TerrainFileEncoding encoding)
+    {
+        return encoding == TerrainFileEncoding::float32 ? sizeof(float) : sizeof(std::uint16_t);
+    }
+
+    // payload of a layer before it is written : either points to the caller's grid, or owns encoded bytes
+    struct Payload
+    {
+        FileLayer header;
+        const unsigned char *data = nullptr;
+        std::vector<unsigned char> bytes;
+    };
+
+    void encode(util::GridView<const float> values, TerrainFileEncoding encoding, Payload &payload)
+    {
+        unsigned int nx = values.width();
+        unsigned int ny = values.height();
+        payload.header.offset = 0.0f;
+        payload.header.scale = 1.0f;
+
+        if(encoding == TerrainFileEncoding::float32)
+        {
+            if(values.contiguous())
+            {
+                payload.data = (const unsigned char *)values.data();
+                return;
+            }
+            payload.bytes.resize((std::size_t)nx * ny * sizeof(float));
+            for(unsigned int j = 0; j < ny; ++j)
+                std::memcpy(&payload.bytes[(std::size_t)j * nx * sizeof(float)], values.row(j), nx * sizeof(float));
+            payload.data = payload.bytes.data();
+            return;
+        }
+
+        float min = values(0, 0), max = values(0, 0);
+        for(unsigned int j = 0; j < ny; ++j)
+        {
+            std::pair<const float *, const float *> range = std::minmax_element(values.row(j), values.row(j) + nx);
+            min = std::min(min, *range.first);
+            max = std::max(max, *range.second);
+        }
+        payload.header.offset = min;
+        payload.header.scale = (max - min) / 65535.0f;
+
+        float inverse_scale = max > min ? 1.0f / payload.header.scale : 0.0f;
+        payload.bytes.resize((std::size_t)nx * ny * sizeof(std::uint16_t));
+        std::uint16_t *quantized = (std::uint16_t *)payload.bytes.data();
+        util::parallel_for(0, ny, [&](unsigned int j_begin, unsigned int j_end)
+        {
+            for(unsigned int j = j_begin; j < j_end; ++j)
+            {
+                const float *row = values.row(j);
+                std::uint16_t *out = quantized + (std::size_t)j * nx;
+                for(unsigned int i = 0; i < nx; ++i)
+                    out[i] = (std::uint16_t)std::min(65535.0f, (row[i] - min) * inverse_scale + 0.5f);
+            }
+        });
+        payload.data = payload.bytes.data();
+    }
+
+    // the layer becomes a table of nb_tiles + 1 chunk offsets followed by the chunks. A chunk whose size is the
+    // raw tile size is stored as is, compression did not pay off
+    void compress(unsigned int nx, unsigned int ny, unsigned int tile_size, Payload &payload)
+    {
+        std::size_t element = element_size((TerrainFileEncoding)payload.header.encoding);
+        TileLayout layout(nx, ny, tile_size, tile_size);
+        std::vector<std::vector<unsigned char>> chunks(layout.nb_tiles());
+        layout.parallel_for_each([&](const Tile &tile)
+        {
+            std::size_t row_size = tile.width() * element;
+            std::size_t raw_size = row_size * tile.height();
+            std::vector<unsigned char> raw(raw_size), shuffled(raw_size);
+            for(unsigned int j = tile.j_begin; j < tile.j_end; ++j)
+                std::memcpy(&raw[(j - tile.j_begin) * row_size], payload.data + ((std::size_t)j * nx + tile.i_begin) * element, row_size);
+            util::shuffle_bytes(raw.data(), raw_size / element, element, shuffled.data());
+
+            std::vector<unsigned char> &chunk = chunks[tile.index];
+            chunk.resize(util::lz_bound(raw_size));
+            chunk.resize(util::lz_compress(shuffled.data(), raw_size, chunk.data()));
+            if(chunk.size() >= raw_size)
+                chunk.swap(raw);
+        });
+
+        std::vector<std::uint64_t> offsets(layout.nb_tiles() + 1);
+        offsets[0] = offsets.size() * sizeof(std::uint64_t);
+        for(unsigned int t = 0; t < layout.nb_tiles(); ++t)
+            offsets[t + 1] = offsets[t] + chunks[t].size();
+
+        std::vector<unsigned char> bytes(offsets.back());
+        std::memcpy(bytes.data(), offsets.data(), offsets.size() * sizeof(std::uint64_t));
+        for(unsigned int t = 0; t < layout.nb_tiles(); ++t)
+        {
+            if(!chunks[t].empty())
+                std::memcpy(&bytes[offsets[t]], chunks[t].data(), chunks[t].size());
+        }
+        payload.bytes.swap(bytes);
+        payload.data = payload.bytes.data();
+        payload.header.compressed = 1;
+        payload.header.tile_size = tile_size;
+    }
+
+    bool write_padding(FILE *file, std::size_t size)
+    {
+        static const unsigned char zeros[alignment] = {};
+        return size == 0 || fwrite(zeros, 1, size, file) == size;
+    }
+}
+
+bool write_terrain_file(const std::string &path, const TerrainFileInfo &info, const std::vector<std::pair<TerrainFileLayer, util::GridView<const float>>> &layers,
+    const TerrainFileOptions &options)
+{
+    assert(options.tile_size > 0 && "tile size must be positive");
+
+    std::vector<Payload> payloads(layers.size());
+    std::size_t position = aligned(sizeof(FileHeader) + layers.size() * sizeof(FileLayer));
+    for(unsigned int l = 0; l < layers.size(); ++l)
+    {
+        assert(layers[l].second.width() == info.nx && layers[l].second.height() == info.ny && "layer size does not match the grid");
+        Payload &payload = payloads[l];
+        TerrainFileEncoding encoding = layers[l].first == TerrainFileLayer::stream_areas ? TerrainFileEncoding::float32 : options.encoding;
+        std::memset(&payload.header, 0, sizeof(payload.header));
+        payload.header.layer = (std::uint32_t)layers[l].first;
+        payload.header.encoding = (std::uint32_t)encoding;
+        encode(layers[l].second, encoding, payload);
+        payload.header.data_size = (std::uint64_t)info.nx * info.ny * element_size(encoding);
+        if(options.compress)
+        {
+            compress(info.nx, info.ny, options.tile_size, payload);
+            payload.header.data_size = payload.bytes.size();
+        }
+        payload.header.data_offset = position;
+        position = aligned(position + payload.header.data_size);
+    }
+
+    FILE *file = fopen(path.c_str(), "wb");
+    if(file == nullptr)
+    {
+        fprintf(stderr, "[TERRAIN FILE] - could not write %s\n", path.c_str());
+        return false;
+    }
+
+    FileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.nx = info.nx;
+    header.ny = info.ny;
+    header.p_min_x = info.p_min.x;
+    header.p_min_y = info.p_min.y;
+    header.p_max_x = info.p_max.x;
+    header.p_max_y = info.p_max.y;
+    header.flow_direction = (std::uint32_t)info.flow_direction;
+    header.flow_across_depressions = info.flow_across_depressions ? 1 : 0;
+    header.nb_layers = layers.size();
+
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+    std::size_t end = sizeof(header);
+    for(const Payload &payload : payloads)
+    {
+        written = written && fwrite(&payload.header, sizeof(payload.header), 1, file) == 1;
+        end += sizeof(payload.header);
+    }
+    for(const Payload &payload : payloads)
+    {
+        written = written && write_padding(file, payload.header.data_offset - end);
+        written = written && fwrite(payload.data, 1, payload.header.data_size, file) == payload.header.data_size;
+        end = payload.header.data_offset + payload.header.data_size;
+    }
+    written = fclose(file) == 0 && written;
+
+    if(!written)
+        fprintf(stderr, "[TERRAIN FILE] - could not write %s\n", path.c_str());
+    return written;
+}
+
+TerrainFile::~TerrainFile()
+{
+    close();
+}
+
+bool TerrainFile::open(const std::string &path)
+{
+    close();
+    int file = ::open(path.c_str(), O_RDONLY);
+    if(file < 0)
+    {
+        fprintf(stderr, "[TERRAIN FILE] - could not open %s\n", path.c_str());
+        return false;
+    }
+
+    struct stat status;
+    void *mapping = MAP_FAILED;
+    if(fstat(file, &status) == 0 && status.st_size > 0)
+        mapping = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    ::close(file);
+    if(mapping == MAP_FAILED)
+    {
+        fprintf(stderr, "[TERRAIN FILE] - could not map %s\n", path.c_str());
+        return false;
+    }
+    mapping_ = (const unsigned char *)mapping;
+    mapping_size_ = status.st_size;
+    path_ = path;
+
+    FileHeader header;
+    bool valid = mapping_size_ >= sizeof(header);
+    if(valid)
+    {
+        std::memcpy(&header, mapping_, sizeof(header));
+        // the grids are indexed in 32 bits and HeightField divides by nx - 1 and ny - 1
+        valid = std::memcmp(header.magic, magic, sizeof(magic)) == 0 && header.version == version
+            && mapping_size_ >= sizeof(header) + (std::size_t)header.nb_layers * sizeof(FileLayer)
+            && header.nx >= 2 && header.ny >= 2 && (std::size_t)header.nx * header.ny <= 0xFFFFFFFFu
+            && header.flow_direction <= (std::uint32_t)FlowDirection::single;
+    }
+    for(unsigned int l = 0; valid && l < header.nb_layers; ++l)
+    {
+        FileLayer entry;
+        std::memcpy(&entry, mapping_ + sizeof(header) + l * sizeof(FileLayer), sizeof(entry));
+        valid = entry.layer <= (std::uint32_t)TerrainFileLayer::stream_areas && entry.encoding <= (std::uint32_t)TerrainFileEncoding::uint16
+            && entry.data_offset % alignment == 0 && entry.data_offset <= mapping_size_ && entry.data_size <= mapping_size_ - entry.data_offset;
+
+        // the sizes are checked here, read_layer allocates the grid from them
+        std::size_t raw_size = (std::size_t)header.nx * header.ny * element_size((TerrainFileEncoding)entry.encoding);
+        if(valid && !entry.compressed)
+            valid = entry.data_size == raw_size;
+        else if(valid)
+        {
+            // a table of nb_tiles + 1 offsets, then blocks decompressing to at most max_lz_ratio times their size
+            std::size_t nb_tiles = entry.tile_size == 0 ? 0
+                : (std::size_t)((header.nx + (std::size_t)entry.tile_size - 1) / entry.tile_size) * ((header.ny + (std::size_t)entry.tile_size - 1) / entry.tile_size);
+            std::size_t table_size = (nb_tiles + 1) * sizeof(std::uint64_t);
+            valid = nb_tiles > 0 && table_size <= entry.data_size
+                && raw_size <= (entry.data_size - table_size) * max_lz_ratio;
+        }
+
+        Layer layer;
+        layer.layer = (TerrainFileLayer)entry.layer;
+        layer.encoding = (TerrainFileEncoding)entry.encoding;
+        layer.compressed = entry.compressed != 0;
+        layer.tile_size = entry.tile_size;
+        layer.offset = entry.offset;
+        layer.scale = entry.scale;
+        layer.data_offset = entry.data_offset;
+        layer.data_size = entry.data_size;
+        layers_.push_back(layer);
+    }
+    if(!valid)
+    {
+        fprintf(stderr, "[TERRAIN FILE] - %s is not a valid terrain file\n", path.c_str());
+        close();
+        return false;
+    }
+
+    info_.nx = header.nx;
+    info_.ny = header.ny;
+    info_.p_min = Vector2<float>(header.p_min_x, header.p_min_y);
+    info_.p_max = Vector2<float>(header.p_max_x, header.p_max_y);
+    info_.flow_direction = (FlowDirection)header.flow_direction;
+    info_.flow_across_depressions = header.flow_across_depressions != 0;
+    return true;
+}
+
+void TerrainFile::close()
+{
+    if(mapping_ != nullptr)
+    {
+        munmap((void *)mapping_, mapping_size_);
+        mapping_ = nullptr;
+    }
+    mapping_size_ = 0;
+    layers_.clear();
+    info_ = TerrainFileInfo();
+}
+
+const TerrainFileInfo &TerrainFile::info() const
+{
+    return info_;
+}
+
+bool TerrainFile::has_layer(TerrainFileLayer layer) const
+{
+    return find(layer) != nullptr;
+}
+
+util::GridView<const float> TerrainFile::mapped_layer(TerrainFileLayer layer) const
+{
+    const Layer *entry = find(layer);
+    if(entry == nullptr || entry->compressed || entry->encoding != TerrainFileEncoding::float32)
+        return util::GridView<const float>(nullptr, 0, 0);
+    return util::GridView<const float>((const float *)(mapping_ + entry->data_offset), info_.nx, info_.ny);
+}
+
+bool TerrainFile::read_layer(TerrainFileLayer layer, std::vector<float> &values) const
+{
+    const Layer *entry = find(layer);
+    if(entry == nullptr)
+        return false;
+
+    unsigned int nx = info_.nx;
+    unsigned int ny = info_.ny;
+    const unsigned char *data = mapping_ + entry->data_offset;
+
+    // converts n stored elements to floats
+    auto decode = [&](const unsigned char *src, std::size_t n, float *dst)
+    {
+        if(entry->encoding == TerrainFileEncoding::float32)
+            std::memcpy(dst, src, n * sizeof(float));
+        else
+        {
+            const std::uint16_t *quantized = (const std::uint16_t *)src;
+            for(std::size_t e = 0; e < n; ++e)
+                dst[e] = entry->offset + quantized[e] * entry->scale;
+        }
+    };
+
+    if(!entry->compressed)
+    {
+        values.resize((std::size_t)nx * ny);
+        std::size_t element = element_size(entry->encoding);
+        util::parallel_for(0, ny, [&](unsigned int j_begin, unsigned int j_end)
+        {
+            decode(data + (std::size_t)j_begin * nx * element, (std::size_t)(j_end - j_begin) * nx, &values[(std::size_t)j_begin * nx]);
+        });
+        return true;
+    }
+
+    TileLayout layout(nx, ny, entry->tile_size, entry->tile_size);
+    std::size_t table_size = (layout.nb_tiles() + 1) * sizeof(std::uint64_t);
+    if(entry->data_size < table_size)
+    {
+        fprintf(stderr, "[TERRAIN FILE] - %s : corrupted layer\n", path_.c_str());
+        return false;
+    }
+    std::vector<std::uint64_t> offsets(layout.nb_tiles() + 1);
+    std::memcpy(offsets.data(), data, table_size);
+    values.resize((std::size_t)nx * ny);
+
+    std::vector<std::uint8_t> valid(layout.nb_tiles(), 0);
+    layout.parallel_for_each([&](const Tile &tile)
+    {
+        std::uint64_t begin = offsets[tile.index];
+        std::uint64_t end = offsets[tile.index + 1];
+        if(begin < table_size || begin > end || end > entry->data_size)
+            return;
+
+        std::size_t element = element_size(entry->encoding);
+        std::size_t nb_elements = (std::size_t)tile.width() * tile.height();
+        std::size_t raw_size = nb_elements * element;
+        std::vector<unsigned char> raw(raw_size);
+        if(end - begin == raw_size)
+            std::memcpy(raw.data(), data + begin, raw_size);
+        else
+        {
+            std::vector<unsigned char> shuffled(raw_size);
+            if(!util::lz_decompress(data + begin, end - begin, shuffled.data(), raw_size))
+                return;
+            util::unshuffle_bytes(shuffled.data(), nb_elements, element, raw.data());
+        }
+
+        for(unsigned int j = tile.j_begin; j < tile.j_end; ++j)
+            decode(&raw[(j - tile.j_begin) * tile.width() * element], tile.width(), &values[(std::size_t)j * nx + tile.i_begin]);
+        valid[tile.index] = 1;
+    });
+
+    if(std::find(valid.begin(), valid.end(), 0) != valid.end())
+    {
+        fprintf(stderr, "[TERRAIN FILE] - %s : corrupted layer\n", path_.c_str());
+        return false;
+    }
+    return true;
+}
+
+const TerrainFile::Layer *TerrainFile::find(TerrainFileLayer layer) const
+{
+    for(const Layer &entry : layers_)
+    {
+        if(entry.layer == layer)
+            return &entry;
+    }
+    return nullptr;
+}
@@ -0,0 +1,93 @@
+#ifndef MESHTOOL_TERRAIN_FILE
+#define MESHTOOL_TERRAIN_FILE
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+#include "vector.hpp"
+#include "grid_view.hpp"
+#include "flow.hpp"
+
+// native terrain files : a header, a table of layers, then each layer on a page boundary. A layer is either the
+// raw row major grid (little endian float32 or uint16 quantized between the layer minimum and maximum), or
+// square tiles compressed independently after a byte shuffle. Raw float32 layers can be used in place from the
+// mapped file.
+
+enum class TerrainFileLayer : std::uint32_t
+{
+    height,
+    water,
+    stream_areas
+};
+
+enum class TerrainFileEncoding : std::uint32_t
+{
+    float32,
+    uint16      // 65536 levels between the minimum and maximum of the layer
+};
+
+struct TerrainFileOptions
+{
+    TerrainFileEncoding encoding = TerrainFileEncoding::float32;
+    bool compress = false;
+    unsigned int tile_size = 64;
+    // derived layers, saved so that loading does not recompute them
+    bool stream_areas = false;
+};
+
+struct TerrainFileInfo
+{
+    unsigned int nx = 0, ny = 0;
+    Vector2<float> p_min, p_max;
+    FlowDirection flow_direction = FlowDirection::multiple;
+    bool flow_across_depressions = false;
+};
+
+// stream areas are always stored as float32, their range is too wide for 16 bits
+bool write_terrain_file(const std::string &path, const TerrainFileInfo &info, const std::vector<std::pair<TerrainFileLayer, util::GridView<const float>>> &layers,
+    const TerrainFileOptions &options);
+
+// read only mapping of a terrain file
+class TerrainFile
+{
+public:
+    TerrainFile() = default;
+    ~TerrainFile();
+    TerrainFile(const TerrainFile &) = delete;
+    TerrainFile &operator=(const TerrainFile &) = delete;
+
+    bool open(const std::string &path);
+    void close();
+
+    const TerrainFileInfo &info() const;
+    bool has_layer(TerrainFileLayer layer) const;
+
+    // the layer inside the mapping when it is stored as raw float32, a null view otherwise. Valid until close()
+    util::GridView<const float> mapped_layer(TerrainFileLayer layer) const;
+    // decoded copy of the layer, tiles are decompressed in parallel
+    bool read_layer(TerrainFileLayer layer, std::vector<float> &values) const;
+
+private:
+    struct Layer
+    {
+        TerrainFileLayer layer;
+        TerrainFileEncoding encoding;
+        bool compressed;
+        unsigned int tile_size;
+        float offset, scale;
+        std::uint64_t data_offset, data_size;
+    };
+
+    const Layer *find(TerrainFileLayer layer) const;
+
+private:
+    std::string path_;
+    const unsigned char *mapping_ = nullptr;
+    std::size_t mapping_size_ = 0;
+    TerrainFileInfo info_;
+    std::vector<Layer> layers_;
+};
+
+#endif
@@ -0,0 +1,442 @@
+#include "terrain_job.hpp"
+
+#include <sstream>
+
+#include "util.hpp"
+#include "mapped_field.hpp"
+#include "layer_export.hpp"
+
+namespace
+{
+    // FNV-1a
+    void hash_bytes(std::uint64_t &hash, const void *data, std::size_t size)
+    {
+        const unsigned char *bytes = (const unsigned char *)data;
+        for(std::size_t i = 0; i < size; ++i)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+    }
+
+    template<typename T>
+    void hash_value(std::uint64_t &hash, const T &value)
+    {
+        hash_bytes(hash, &value, sizeof(value));
+    }
+
+    void hash_string(std::uint64_t &hash, const std::string &value)
+    {
+        hash_value(hash, value.size());
+        hash_bytes(hash, value.data(), value.size());
+    }
+
+    bool is_layer(const std::string &layer)
+    {
+        TerrainLayer parsed;
+        return layer == "terrain" || parse_layer(layer, parsed);
+    }
+
+    // 8 bit PNG outputs, which go through the layer exporter
+    bool is_png_layer(const TerrainJob &job, const std::string &layer, const std::string &path)
+    {
+        bool png = path.size() >= 4 && path.compare(path.size() - 4, 4, ".png") == 0;
+        return layer != "terrain" && (layer != "height" || (png && job.height_bit_depth == 8));
+    }
+
+    bool parse_entry(const std::string &key, std::istringstream &values, TerrainJob &job)
+    {
+        if(key == "nx") values >> job.nx;
+        else if(key == "ny") values >> job.ny;
+        else if(key == "p_min") values >> job.p_min.x >> job.p_min.y;
+        else if(key == "p_max") values >> job.p_max.x >> job.p_max.y;
+        else if(key == "frequency") values >> job.noise.frequency_x >> job.noise.frequency_y;
+        else if(key == "height") values >> job.noise.amplitude;
+        else if(key == "octaves") values >> job.noise.octaves;
+        else if(key == "lacunarity") values >> job.noise.lacunarity;
+        else if(key == "gain") values >> job.noise.gain;
+        else if(key == "seed") values >> job.noise.seed;
+        else if(key == "noise")
+        {
+            std::string type;
+            values >> type;
+            if(type == "fbm") job.noise.type = NoiseType::fbm;
+            else if(type == "ridged") job.noise.type = NoiseType::ridged;
+            else if(type == "billow") job.noise.type = NoiseType::billow;
+            else return false;
+        }
+        else if(key == "height_map") values >> job.height_map;
+        else if(key == "terrain_file") values >> job.terrain_file;
+        else if(key == "terrain_encoding")
+        {
+            std::string encoding;
+            values >> encoding;
+            if(encoding == "float32") job.terrain_options.encoding = TerrainFileEncoding::float32;
+            else if(encoding == "uint16") job.terrain_options.encoding = TerrainFileEncoding::uint16;
+            else return false;
+        }
+        else if(key == "terrain_compress") values >> job.terrain_options.compress;
+        else if(key == "terrain_stream_areas") values >> job.terrain_options.stream_areas;
+        else if(key == "height_bit_depth")
+        {
+            values >> job.height_bit_depth;
+            if(job.height_bit_depth != 8 && job.height_bit_depth != 16)
+                return false;
+        }
+        else if(key == "scale_z") values >> job.scale_z;
+        else if(key == "blur") values >> job.blur;
+        else if(key == "gaussian_blur") values >> job.gaussian_blur;
+        else if(key == "k") values >> job.k;
+        else if(key == "n") values >> job.n;
+        else if(key == "thermal_quantity") values >> job.thermal_quantity;
+        else if(key == "thermal_mode")
+        {
+            std::string mode;
+            values >> mode;
+            if(mode == "sequential") job.thermal_mode = ThermalErosionMode::sequential;
+            else if(mode == "parallel") job.thermal_mode = ThermalErosionMode::parallel;
+            else return false;
+        }
+        else if(key == "iterations") values >> job.nb_iterations;
+        else if(key == "flow")
+        {
+            std::string direction;
+            values >> direction;
+            if(direction == "multiple") job.flow = FlowDirection::multiple;
+            else if(direction == "single") job.flow = FlowDirection::single;
+            else return false;
+        }
+        else if(key == "flow_routing")
+        {
+            std::string routing;
+            values >> routing;
+            if(routing == "local") job.flow_across_depressions = false;
+            else if(routing == "depressions") job.flow_across_depressions = true;
+            else return false;
+        }
+        else if(key == "checkpoint_dir") values >> job.checkpoint_dir;
+        else if(key == "checkpoint_interval") values >> job.checkpoint_interval;
+        else if(key == "water_level") values >> job.water_level;
+        else if(key == "lakes") values >> job.lakes;
+        else if(key == "lake_step") values >> job.lake_step;
+        else if(key == "road") values >> job.x1 >> job.y1 >> job.x2 >> job.y2;
+        else if(key == "road_width") values >> job.width;
+        else if(key == "slope_cost") values >> job.slope_cost;
+        else if(key == "water_low_cost") values >> job.water_low_cost;
+        else if(key == "water_high_cost") values >> job.water_high_cost;
+        else if(key == "water_treshold") values >> job.water_treshold;
+        else if(key == "road_search")
+        {
+            std::string search;
+            values >> search;
+            if(search == "dijkstra") job.road_search = RoadSearch::dijkstra;
+            else if(search == "astar") job.road_search = RoadSearch::astar;
+            else if(search == "bidirectional") job.road_search = RoadSearch::bidirectional;
+            else return false;
+        }
+        else if(key == "mapped_file") values >> job.mapped_file;
+        else if(key == "tile_size")
+        {
+            values >> job.tile_size;
+            if(job.tile_size < 32 || (job.tile_size & (job.tile_size - 1)) != 0)
+                return false;
+        }
+        else if(key == "output")
+        {
+            std::string layer, path;
+            values >> layer >> path;
+            if(!is_layer(layer))
+                return false;
+            job.outputs.push_back(std::make_pair(layer, path));
+        }
+        else
+            return false;
+        return !values.fail();
+    }
+}
+
+const char *stage_name(TerrainStage stage)
+{
+    static const char *names[] = {"base terrain", "erosion", "water", "road", "layer", "mesh"};
+    return names[(unsigned int)stage];
+}
+
+bool TerrainProgress::begin(TerrainStage new_stage, unsigned int new_nb_steps)
+{
+    step = 0;
+    nb_steps = new_nb_steps;
+    stage = (unsigned int)new_stage;
+    return !cancelled;
+}
+
+bool TerrainProgress::advance()
+{
+    ++step;
+    return !cancelled;
+}
+
+// job files are made of "key = values" lines, '#' starts a comment
+bool load_job(const std::string &path, TerrainJob &job)
+{
+    std::string content;
+    if(!util::read_file(path, content))
+    {
+        fprintf(stderr, "[JOB] - could not read job file %s\n", path.c_str());
+        return false;
+    }
+
+    std::istringstream lines(content);
+    std::string line;
+    unsigned int line_number = 0;
+    while(std::getline(lines, line))
+    {
+        ++line_number;
+        line = line.substr(0, line.find('#'));
+        size_t separator = line.find('=');
+        if(separator == std::string::npos)
+        {
+            if(line.find_first_not_of(" \t\r") != std::string::npos)
+            {
+                fprintf(stderr, "[JOB] - %s:%u : missing '='\n", path.c_str(), line_number);
+                return false;
+            }
+            continue;
+        }
+
+        std::istringstream key_stream(line.substr(0, separator));
+        std::string key;
+        key_stream >> key;
+        std::istringstream values(line.substr(separator + 1));
+        if(!parse_entry(key, values, job))
+        {
+            fprintf(stderr, "[JOB] - %s:%u : invalid entry \"%s\"\n", path.c_str(), line_number, key.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+// base terrain of the job : a terrain file (grid included), a height map or perlin noise. Height maps and noise
+// are blurred, the same as in run_mapped_job
+bool build_terrain(const TerrainJob &job, HeightField &field)
+{
+    if(!job.terrain_file.empty())
+        return field.load(job.terrain_file);
+
+    if(!job.height_map.empty())
+    {
+        std::vector<float> heights;
+        unsigned int width = job.nx, height = job.ny;
+        if(!image_io::load_heights(job.height_map, heights, &width, &height, true))
+            return false;
+        for(float &h : heights)
+            h *= job.scale_z;
+        field = HeightField(std::move(heights), job.p_min, job.p_max, width, height);
+    }
+    else
+    {
+        field = HeightField(job.p_min, job.p_max, job.nx, job.ny);
+        field.perlin_noise(job.noise);
+    }
+
+    if(job.blur > 0)
+        field.blur(job.blur);
+    if(job.gaussian_blur > 0.0f)
+        field.gaussian_blur(job.gaussian_blur);
+    return true;
+}
+
+bool export_layer(const HeightField &field, const std::string &layer, const std::string &path, const TerrainJob &job)
+{
+    if(layer == "terrain") return field.save(path, job.terrain_options);
+    else if(layer == "texture") field.export_texture(path);
+    else if(layer == "height") field.export_data(path, job.height_bit_depth);
+    else if(layer == "slope") field.export_gradient(path);
+    else if(layer == "laplacian") field.export_laplacian(path);
+    else if(layer == "wetness") field.export_wetness(path);
+    else if(layer == "stream_areas") field.export_stream_areas(path);
+    else
+        return false;
+    return true;
+}
+
+std::uint64_t erosion_key(const TerrainJob &job)
+{
+    std::uint64_t hash = 14695981039346656037ull;
+    hash_value(hash, job.nx);
+    hash_value(hash, job.ny);
+    hash_value(hash, job.p_min.x);
+    hash_value(hash, job.p_min.y);
+    hash_value(hash, job.p_max.x);
+    hash_value(hash, job.p_max.y);
+
+    hash_value(hash, job.noise.frequency_x);
+    hash_value(hash, job.noise.frequency_y);
+    hash_value(hash, job.noise.amplitude);
+    hash_value(hash, job.noise.octaves);
+    hash_value(hash, job.noise.lacunarity);
+    hash_value(hash, job.noise.gain);
+    hash_value(hash, job.noise.type);
+    hash_value(hash, job.noise.seed);
+    hash_string(hash, job.height_map);
+    hash_string(hash, job.terrain_file);
+    hash_value(hash, job.scale_z);
+    hash_value(hash, job.blur);
+    hash_value(hash, job.gaussian_blur);
+
+    hash_value(hash, job.k);
+    hash_value(hash, job.n);
+    hash_value(hash, job.thermal_quantity);
+    hash_value(hash, job.thermal_mode);
+    hash_value(hash, job.flow);
+    hash_value(hash, job.flow_across_depressions);
+    return hash;
+}
+
+bool erode_terrain(const TerrainJob &job, HeightField &field, TerrainProgress *progress, ErosionCheckpoints *checkpoints)
+{
+    field.set_flow_direction(job.flow);
+    field.set_flow_routing(job.flow_across_depressions);
+
+    // the heights are the whole state of the erosion, a checkpoint replaces the iterations before it
+    std::uint64_t key = checkpoints ? erosion_key(job) : 0;
+    int first = checkpoints ? checkpoints->restore(key, job.nb_iterations, field) : 0;
+
+    if(progress && !progress->begin(TerrainStage::erosion, job.nb_iterations > first ? job.nb_iterations - first : 1))
+        return false;
+
+    for(int i = first; i < job.nb_iterations; ++i)
+    {
+        field.thermal_erosion(job.thermal_quantity, job.thermal_mode);
+        field.stream_power_erosion(job.k, job.n);
+
+        int iteration = i + 1;
+        if(checkpoints && (checkpoints->due(iteration) || iteration == job.nb_iterations))
+            checkpoints->store(key, iteration, field);
+        if(progress && !progress->advance())
+            return false;
+        if(progress && progress->preview && progress->preview_interval > 0 && iteration % progress->preview_interval == 0 && iteration < job.nb_iterations)
+            progress->preview(field, iteration);
+    }
+    return true;
+}
+
+bool fill_terrain(const TerrainJob &job, HeightField &field, TerrainProgress *progress)
+{
+    if(progress && !progress->begin(TerrainStage::water))
+        return false;
+    field.fill(job.water_level, job.lakes, job.lake_step);
+    return true;
+}
+
+bool road_terrain(const TerrainJob &job, HeightField &field, TerrainProgress *progress)
+{
+    if(job.x1 == job.x2 && job.y1 == job.y2)
+        return true;
+
+    if(progress && !progress->begin(TerrainStage::road))
+        return false;
+    if(job.x1 < 0 || job.x2 < 0 || job.y1 < 0 || job.y2 < 0
+        || job.x1 >= (int)field.nx() || job.x2 >= (int)field.nx() || job.y1 >= (int)field.ny() || job.y2 >= (int)field.ny())
+    {
+        fprintf(stderr, "[JOB] - road endpoints are outside of the %ux%u grid\n", field.nx(), field.ny());
+        return false;
+    }
+    field.road(job.x1, job.y1, job.x2, job.y2, job.width, job.slope_cost, job.water_low_cost, job.water_high_cost, job.water_treshold, job.road_search);
+    return true;
+}
+
+bool process_terrain(const TerrainJob &job, HeightField &field, TerrainProgress *progress, ErosionCheckpoints *checkpoints)
+{
+    return erode_terrain(job, field, progress, checkpoints) && fill_terrain(job, field, progress) && road_terrain(job, field, progress);
+}
+
+bool run_job(const TerrainJob &job)
+{
+    if(!job.mapped_file.empty())
+        return run_mapped_job(job);
+
+    // the checkpoints of a single run are only useful on disk
+    ErosionCheckpoints checkpoints(job.checkpoint_interval, 0, job.checkpoint_dir);
+    HeightField field(job.p_min, job.p_max, 2, 2);
+    if(!build_terrain(job, field) || !process_terrain(job, field, nullptr, job.checkpoint_dir.empty() ? nullptr : &checkpoints))
+        return false;
+
+    // PNG layers are computed and written on the exporter workers while this thread writes the other outputs. The
+    // flow is computed before, the other outputs may read it too
+    LayerExporter exporter;
+    std::vector<LayerOutput> layers;
+    std::vector<std::pair<std::string, std::string>> others;
+    for(const std::pair<std::string, std::string> &output : job.outputs)
+    {
+        LayerOutput layer;
+        if(is_png_layer(job, output.first, output.second) && parse_layer(output.first, layer.layer))
+        {
+            layer.path = output.second;
+            layers.push_back(layer);
+            if(uses_flow(layer.layer))
+                field.stream_areas();
+        }
+        else
+            others.push_back(output);
+    }
+
+    // export_layers waits for the layer images, it runs on its own thread rather than on a worker it waits for
+    util::WorkerPool background(1);
+    std::future<std::vector<std::shared_ptr<const Image>>> computed = background.submit([&]() { return exporter.export_layers(field, layers); });
+    bool exported = true;
+    for(const std::pair<std::string, std::string> &output : others)
+    {
+        if(!export_layer(field, output.first, output.second, job))
+        {
+            exported = false;
+            break;
+        }
+    }
+    computed.wait();
+    return exporter.wait() && exported;
+}
+
+bool run_mapped_job(const TerrainJob &job)
+{
+    if(!job.height_map.empty())
+    {
+        fprintf(stderr, "[JOB] - height maps can not be loaded in a mapped field\n");
+        return false;
+    }
+    // stream areas, lakes and roads depend on the whole grid
+    if(job.k != 0.0f || job.x1 != job.x2 || job.y1 != job.y2)
+        fprintf(stderr, "[JOB] - stream power erosion and roads are skipped on mapped fields\n");
+    if(job.gaussian_blur > 0.0f)
+        fprintf(stderr, "[JOB] - gaussian blur is skipped on mapped fields, use blur\n");
+    if(job.thermal_mode == ThermalErosionMode::sequential && job.thermal_quantity != 0.0f)
+        fprintf(stderr, "[JOB] - mapped fields use the parallel thermal erosion\n");
+
+    MappedHeightField field;
+    if(!field.create(job.mapped_file, job.nx, job.ny, job.p_min, job.p_max, job.tile_size))
+        return false;
+
+    field.perlin_noise(job.noise);
+    field.blur(job.blur);
+    if(job.thermal_quantity != 0.0f)
+    {
+        for(int i = 0; i < job.nb_iterations; ++i)
+            field.thermal_erosion(job.thermal_quantity);
+    }
+
+    for(const std::pair<std::string, std::string> &output : job.outputs)
+    {
+        const std::string &path = output.second;
+        std::string extension = path.substr(path.find_last_of('.') + 1);
+        bool exported = false;
+        if(output.first == "height" && extension == "raw")
+            exported = field.export_raw(path);
+        else if(output.first == "height" && extension == "pgm")
+            exported = field.export_pgm(path);
+        else
+            fprintf(stderr, "[JOB] - %s : mapped fields only export the height layer as .raw or .pgm\n", path.c_str());
+        if(!exported)
+            return false;
+    }
+    return true;
+}
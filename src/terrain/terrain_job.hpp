@@ -0,0 +1,122 @@
+#ifndef MESHTOOL_TERRAIN_JOB
+#define MESHTOOL_TERRAIN_JOB
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+
+#include "heightfield.hpp"
+#include "erosion_checkpoints.hpp"
+
+// description of a headless terrain generation : the same steps as the viewer, without any window
+struct TerrainJob
+{
+    // grid
+    unsigned int nx = 250;
+    unsigned int ny = 250;
+    Vector2<float> p_min = Vector2<float>(0.0f, 0.0f);
+    Vector2<float> p_max = Vector2<float>(1.0f, 1.0f);
+
+    // base terrain (perlin noise, or a height map when height_map is set : 8 or 16 bit image, PFM or raw R16 / R32F)
+    NoiseParameters noise;
+    std::string height_map;
+    // native terrain file (see HeightField::save), replaces the noise or height map and keeps its own grid
+    std::string terrain_file;
+    float scale_z = 0.15f;
+    unsigned int blur = 0;
+    float gaussian_blur = 0.0f;
+
+    // erosion
+    float k = 0.0f;
+    float n = 1.0f;
+    float thermal_quantity = 0.0f;
+    ThermalErosionMode thermal_mode = ThermalErosionMode::parallel;
+    int nb_iterations = 0;
+    FlowDirection flow = FlowDirection::multiple;
+    bool flow_across_depressions = false;
+    // when checkpoint_dir is set, the heights are saved there every checkpoint_interval iterations and at the
+    // end. Later runs with the same base terrain and erosion parameters resume from the latest one (height maps
+    // and terrain files are identified by their path)
+    std::string checkpoint_dir;
+    unsigned int checkpoint_interval = 10;
+
+    // water level and lakes
+    float water_level = 0.05f;
+    bool lakes = true;
+    float lake_step = 0.0f;
+
+    // road
+    int x1 = 0;
+    int y1 = 0;
+    int x2 = 0;
+    int y2 = 0;
+    int width = 2;
+    float slope_cost = 0.0f;
+    float water_low_cost = 1.0f;
+    float water_high_cost = 100.0f;
+    float water_treshold = 0.01f;
+    RoadSearch road_search = RoadSearch::astar;
+
+    // out of core generation : when set, the grid is stored in this file and only the noise, blur and parallel
+    // thermal erosion steps run. The height layer is the only output, exported as .raw (float32) or .pgm (16 bit)
+    std::string mapped_file;
+    unsigned int tile_size = 256;
+
+    // native terrain file outputs
+    TerrainFileOptions terrain_options;
+    // height outputs : .pfm, .r16, .r32 or .raw by extension, else PNG of this bit depth (8 or 16)
+    unsigned int height_bit_depth = 8;
+
+    // outputs as (layer, path) pairs, layers are texture, height, slope, laplacian, wetness, stream_areas and
+    // terrain (native terrain file)
+    std::vector<std::pair<std::string, std::string>> outputs;
+};
+
+// steps of a terrain build, in order
+enum class TerrainStage : unsigned int
+{
+    base,
+    erosion,
+    water,
+    road,
+    layer,
+    mesh
+};
+
+const char *stage_name(TerrainStage stage);
+
+// progress of a build followed from another thread. Setting cancelled stops the build before its next step
+struct TerrainProgress
+{
+    std::atomic<unsigned int> stage{0};
+    std::atomic<unsigned int> step{0};
+    std::atomic<unsigned int> nb_steps{1};
+    std::atomic<bool> cancelled{false};
+
+    // intermediate erosion states, passed every preview_interval iterations from the building thread
+    unsigned int preview_interval = 0;
+    std::function<void(const HeightField &field, int iteration)> preview;
+
+    // both return false once the build is cancelled
+    bool begin(TerrainStage new_stage, unsigned int new_nb_steps = 1);
+    bool advance();
+};
+
+bool load_job(const std::string &path, TerrainJob &job);
+bool build_terrain(const TerrainJob &job, HeightField &field);
+// hash of the parameters the eroded heights depend on, but the iteration count
+std::uint64_t erosion_key(const TerrainJob &job);
+// steps applied to the base terrain, false when the step failed or the build was cancelled
+bool erode_terrain(const TerrainJob &job, HeightField &field, TerrainProgress *progress = nullptr, ErosionCheckpoints *checkpoints = nullptr);
+bool fill_terrain(const TerrainJob &job, HeightField &field, TerrainProgress *progress = nullptr);
+bool road_terrain(const TerrainJob &job, HeightField &field, TerrainProgress *progress = nullptr);
+// erosion, water and road
+bool process_terrain(const TerrainJob &job, HeightField &field, TerrainProgress *progress = nullptr, ErosionCheckpoints *checkpoints = nullptr);
+bool export_layer(const HeightField &field, const std::string &layer, const std::string &path, const TerrainJob &job);
+bool run_job(const TerrainJob &job);
+bool run_mapped_job(const TerrainJob &job);
+
+#endif
@@ -0,0 +1,459 @@
+#include "terrain_lod.hpp"
+
+#include <cmath>
+#include <cassert>
+#include <limits>
+#include <map>
+#include <tuple>
+#include <algorithm>
+
+#include "parallel.hpp"
+#include "mesh.hpp"
+
+TerrainLod::TerrainLod()
+{}
+
+TerrainLod::TerrainLod(const HeightField &field, unsigned int patch_size)
+    : patch_size_(patch_size), nx_(field.nx()), ny_(field.ny()), scale_x_(field.scale_x()), scale_y_(field.scale_y())
+{
+    assert(patch_size >= 1 && field.nx() >= 2 && field.ny() >= 2 && "incorrect level of detail patch size");
+    create_patches(field.nx(), field.ny());
+    create_indices();
+
+    std::size_t nb_vertices = patches_.size() * nb_patch_vertices();
+    heights_.resize(nb_vertices);
+    normals_.resize(nb_vertices);
+    std::vector<std::uint32_t> field_normals = grid_normals_packed(field.view(), field.scale_x(), field.scale_y());
+    util::parallel_for(0, patches_.size(), [this, &field, &field_normals](unsigned int begin, unsigned int end)
+    {
+        for(unsigned int p = begin; p < end; ++p)
+            build_patch(field, field_normals, p);
+    }, 1);
+
+    // children come after their parent, the errors are made monotonic from the leaves up
+    for(unsigned int p = patches_.size(); p-- > 0;)
+    {
+        for(int child : patches_[p].children)
+        {
+            if(child >= 0)
+                patches_[p].error = std::max(patches_[p].error, patches_[child].error);
+        }
+    }
+}
+
+unsigned int TerrainLod::patch_size() const
+{
+    return patch_size_;
+}
+
+unsigned int TerrainLod::nb_patch_vertices() const
+{
+    return (patch_size_ + 1) * (patch_size_ + 1) + ring_.size();
+}
+
+const std::vector<LodPatch> &TerrainLod::patches() const
+{
+    return patches_;
+}
+
+unsigned int TerrainLod::nx() const
+{
+    return nx_;
+}
+
+unsigned int TerrainLod::ny() const
+{
+    return ny_;
+}
+
+float TerrainLod::scale_x() const
+{
+    return scale_x_;
+}
+
+float TerrainLod::scale_y() const
+{
+    return scale_y_;
+}
+
+const std::vector<float> &TerrainLod::heights() const
+{
+    return heights_;
+}
+
+const std::vector<std::uint32_t> &TerrainLod::normals() const
+{
+    return normals_;
+}
+
+std::vector<std::uint16_t> TerrainLod::quantized_heights() const
+{
+    std::vector<std::uint16_t> values(heights_.size());
+    quantized_heights(0, heights_.size(), height_min(), height_max(), values.data());
+    return values;
+}
+
+void TerrainLod::quantized_heights(unsigned int first, unsigned int count, float height_min, float height_max, std::uint16_t *values) const
+{
+    assert(first + count <= heights_.size() && "vertices out of bounds");
+    float range = height_max - height_min;
+    float scale = range > 0.0f ? 65535.0f / range : 0.0f;
+    for(unsigned int v = 0; v < count; ++v)
+        values[v] = (std::uint16_t)std::max(0.0f, std::min(65535.0f, std::round((heights_[first + v] - height_min) * scale)));
+}
+
+float TerrainLod::height_min() const
+{
+    return patches_.empty() ? 0.0f : patches_[0].box_min.z;
+}
+
+float TerrainLod::height_max() const
+{
+    return patches_.empty() ? 0.0f : patches_[0].box_max.z;
+}
+
+// the same computation as basic_vertex.vs
+void TerrainLod::vertex_cell(const LodPatch &patch, unsigned int v, unsigned int &i, unsigned int &j) const
+{
+    unsigned int n = patch_size_ + 1;
+    if(v >= n * n)
+    {
+        // the ring starts at the first vertex and goes along the bottom, right, top and left borders
+        unsigned int k = v - n * n;
+        unsigned int side = k / patch_size_;
+        unsigned int t = k % patch_size_;
+        unsigned int border[4][2] = {{t, 0}, {patch_size_, t}, {patch_size_ - t, patch_size_}, {0, patch_size_ - t}};
+        v = border[side][1] * n + border[side][0];
+    }
+    i = std::min(patch.x0 + (v % n) * patch.stride, nx_ - 1);
+    j = std::min(patch.y0 + (v / n) * patch.stride, ny_ - 1);
+}
+
+Vector3<float> TerrainLod::position(const LodPatch &patch, unsigned int v) const
+{
+    unsigned int i, j;
+    vertex_cell(patch, v, i, j);
+    return Vector3<float>(i * scale_x_, j * scale_y_, heights_[patch.first_vertex + v]);
+}
+
+Vector2<float> TerrainLod::texture_coords(const LodPatch &patch, unsigned int v) const
+{
+    unsigned int i, j;
+    vertex_cell(patch, v, i, j);
+    return Vector2<float>(i / (float)(nx_ - 1), j / (float)(ny_ - 1));
+}
+
+const std::vector<unsigned int> &TerrainLod::indices() const
+{
+    return indices_;
+}
+
+void TerrainLod::select(const Vector3<float> &eye, float fov, float viewport_height, float max_pixel_error, std::vector<unsigned int> &selected) const
+{
+    selected.clear();
+    if(patches_.empty())
+        return;
+
+    // pixels covered by one unit of height at distance one
+    float pixels = viewport_height / (2.0f * std::tan(fov * 0.5f));
+
+    enum : unsigned char { unvisited, kept, split };
+    std::vector<unsigned char> states(patches_.size(), unvisited);
+    std::vector<unsigned int> stack(1, 0);
+    while(!stack.empty())
+    {
+        const LodPatch &patch = patches_[stack.back()];
+        unsigned int p = stack.back();
+        stack.pop_back();
+
+        float dx = std::max(0.0f, std::max(patch.box_min.x - eye.x, eye.x - patch.box_max.x));
+        float dy = std::max(0.0f, std::max(patch.box_min.y - eye.y, eye.y - patch.box_max.y));
+        float dz = std::max(0.0f, std::max(patch.box_min.z - eye.z, eye.z - patch.box_max.z));
+        float distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+
+        bool leaf = patch.stride == 1;
+        if(leaf || patch.error * pixels <= max_pixel_error * distance)
+        {
+            states[p] = kept;
+            continue;
+        }
+        states[p] = split;
+        for(int child : patch.children)
+        {
+            if(child >= 0)
+                stack.push_back(child);
+        }
+    }
+
+    // a kept patch is two levels coarser than a neighbor when the children of its same level neighbor facing it
+    // were split. Splitting it can unbalance its own coarser neighbors, until nothing changes
+    bool changed = true;
+    while(changed)
+    {
+        changed = false;
+        for(unsigned int p = 0; p < patches_.size(); ++p)
+        {
+            const LodPatch &patch = patches_[p];
+            if(states[p] != kept || patch.stride == 1)
+                continue;
+
+            bool unbalanced = false;
+            for(unsigned int side = 0; side < 4 && !unbalanced; ++side)
+            {
+                int neighbor = patch.neighbors[side];
+                if(neighbor < 0 || states[neighbor] != split)
+                    continue;
+                // children of the neighbor along the shared border : x is bit 0 and y bit 1 of the child index
+                unsigned int axis = side / 2;
+                unsigned int facing = side % 2 == 0 ? 1 : 0;
+                for(unsigned int c = 0; c < 4; ++c)
+                {
+                    int child = patches_[neighbor].children[c];
+                    if(((c >> axis) & 1) == facing && child >= 0 && states[child] == split)
+                        unbalanced = true;
+                }
+            }
+            if(!unbalanced)
+                continue;
+
+            states[p] = split;
+            for(int child : patch.children)
+            {
+                if(child >= 0)
+                    states[child] = kept;
+            }
+            changed = true;
+        }
+    }
+
+    for(unsigned int p = 0; p < patches_.size(); ++p)
+    {
+        if(states[p] == kept)
+            selected.push_back(p);
+    }
+}
+
+CullStats TerrainLod::cull(const Frustum &frustum, std::vector<unsigned int> &selected) const
+{
+    BoxBatch boxes;
+    for(unsigned int p : selected)
+        boxes.push_back(patches_[p].box_min, patches_[p].box_max);
+
+    std::vector<unsigned int> visible;
+    CullStats stats = frustum.cull(boxes, visible);
+    for(unsigned int &v : visible)
+        v = selected[v];
+    selected.swap(visible);
+    return stats;
+}
+
+unsigned int TerrainLod::nb_triangles(const std::vector<unsigned int> &selected) const
+{
+    return selected.size() * (indices_.size() / 3);
+}
+
+std::vector<VertexRange> TerrainLod::vertex_ranges(const DirtyRegion &changed) const
+{
+    std::vector<VertexRange> ranges;
+    if(changed.empty())
+        return ranges;
+    if(changed.nx() != nx_ || changed.ny() != ny_ || changed.all())
+        return {{0, (unsigned int)heights_.size()}};
+
+    std::vector<GridRect> rects = changed.rects();
+    for(const LodPatch &patch : patches_)
+    {
+        // cells of the patch, inclusive
+        unsigned int x1 = std::min(patch.x0 + patch_size_ * patch.stride, nx_ - 1);
+        unsigned int y1 = std::min(patch.y0 + patch_size_ * patch.stride, ny_ - 1);
+        for(const GridRect &rect : rects)
+        {
+            if(patch.x0 <= rect.i1 && rect.i0 <= x1 + 1 && patch.y0 <= rect.j1 && rect.j0 <= y1 + 1)
+            {
+                ranges.push_back({patch.first_vertex, nb_patch_vertices()});
+                break;
+            }
+        }
+    }
+    return coalesce_ranges(ranges);
+}
+
+// the root stride is the smallest power of two covering the grid, patches and vertices past the last cell are
+// clamped to it
+void TerrainLod::create_patches(unsigned int nx, unsigned int ny)
+{
+    unsigned int nb_cells = std::max(nx, ny) - 1;
+    unsigned int stride = 1;
+    while(patch_size_ * stride < nb_cells)
+        stride *= 2;
+
+    LodPatch root;
+    root.x0 = 0;
+    root.y0 = 0;
+    root.stride = stride;
+    root.level = 0;
+    patches_.push_back(root);
+
+    for(unsigned int p = 0; p < patches_.size(); ++p)
+    {
+        std::fill(patches_[p].children, patches_[p].children + 4, -1);
+        std::fill(patches_[p].neighbors, patches_[p].neighbors + 4, -1);
+        if(patches_[p].stride == 1)
+            continue;
+
+        unsigned int half = patch_size_ * patches_[p].stride / 2;
+        for(unsigned int c = 0; c < 4; ++c)
+        {
+            LodPatch child;
+            child.x0 = patches_[p].x0 + (c & 1) * half;
+            child.y0 = patches_[p].y0 + (c >> 1) * half;
+            if(child.x0 >= nx - 1 || child.y0 >= ny - 1)
+                continue;
+            child.stride = patches_[p].stride / 2;
+            child.level = patches_[p].level + 1;
+            patches_[p].children[c] = patches_.size();
+            patches_.push_back(child);
+        }
+    }
+
+    std::map<std::tuple<unsigned int, unsigned int, unsigned int>, int> by_cell;
+    for(unsigned int p = 0; p < patches_.size(); ++p)
+        by_cell[std::make_tuple(patches_[p].level, patches_[p].x0, patches_[p].y0)] = p;
+    for(LodPatch &patch : patches_)
+    {
+        unsigned int size = patch_size_ * patch.stride;
+        auto find = [&](long x0, long y0)
+        {
+            auto found = x0 >= 0 && y0 >= 0 ? by_cell.find(std::make_tuple(patch.level, (unsigned int)x0, (unsigned int)y0)) : by_cell.end();
+            return found == by_cell.end() ? -1 : found->second;
+        };
+        patch.neighbors[0] = find((long)patch.x0 - size, patch.y0);
+        patch.neighbors[1] = find((long)patch.x0 + size, patch.y0);
+        patch.neighbors[2] = find(patch.x0, (long)patch.y0 - size);
+        patch.neighbors[3] = find(patch.x0, (long)patch.y0 + size);
+    }
+}
+
+void TerrainLod::create_indices()
+{
+    unsigned int n = patch_size_ + 1;
+    for(unsigned int i = 0; i < patch_size_; ++i)
+        ring_.push_back(i);
+    for(unsigned int j = 0; j < patch_size_; ++j)
+        ring_.push_back(j * n + patch_size_);
+    for(unsigned int i = patch_size_; i > 0; --i)
+        ring_.push_back(patch_size_ * n + i);
+    for(unsigned int j = patch_size_; j > 0; --j)
+        ring_.push_back(j * n);
+
+    for(unsigned int j = 0; j < patch_size_; ++j)
+    {
+        for(unsigned int i = 0; i < patch_size_; ++i)
+        {
+            unsigned int i0 = j * n + i;
+            unsigned int i1 = i0 + 1;
+            unsigned int i2 = i0 + n;
+            unsigned int i3 = i2 + 1;
+
+            indices_.push_back(i0);
+            indices_.push_back(i1);
+            indices_.push_back(i3);
+
+            indices_.push_back(i0);
+            indices_.push_back(i3);
+            indices_.push_back(i2);
+        }
+    }
+
+    // skirt vertices follow the grid in ring order, the walls face outward
+    unsigned int nb_ring = ring_.size();
+    for(unsigned int k = 0; k < nb_ring; ++k)
+    {
+        unsigned int a = ring_[k];
+        unsigned int b = ring_[(k + 1) % nb_ring];
+        unsigned int sa = n * n + k;
+        unsigned int sb = n * n + (k + 1) % nb_ring;
+
+        indices_.push_back(a);
+        indices_.push_back(sa);
+        indices_.push_back(b);
+
+        indices_.push_back(b);
+        indices_.push_back(sa);
+        indices_.push_back(sb);
+    }
+}
+
+void TerrainLod::build_patch(const HeightField &field, const std::vector<std::uint32_t> &field_normals, unsigned int p)
+{
+    LodPatch &patch = patches_[p];
+    unsigned int last_i = field.nx() - 1;
+    unsigned int last_j = field.ny() - 1;
+    unsigned int n = patch_size_ + 1;
+    unsigned int s = patch.stride;
+    unsigned int x1 = std::min(patch.x0 + patch_size_ * s, last_i);
+    unsigned int y1 = std::min(patch.y0 + patch_size_ * s, last_j);
+
+    // height range and largest difference between the full resolution heights and the triangles of the patch
+    float z_min = std::numeric_limits<float>::max();
+    float z_max = -std::numeric_limits<float>::max();
+    float error = 0.0f;
+    for(unsigned int qj = 0; qj < patch_size_; ++qj)
+    {
+        unsigned int ya = std::min(patch.y0 + qj * s, last_j);
+        unsigned int yb = std::min(ya + s, last_j);
+        if(ya == yb)
+            break;
+        for(unsigned int qi = 0; qi < patch_size_; ++qi)
+        {
+            unsigned int xa = std::min(patch.x0 + qi * s, last_i);
+            unsigned int xb = std::min(xa + s, last_i);
+            if(xa == xb)
+                break;
+
+            float h0 = field.value(xa, ya);
+            float h1 = field.value(xb, ya);
+            float h2 = field.value(xa, yb);
+            float h3 = field.value(xb, yb);
+            for(unsigned int j = ya; j <= yb; ++j)
+            {
+                float v = (j - ya) / (float)(yb - ya);
+                for(unsigned int i = xa; i <= xb; ++i)
+                {
+                    float u = (i - xa) / (float)(xb - xa);
+                    float h = field.value(i, j);
+                    // same diagonal as the index pattern
+                    float surface = u >= v ? h0 + u * (h1 - h0) + v * (h3 - h1) : h0 + v * (h2 - h0) + u * (h3 - h2);
+                    error = std::max(error, std::abs(h - surface));
+                    z_min = std::min(z_min, h);
+                    z_max = std::max(z_max, h);
+                }
+            }
+        }
+    }
+
+    patch.error = error;
+    patch.box_min = Vector3<float>(patch.x0 * field.scale_x(), patch.y0 * field.scale_y(), z_min);
+    patch.box_max = Vector3<float>(x1 * field.scale_x(), y1 * field.scale_y(), z_max);
+    patch.first_vertex = p * nb_patch_vertices();
+
+    float *heights = &heights_[patch.first_vertex];
+    std::uint32_t *normals = &normals_[patch.first_vertex];
+    for(unsigned int j = 0; j < n; ++j)
+    {
+        unsigned int gj = std::min(patch.y0 + j * s, last_j);
+        for(unsigned int i = 0; i < n; ++i)
+        {
+            unsigned int gi = std::min(patch.x0 + i * s, last_i);
+            unsigned int v = j * n + i;
+            heights[v] = field.value(gi, gj);
+            normals[v] = field_normals[(std::size_t)gj * field.nx() + gi];
+        }
+    }
+    for(unsigned int k = 0; k < ring_.size(); ++k)
+    {
+        unsigned int v = n * n + k;
+        heights[v] = z_min;
+        normals[v] = normals[ring_[k]];
+    }
+}
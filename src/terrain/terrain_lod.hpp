@@ -0,0 +1,91 @@
+#ifndef MESHTOOL_TERRAIN_LOD
+#define MESHTOOL_TERRAIN_LOD
+
+#include <vector>
+#include <cstdint>
+
+#include "heightfield.hpp"
+#include "frustum.hpp"
+#include "dirty_region.hpp"
+
+// node of the level of detail quadtree, patch_size x patch_size quads of stride cells
+struct LodPatch
+{
+    unsigned int x0, y0;        // first cell
+    unsigned int stride;        // cells between two vertices, 1 for the leaves
+    unsigned int level;         // 0 for the root
+    int children[4];            // -1 when missing, all of them for the leaves
+    int neighbors[4];           // patches of the same level along -x, +x, -y and +y, -1 when missing
+    float error;                // largest height difference with the full resolution surface, children included
+    Vector3<float> box_min, box_max;
+    unsigned int first_vertex;
+};
+
+// chunked level of detail mesh : a quadtree of square patches with the same number of vertices, each level
+// halving the stride of its parent. The patches share one index pattern, whose skirt hangs from the border down
+// to the lowest height of the patch and hides the cracks between neighbors of different levels.
+// A vertex only stores its height and its octahedral normal (see pack_normal), its grid cell follows from its
+// index in the patch, the x0, y0 and stride of the patch and the size of the grid (see vertex_cell)
+class TerrainLod
+{
+public:
+    TerrainLod();
+    explicit TerrainLod(const HeightField &field, unsigned int patch_size = 32);
+
+    unsigned int patch_size() const;
+    unsigned int nb_patch_vertices() const;
+    const std::vector<LodPatch> &patches() const;
+
+    unsigned int nx() const;
+    unsigned int ny() const;
+    float scale_x() const;
+    float scale_y() const;
+
+    // vertices of every patch, one after the other
+    const std::vector<float> &heights() const;
+    const std::vector<std::uint32_t> &normals() const;
+    // heights as 16 bit unsigned normalized values, height_min() + value / 65535 (height_max() - height_min())
+    std::vector<std::uint16_t> quantized_heights() const;
+    // vertices [first, first + count) quantized over [height_min, height_max] instead
+    void quantized_heights(unsigned int first, unsigned int count, float height_min, float height_max, std::uint16_t *values) const;
+    float height_min() const;
+    float height_max() const;
+
+    // grid cell of the vertex v of a patch, v counted from its first vertex. Skirt vertices share the cell of
+    // the border vertex they hang from
+    void vertex_cell(const LodPatch &patch, unsigned int v, unsigned int &i, unsigned int &j) const;
+    Vector3<float> position(const LodPatch &patch, unsigned int v) const;
+    Vector2<float> texture_coords(const LodPatch &patch, unsigned int v) const;
+    // triangles of a patch, relative to its first vertex
+    const std::vector<unsigned int> &indices() const;
+
+    // coarsest patches covering the terrain whose error projects to at most max_pixel_error pixels, seen from eye
+    // with a vertical field of view fov on a viewport of viewport_height pixels. Patches next to much finer ones
+    // are split further, neighbors differ by one level at most so that the skirts stay short
+    void select(const Vector3<float> &eye, float fov, float viewport_height, float max_pixel_error, std::vector<unsigned int> &selected) const;
+    // keeps the selected patches whose box intersects the frustum
+    CullStats cull(const Frustum &frustum, std::vector<unsigned int> &selected) const;
+    unsigned int nb_triangles(const std::vector<unsigned int> &selected) const;
+
+    // vertices of the patches covering changed cells or their neighbors, whose normals depend on them. Whole
+    // patches, as the skirt follows their lowest height, coalesced
+    std::vector<VertexRange> vertex_ranges(const DirtyRegion &changed) const;
+
+private:
+    void create_patches(unsigned int nx, unsigned int ny);
+    void create_indices();
+    // vertices of patch p, from the packed normals of the full resolution grid
+    void build_patch(const HeightField &field, const std::vector<std::uint32_t> &field_normals, unsigned int p);
+
+private:
+    unsigned int patch_size_ = 0;
+    unsigned int nx_ = 0, ny_ = 0;
+    float scale_x_ = 0.0f, scale_y_ = 0.0f;
+    std::vector<LodPatch> patches_;
+    std::vector<unsigned int> ring_;    // border vertices of a patch, counterclockwise
+    std::vector<float> heights_;
+    std::vector<std::uint32_t> normals_;
+    std::vector<unsigned int> indices_;
+};
+
+#endif
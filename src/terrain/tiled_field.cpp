@@ -0,0 +1,48 @@
+#include "tiled_field.hpp"
+
+#include <cassert>
+#include <algorithm>
+
+TileLayout::TileLayout(unsigned int nx, unsigned int ny, unsigned int tile_width, unsigned int tile_height)
+    : nx_(nx), ny_(ny), tile_width_(std::max(1u, tile_width)), tile_height_(std::max(1u, tile_height))
+{
+    nb_tiles_x_ = (nx_ + tile_width_ - 1) / tile_width_;
+    nb_tiles_y_ = (ny_ + tile_height_ - 1) / tile_height_;
+}
+
+Tile TileLayout::tile(unsigned int t) const
+{
+    assert(t < nb_tiles() && "tile index out of bounds");
+    Tile tile;
+    tile.index = t;
+    tile.i_begin = (t % nb_tiles_x_) * tile_width_;
+    tile.j_begin = (t / nb_tiles_x_) * tile_height_;
+    tile.i_end = std::min(tile.i_begin + tile_width_, nx_);
+    tile.j_end = std::min(tile.j_begin + tile_height_, ny_);
+    return tile;
+}
+
+unsigned int TileLayout::nb_tiles() const
+{
+    return nb_tiles_x_ * nb_tiles_y_;
+}
+
+unsigned int TileLayout::nb_tiles_x() const
+{
+    return nb_tiles_x_;
+}
+
+unsigned int TileLayout::nb_tiles_y() const
+{
+    return nb_tiles_y_;
+}
+
+unsigned int TileLayout::tile_width() const
+{
+    return tile_width_;
+}
+
+unsigned int TileLayout::tile_height() const
+{
+    return tile_height_;
+}
@@ -0,0 +1,50 @@
+#ifndef MESHTOOL_TILED_FIELD
+#define MESHTOOL_TILED_FIELD
+
+#include "parallel.hpp"
+
+struct Tile
+{
+    unsigned int index;
+    unsigned int i_begin, j_begin;
+    unsigned int i_end, j_end;
+
+    unsigned int width() const { return i_end - i_begin; }
+    unsigned int height() const { return j_end - j_begin; }
+};
+
+// partition of a nx x ny grid in tiles of tile_width x tile_height cells, the last column and row of tiles
+// are clipped to the grid
+class TileLayout
+{
+public:
+    TileLayout(unsigned int nx, unsigned int ny, unsigned int tile_width, unsigned int tile_height);
+
+    Tile tile(unsigned int t) const;
+    unsigned int nb_tiles() const;
+    unsigned int nb_tiles_x() const;
+    unsigned int nb_tiles_y() const;
+    unsigned int tile_width() const;
+    unsigned int tile_height() const;
+
+    // calls function(tile) on every tile, tiles are split between threads
+    template<typename Function>
+    void parallel_for_each(const Function &function) const;
+
+private:
+    unsigned int nx_, ny_;
+    unsigned int tile_width_, tile_height_;
+    unsigned int nb_tiles_x_, nb_tiles_y_;
+};
+
+template<typename Function>
+void TileLayout::parallel_for_each(const Function &function) const
+{
+    util::parallel_for(0, nb_tiles(), [&](unsigned int tile_begin, unsigned int tile_end)
+    {
+        for(unsigned int t = tile_begin; t < tile_end; ++t)
+            function(tile(t));
+    }, 1);
+}
+
+#endif
@@ -0,0 +1,171 @@
+#include <vector>
+#include <algorithm>
+
+#include "test.hpp"
+#include "dirty_region.hpp"
+#include "ring_allocator.hpp"
+#include "terrain_lod.hpp"
+
+namespace
+{
+    bool same_rect(const GridRect &a, const GridRect &b)
+    {
+        return a.i0 == b.i0 && a.j0 == b.j0 && a.i1 == b.i1 && a.j1 == b.j1;
+    }
+
+    bool same_range(const VertexRange &a, const VertexRange &b)
+    {
+        return a.first == b.first && a.count == b.count;
+    }
+}
+
+TEST_CASE(dirty_region_tiles_at_borders)
+{
+    // 70 x 45 cells in tiles of 32 : the last column and row of tiles are partial
+    DirtyRegion region(70, 45);
+    CHECK(region.empty() && !region.all() && region.rects().empty());
+
+    // a cell of the last tile, and a rectangle past the grid, both clamped to it
+    region.add({69, 44, 70, 45});
+    std::vector<GridRect> rects = region.rects();
+    CHECK(rects.size() == 1 && same_rect(rects[0], {64, 32, 70, 45}));
+    region.add({60, 40, 1000, 1000});
+    rects = region.rects();
+    CHECK(rects.size() == 1 && same_rect(rects[0], {32, 32, 70, 45}));
+
+    // empty and outside rectangles mark nothing
+    region.clear();
+    region.add({10, 10, 10, 20});
+    region.add({70, 0, 80, 10});
+    CHECK(region.empty());
+
+    // adjacent tiles of a row form one run, a run of the next row over other columns stays apart
+    region.add({0, 0, 40, 1});
+    region.add({64, 0, 65, 1});
+    region.add({5, 33, 64, 34});
+    rects = region.rects();
+    CHECK(rects.size() == 2);
+    CHECK(same_rect(rects[0], {0, 0, 70, 32}));
+    CHECK(same_rect(rects[1], {0, 32, 64, 45}));
+
+    // runs of two rows over the same columns merge
+    DirtyRegion columns(100, 45);
+    columns.add({0, 0, 40, 1});
+    columns.add({97, 0, 98, 1});
+    columns.add({5, 33, 64, 34});
+    rects = columns.rects();
+    CHECK(rects.size() == 2);
+    CHECK(same_rect(rects[0], {96, 0, 100, 32}));
+    CHECK(same_rect(rects[1], {0, 0, 64, 45}));
+
+    region.add_all();
+    rects = region.rects();
+    CHECK(region.all() && rects.size() == 1 && same_rect(rects[0], {0, 0, 70, 45}));
+}
+
+TEST_CASE(dirty_region_merge)
+{
+    DirtyRegion region(100, 100);
+    DirtyRegion other(100, 100);
+    other.add({50, 50, 51, 51});
+    region.merge(other);
+    std::vector<GridRect> rects = region.rects();
+    CHECK(rects.size() == 1 && same_rect(rects[0], {32, 32, 64, 64}));
+
+    // an empty region of another size changes nothing, a non empty one marks the whole grid
+    region.merge(DirtyRegion(10, 10));
+    CHECK(region.nx() == 100 && !region.all());
+    DirtyRegion resized(10, 12);
+    resized.add({0, 0, 1, 1});
+    region.merge(resized);
+    CHECK(region.nx() == 10 && region.ny() == 12 && region.all());
+}
+
+TEST_CASE(coalesce_ranges_cases)
+{
+    // unsorted, adjacent, overlapping, contained and empty ranges
+    std::vector<VertexRange> ranges = coalesce_ranges({{20, 10}, {0, 5}, {5, 5}, {25, 10}, {22, 2}, {50, 0}, {40, 5}});
+    CHECK(ranges.size() == 3);
+    CHECK(same_range(ranges[0], {0, 10}));
+    CHECK(same_range(ranges[1], {20, 15}));
+    CHECK(same_range(ranges[2], {40, 5}));
+
+    // {0, 10} and {20, 15} are 10 elements apart, {40, 5} 5 elements after
+    std::vector<VertexRange> input = {{0, 10}, {20, 15}, {40, 5}};
+    ranges = coalesce_ranges(input, 4);
+    CHECK(ranges.size() == 3);
+    ranges = coalesce_ranges(input, 5);
+    CHECK(ranges.size() == 2 && same_range(ranges[0], {0, 10}) && same_range(ranges[1], {20, 25}));
+    ranges = coalesce_ranges(input, 10);
+    CHECK(ranges.size() == 1 && same_range(ranges[0], {0, 45}));
+
+    CHECK(coalesce_ranges({}).empty());
+}
+
+TEST_CASE(ring_allocator_wraps_and_waits_for_segments)
+{
+    util::RingAllocator ring(256, 16);
+    std::size_t offset = 1;
+    CHECK(!ring.allocate(0, offset) && !ring.allocate(257, offset));
+
+    // two segments of 112 bytes, the sizes rounded to the alignment
+    CHECK(ring.allocate(100, offset) && offset == 0);
+    CHECK(ring.close_segment());
+    CHECK(ring.allocate(100, offset) && offset == 112);
+    CHECK(ring.close_segment() && !ring.close_segment());
+    CHECK(ring.nb_segments() == 2 && ring.used() == 224);
+
+    // 64 bytes do not fit in the last 32, and the start of the buffer is used until the first segment is released
+    CHECK(!ring.allocate(64, offset));
+    ring.release_segment();
+    CHECK(ring.allocate(64, offset) && offset == 0);
+    CHECK(ring.used() == 112 + 32 + 64 && ring.pending());
+
+    // the next 64 bytes overlap the second segment
+    CHECK(!ring.allocate(64, offset));
+    CHECK(ring.close_segment());
+    ring.release_segment();
+    CHECK(ring.allocate(64, offset) && offset == 64);
+    CHECK(ring.close_segment());
+
+    // an empty ring starts over at 0
+    ring.release_segment();
+    ring.release_segment();
+    CHECK(ring.nb_segments() == 0 && ring.used() == 0);
+    CHECK(ring.allocate(256, offset) && offset == 0);
+}
+
+TEST_CASE(lod_vertex_ranges_cover_dirty_cells)
+{
+    HeightField field({0.0f, 0.0f}, {1.0f, 1.0f}, 129, 129);
+    TerrainLod lod(field, 8);
+
+    CHECK(lod.vertex_ranges(DirtyRegion(129, 129)).empty());
+    DirtyRegion other_size(65, 65);
+    other_size.add({0, 0, 1, 1});
+    std::vector<VertexRange> ranges = lod.vertex_ranges(other_size);
+    CHECK(ranges.size() == 1 && same_range(ranges[0], {0, (unsigned int)lod.heights().size()}));
+
+    // every vertex on a dirty cell, or next to one (its normal changes), is in a range
+    DirtyRegion changed(129, 129, 8);
+    changed.add({60, 100, 61, 101});
+    changed.add({128, 0, 129, 1});
+    ranges = lod.vertex_ranges(changed);
+    CHECK(!ranges.empty() && ranges.size() < lod.patches().size());
+    std::vector<GridRect> rects = changed.rects();
+    unsigned int missed = 0;
+    for(const LodPatch &patch : lod.patches())
+    {
+        for(unsigned int v = 0; v < lod.nb_patch_vertices(); ++v)
+        {
+            unsigned int i, j;
+            lod.vertex_cell(patch, v, i, j);
+            bool dirty = std::any_of(rects.begin(), rects.end(), [i, j](const GridRect &r) { return i + 1 >= r.i0 && i <= r.i1 && j + 1 >= r.j0 && j <= r.j1; });
+            unsigned int index = patch.first_vertex + v;
+            bool uploaded = std::any_of(ranges.begin(), ranges.end(), [index](const VertexRange &r) { return index >= r.first && index < r.first + r.count; });
+            if(dirty && !uploaded)
+                ++missed;
+        }
+    }
+    CHECK(missed == 0);
+}
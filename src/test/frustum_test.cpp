@@ -0,0 +1,105 @@
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "test.hpp"
+#include "frustum.hpp"
+
+namespace
+{
+    bool near_value(float a, float b)
+    {
+        return std::abs(a - b) < 1e-5f;
+    }
+
+    // true when the batch test culls the box
+    bool culled(const Frustum &frustum, const Vector3<float> &box_min, const Vector3<float> &box_max)
+    {
+        BoxBatch boxes;
+        boxes.push_back(box_min, box_max);
+        std::vector<unsigned int> visible;
+        frustum.cull(boxes, visible);
+        return visible.empty();
+    }
+}
+
+TEST_CASE(frustum_planes_of_identity)
+{
+    // the clip cube [-1, 1]^3 : left, right, bottom, top, near, far
+    Frustum frustum(Identity<float>());
+    const float expected[6][4] = {
+        {1.0f, 0.0f, 0.0f, 1.0f}, {-1.0f, 0.0f, 0.0f, 1.0f},
+        {0.0f, 1.0f, 0.0f, 1.0f}, {0.0f, -1.0f, 0.0f, 1.0f},
+        {0.0f, 0.0f, 1.0f, 1.0f}, {0.0f, 0.0f, -1.0f, 1.0f}};
+    for(unsigned int p = 0; p < 6; ++p)
+    {
+        for(unsigned int k = 0; k < 4; ++k)
+            CHECK(near_value(frustum.planes[p][k], expected[p][k]));
+    }
+
+    CHECK(frustum.intersects({-0.5f, -0.5f, -0.5f}, {0.5f, 0.5f, 0.5f}));
+    CHECK(frustum.intersects({0.5f, 0.5f, 0.5f}, {1.5f, 1.5f, 1.5f}));
+    CHECK(frustum.intersects({-3.0f, -3.0f, -3.0f}, {3.0f, 3.0f, 3.0f}));
+    CHECK(!frustum.intersects({2.0f, -0.5f, -0.5f}, {3.0f, 0.5f, 0.5f}));
+    CHECK(!frustum.intersects({-0.5f, -0.5f, -3.0f}, {0.5f, 0.5f, -1.5f}));
+}
+
+TEST_CASE(frustum_of_camera)
+{
+    // eye at the origin looking along +y, z up, 45 degrees each side of the axis vertically, near 0.1 and far 10
+    Matrix4<float> view = View<float>({0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 0.0f, 0.0f});
+    Frustum frustum(Projection<float>(M_PI / 4.0f, 1.0f, 0.1f, 10.0f) * view);
+
+    Vector3<float> inside_min(-0.5f, 4.0f, -0.5f), inside_max(0.5f, 5.0f, 0.5f);
+    Vector3<float> behind_min(-0.5f, -5.0f, -0.5f), behind_max(0.5f, -4.0f, 0.5f);
+    Vector3<float> beyond_min(-0.5f, 11.0f, -0.5f), beyond_max(0.5f, 12.0f, 0.5f);
+    Vector3<float> side_min(6.0f, 4.0f, -0.5f), side_max(7.0f, 5.0f, 0.5f);
+    Vector3<float> straddling_min(4.0f, 4.0f, -0.5f), straddling_max(6.0f, 5.0f, 0.5f);
+    Vector3<float> around_min(-1.0f, -1.0f, -1.0f), around_max(1.0f, 1.0f, 1.0f);
+
+    CHECK(frustum.intersects(inside_min, inside_max) && !culled(frustum, inside_min, inside_max));
+    CHECK(!frustum.intersects(behind_min, behind_max) && culled(frustum, behind_min, behind_max));
+    CHECK(!frustum.intersects(beyond_min, beyond_max) && culled(frustum, beyond_min, beyond_max));
+    CHECK(!frustum.intersects(side_min, side_max) && culled(frustum, side_min, side_max));
+    CHECK(frustum.intersects(straddling_min, straddling_max) && !culled(frustum, straddling_min, straddling_max));
+    CHECK(frustum.intersects(around_min, around_max) && !culled(frustum, around_min, around_max));
+}
+
+TEST_CASE(frustum_sse_matches_scalar)
+{
+    std::mt19937 generator(7);
+    std::uniform_real_distribution<float> position(-20.0f, 20.0f);
+    std::uniform_real_distribution<float> size(0.0f, 4.0f);
+
+    Matrix4<float> view = View<float>(normalize(Vector3<float>(0.3f, 1.0f, -0.4f)), {0.0f, 0.0f, 1.0f}, {1.0f, -2.0f, 3.0f});
+    Frustum frustum(Projection<float>(M_PI / 6.0f, 16.0f / 9.0f, 0.1f, 15.0f) * view);
+
+    // sizes that are not multiples of 4 run the scalar tail of the SSE path too
+    for(unsigned int nb_boxes : {0u, 1u, 3u, 4u, 1001u})
+    {
+        BoxBatch boxes;
+        for(unsigned int b = 0; b < nb_boxes; ++b)
+        {
+            Vector3<float> box_min(position(generator), position(generator), position(generator));
+            boxes.push_back(box_min, box_min + Vector3<float>(size(generator), size(generator), size(generator)));
+        }
+
+        std::vector<unsigned int> visible, reference;
+        CullStats stats = frustum.cull(boxes, visible);
+        CullStats reference_stats = frustum.cull_scalar(boxes, reference);
+        CHECK(visible == reference);
+        CHECK(stats.nb_tested == nb_boxes && reference_stats.nb_tested == nb_boxes);
+        CHECK(stats.nb_culled == reference_stats.nb_culled);
+        CHECK(stats.nb_culled + visible.size() == nb_boxes);
+
+        // the corner test of intersects never keeps a box the batch culls
+        for(unsigned int b = 0, v = 0; b < nb_boxes; ++b)
+        {
+            bool kept = v < visible.size() && visible[v] == b;
+            v += kept;
+            Vector3<float> center(boxes.cx[b], boxes.cy[b], boxes.cz[b]), extent(boxes.ex[b], boxes.ey[b], boxes.ez[b]);
+            if(!kept)
+                CHECK(!frustum.intersects(center - extent, center + extent));
+        }
+    }
+}
@@ -0,0 +1,196 @@
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "test.hpp"
+#include "terrain_lod.hpp"
+
+namespace
+{
+    const unsigned int grid_size = 129;
+    const unsigned int patch_size = 8;
+
+    // flat unit square with one spike : the patches around it are the only ones with an error
+    HeightField spike_field(unsigned int i, unsigned int j)
+    {
+        HeightField field({0.0f, 0.0f}, {1.0f, 1.0f}, grid_size, grid_size);
+        util::GridView<float> heights = field.mutable_view();
+        std::fill(heights.data(), heights.data() + grid_size * grid_size, 0.0f);
+        heights(i, j) = 1.0f;
+        field.heights_changed();
+        return field;
+    }
+
+    // pixels per unit of height at distance one is 1 with this field of view and viewport
+    const float fov = 2.0f * std::atan(1.0f);
+    const float viewport_height = 2.0f;
+
+    // cells [x0, x1] x [y0, y1] of a patch
+    void patch_cells(const TerrainLod &lod, const LodPatch &patch, unsigned int &x1, unsigned int &y1)
+    {
+        x1 = std::min(patch.x0 + lod.patch_size() * patch.stride, lod.nx() - 1);
+        y1 = std::min(patch.y0 + lod.patch_size() * patch.stride, lod.ny() - 1);
+    }
+
+    // every quad of the grid in exactly one selected patch
+    bool covers_grid(const TerrainLod &lod, const std::vector<unsigned int> &selected)
+    {
+        std::vector<unsigned int> counts((lod.nx() - 1) * (lod.ny() - 1), 0);
+        for(unsigned int p : selected)
+        {
+            const LodPatch &patch = lod.patches()[p];
+            unsigned int x1, y1;
+            patch_cells(lod, patch, x1, y1);
+            for(unsigned int j = patch.y0; j < y1; ++j)
+            {
+                for(unsigned int i = patch.x0; i < x1; ++i)
+                    ++counts[j * (lod.nx() - 1) + i];
+            }
+        }
+        return std::all_of(counts.begin(), counts.end(), [](unsigned int count) { return count == 1; });
+    }
+
+    // largest level difference between two selected patches sharing a piece of border
+    unsigned int max_neighbor_levels(const TerrainLod &lod, const std::vector<unsigned int> &selected)
+    {
+        unsigned int result = 0;
+        for(unsigned int a : selected)
+        {
+            for(unsigned int b : selected)
+            {
+                const LodPatch &pa = lod.patches()[a];
+                const LodPatch &pb = lod.patches()[b];
+                unsigned int ax1, ay1, bx1, by1;
+                patch_cells(lod, pa, ax1, ay1);
+                patch_cells(lod, pb, bx1, by1);
+                bool along_x = (ax1 == pb.x0 || bx1 == pa.x0) && std::max(pa.y0, pb.y0) < std::min(ay1, by1);
+                bool along_y = (ay1 == pb.y0 || by1 == pa.y0) && std::max(pa.x0, pb.x0) < std::min(ax1, bx1);
+                if(along_x || along_y)
+                    result = std::max(result, (unsigned int)std::abs((int)pa.level - (int)pb.level));
+            }
+        }
+        return result;
+    }
+}
+
+TEST_CASE(lod_flat_field_selects_root)
+{
+    HeightField field({0.0f, 0.0f}, {1.0f, 1.0f}, grid_size, grid_size);
+    TerrainLod lod(field, patch_size);
+    std::vector<unsigned int> selected;
+    lod.select({0.5f, 0.5f, 0.01f}, fov, viewport_height, 0.0f, selected);
+    CHECK(selected == std::vector<unsigned int>(1, 0));
+}
+
+TEST_CASE(lod_selection_follows_distance)
+{
+    TerrainLod lod(spike_field(40, 40), patch_size);
+    const LodPatch &root = lod.patches()[0];
+    CHECK(root.stride == 16);
+    CHECK(root.error > 0.5f && root.error <= 1.0f);
+
+    // the root is accepted as soon as its error is under max_pixel_error pixels, at twice its error above its box
+    std::vector<unsigned int> selected;
+    lod.select({0.5f, 0.5f, root.box_max.z + 2.0f * root.error}, fov, viewport_height, 1.0f, selected);
+    CHECK(selected == std::vector<unsigned int>(1, 0));
+
+    // at half of it the root splits, and only the patches over the spike keep refining
+    lod.select({0.5f, 0.5f, root.box_max.z + 0.5f * root.error}, fov, viewport_height, 1.0f, selected);
+    CHECK(selected.size() > 1);
+    CHECK(std::find(selected.begin(), selected.end(), 0u) == selected.end());
+    CHECK(covers_grid(lod, selected));
+
+    // without error tolerance, the patches over the spike go down to the leaves and the flat ones stay coarse
+    lod.select({0.5f, 0.5f, 2.0f}, fov, viewport_height, 0.0f, selected);
+    CHECK(covers_grid(lod, selected));
+    bool spike_in_leaf = false;
+    for(unsigned int p : selected)
+    {
+        const LodPatch &patch = lod.patches()[p];
+        unsigned int x1, y1;
+        patch_cells(lod, patch, x1, y1);
+        bool over_spike = patch.x0 <= 41 && 39 <= x1 && patch.y0 <= 41 && 39 <= y1;
+        CHECK(patch.error == 0.0f || patch.stride == 1);
+        spike_in_leaf = spike_in_leaf || (over_spike && patch.stride == 1);
+    }
+    CHECK(spike_in_leaf);
+
+    // a closer eye never draws fewer triangles
+    std::vector<unsigned int> near, far;
+    lod.select({0.3f, 0.3f, 1.5f}, fov, viewport_height, 0.5f, near);
+    lod.select({0.3f, 0.3f, 50.0f}, fov, viewport_height, 0.5f, far);
+    CHECK(lod.nb_triangles(far) <= lod.nb_triangles(near));
+}
+
+TEST_CASE(lod_neighbor_levels_differ_by_one)
+{
+    TerrainLod lod(spike_field(40, 40), patch_size);
+    std::vector<unsigned int> selected;
+    for(float height : {1.1f, 1.5f, 3.0f, 10.0f})
+    {
+        for(float max_pixel_error : {0.0f, 0.01f, 0.1f, 1.0f})
+        {
+            lod.select({0.3f, 0.3f, height}, fov, viewport_height, max_pixel_error, selected);
+            CHECK(covers_grid(lod, selected));
+            CHECK(max_neighbor_levels(lod, selected) <= 1);
+        }
+    }
+
+    // the spike refines down to the leaves (level 4) while the far quarter has no error : it can only be split to
+    // level 3 next to them by the balance
+    lod.select({0.3f, 0.3f, 2.0f}, fov, viewport_height, 0.0f, selected);
+    unsigned int max_level = 0;
+    for(unsigned int p : selected)
+        max_level = std::max(max_level, lod.patches()[p].level);
+    CHECK(max_level == 4);
+    CHECK(max_neighbor_levels(lod, selected) == 1);
+}
+
+TEST_CASE(lod_vertex_cells)
+{
+    // not a power of two plus one : the last patches are clamped to the grid
+    HeightField field({0.0f, 0.0f}, {2.0f, 1.0f}, 100, 60);
+    util::GridView<float> heights = field.mutable_view();
+    for(unsigned int j = 0; j < 60; ++j)
+    {
+        for(unsigned int i = 0; i < 100; ++i)
+            heights(i, j) = 0.01f * i + 0.02f * j;
+    }
+    field.heights_changed();
+
+    TerrainLod lod(field, patch_size);
+    unsigned int n = patch_size + 1;
+    CHECK(lod.nb_patch_vertices() == n * n + 4 * patch_size);
+    for(const LodPatch &patch : lod.patches())
+    {
+        for(unsigned int v = 0; v < lod.nb_patch_vertices(); ++v)
+        {
+            unsigned int i, j;
+            lod.vertex_cell(patch, v, i, j);
+            CHECK(i < field.nx() && j < field.ny());
+
+            unsigned int gi = v % n, gj = v / n;
+            if(v >= n * n)
+            {
+                // skirt : the ring of border vertices, counterclockwise from the first one
+                unsigned int k = v - n * n;
+                unsigned int side = k / patch_size, t = k % patch_size;
+                unsigned int ring[4][2] = {{t, 0}, {patch_size, t}, {patch_size - t, patch_size}, {0, patch_size - t}};
+                gi = ring[side][0];
+                gj = ring[side][1];
+                CHECK(lod.position(patch, v).z == patch.box_min.z);
+            }
+            else
+            {
+                Vector3<float> expected = field.point(i, j);
+                Vector3<float> position = lod.position(patch, v);
+                CHECK(position.x == expected.x && position.y == expected.y && position.z == expected.z);
+            }
+            CHECK(i == std::min(patch.x0 + gi * patch.stride, field.nx() - 1));
+            CHECK(j == std::min(patch.y0 + gj * patch.stride, field.ny() - 1));
+
+            Vector2<float> uv = lod.texture_coords(patch, v);
+            CHECK(uv.x == i / (float)(field.nx() - 1) && uv.y == j / (float)(field.ny() - 1));
+        }
+    }
+}
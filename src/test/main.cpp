@@ -0,0 +1,61 @@
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "test.hpp"
+
+namespace
+{
+    struct TestEntry
+    {
+        const char *name;
+        test::TestFunction function;
+    };
+
+    std::vector<TestEntry> &tests()
+    {
+        static std::vector<TestEntry> entries;
+        return entries;
+    }
+
+    unsigned int nb_failures = 0;
+}
+
+int test::register_test(const char *name, TestFunction function)
+{
+    tests().push_back({name, function});
+    return tests().size();
+}
+
+void test::check(bool condition, const char *expression, const char *file, int line)
+{
+    if(condition)
+        return;
+    ++nb_failures;
+    fprintf(stderr, "[TEST] - %s:%d : CHECK(%s) failed\n", file, line, expression);
+}
+
+// runs every test, or those whose name contains the first argument
+int main(int argc, char *argv[])
+{
+    const char *filter = argc > 1 ? argv[1] : "";
+    unsigned int nb_failed = 0;
+    for(const TestEntry &entry : tests())
+    {
+        if(!std::strstr(entry.name, filter))
+            continue;
+        unsigned int before = nb_failures;
+        entry.function();
+        bool passed = nb_failures == before;
+        nb_failed += !passed;
+        printf("%-40s %s\n", entry.name, passed ? "ok" : "FAILED");
+    }
+
+    if(nb_failed > 0)
+    {
+        fprintf(stderr, "[TEST] - %u test(s) failed\n", nb_failed);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,109 @@
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "test.hpp"
+#include "mesh.hpp"
+#include "terrain_lod.hpp"
+
+namespace
+{
+    double angle_degrees(const Vector3<float> &a, const Vector3<float> &b)
+    {
+        double cosine = ((double)a.x * b.x + (double)a.y * b.y + (double)a.z * b.z)
+            / std::sqrt(((double)a.x * a.x + (double)a.y * a.y + (double)a.z * a.z) * ((double)b.x * b.x + (double)b.y * b.y + (double)b.z * b.z));
+        return std::acos(std::min(1.0, cosine)) * 180.0 / M_PI;
+    }
+
+    HeightField noise_field(unsigned int nx, unsigned int ny)
+    {
+        HeightField field({0.0f, 0.0f}, {1.0f, 1.0f}, nx, ny);
+        NoiseParameters noise;
+        noise.frequency_x = 8.0f;
+        noise.frequency_y = 8.0f;
+        noise.amplitude = 0.2f;
+        noise.octaves = 5;
+        field.perlin_noise(noise);
+        return field;
+    }
+}
+
+TEST_CASE(packed_normals_round_trip)
+{
+    // the upper hemisphere on a regular grid of angles, poles and the horizon included
+    double max_error = 0.0;
+    for(unsigned int a = 0; a <= 90; ++a)
+    {
+        double elevation = a * M_PI / 180.0;
+        for(unsigned int b = 0; b < 720; ++b)
+        {
+            double azimuth = b * M_PI / 360.0;
+            Vector3<float> normal(std::cos(elevation) * std::cos(azimuth), std::cos(elevation) * std::sin(azimuth), std::sin(elevation));
+            max_error = std::max(max_error, angle_degrees(normal, unpack_normal(pack_normal(normal))));
+        }
+    }
+    CHECK(max_error < 0.05);
+
+    // the lower hemisphere is folded, its error bound is the same
+    for(const Vector3<float> &normal : {Vector3<float>(0.0f, 0.0f, -1.0f), normalize(Vector3<float>(0.3f, -0.5f, -0.8f))})
+        CHECK(angle_degrees(normal, unpack_normal(pack_normal(normal))) < 0.05);
+
+    Vector3<float> up = unpack_normal(pack_normal({0.0f, 0.0f, 1.0f}));
+    CHECK(up.x == 0.0f && up.y == 0.0f && up.z == 1.0f);
+}
+
+TEST_CASE(grid_normals_match_mesh_normals)
+{
+    // not square and not a multiple of 4 wide : the SSE loop, its scalar tail and the borders
+    HeightField field = noise_field(37, 23);
+    std::vector<Vector3<float>> positions;
+    std::vector<Vector2<float>> texture_coords;
+    std::vector<unsigned int> indices;
+    field.polygonize(positions, texture_coords, indices);
+
+    std::vector<Vector3<float>> reference = normals(positions, indices);
+    std::vector<Vector3<float>> grid = grid_normals(field.view(), field.scale_x(), field.scale_y());
+    std::vector<std::uint32_t> packed = grid_normals_packed(field.view(), field.scale_x(), field.scale_y());
+    CHECK(grid.size() == reference.size() && packed.size() == reference.size());
+    for(std::size_t v = 0; v < grid.size(); ++v)
+    {
+        CHECK(length(grid[v] - reference[v]) < 1e-5f);
+        CHECK(packed[v] == pack_normal(grid[v]));
+        CHECK(angle_degrees(reference[v], unpack_normal(packed[v])) < 0.05);
+    }
+}
+
+TEST_CASE(quantized_heights_bound)
+{
+    HeightField field = noise_field(65, 65);
+    TerrainLod lod(field, 8);
+    std::vector<std::uint16_t> quantized = lod.quantized_heights();
+    CHECK(quantized.size() == lod.heights().size());
+
+    // rounding to the nearest of 65536 levels : half a step, plus the float rounding of the dequantization
+    float z_min = lod.height_min();
+    float range = lod.height_max() - z_min;
+    float bound = 0.5f * range / 65535.0f + 1e-6f;
+    bool has_min = false, has_max = false;
+    for(std::size_t v = 0; v < quantized.size(); ++v)
+    {
+        float height = z_min + quantized[v] / 65535.0f * range;
+        CHECK(std::abs(height - lod.heights()[v]) <= bound);
+        has_min = has_min || quantized[v] == 0;
+        has_max = has_max || quantized[v] == 65535;
+    }
+    CHECK(has_min && has_max);
+
+    // a sub range quantized over a narrower interval clamps the heights outside of it
+    unsigned int count = lod.nb_patch_vertices();
+    std::vector<std::uint16_t> part(count);
+    float middle = z_min + 0.5f * range;
+    lod.quantized_heights(0, count, middle, lod.height_max(), part.data());
+    for(unsigned int v = 0; v < count; ++v)
+    {
+        if(lod.heights()[v] <= middle)
+            CHECK(part[v] == 0);
+        else
+            CHECK(std::abs(middle + part[v] / 65535.0f * (lod.height_max() - middle) - lod.heights()[v]) <= bound);
+    }
+}
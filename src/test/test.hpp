@@ -0,0 +1,21 @@
+#ifndef MESHTOOL_TEST
+#define MESHTOOL_TEST
+
+// minimal test registry : every TEST_CASE of the linked files runs from main, CHECK counts the failures of the
+// running case and prints them without stopping it
+namespace test
+{
+    using TestFunction = void (*)();
+
+    int register_test(const char *name, TestFunction function);
+    void check(bool condition, const char *expression, const char *file, int line);
+}
+
+#define TEST_CASE(name) \
+    static void name(); \
+    static const int name##_registered = test::register_test(#name, name); \
+    static void name()
+
+#define CHECK(condition) test::check((condition), #condition, __FILE__, __LINE__)
+
+#endif
@@ -0,0 +1,166 @@
+#include "compression.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    const std::size_t min_match = 4;
+    const std::size_t max_offset = 65535;
+    const unsigned int hash_bits = 14;
+
+    std::uint32_t read32(const unsigned char *p)
+    {
+        std::uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    std::uint32_t hash(std::uint32_t value)
+    {
+        return (value * 2654435761u) >> (32 - hash_bits);
+    }
+
+    void write_length(unsigned char *&out, std::size_t length)
+    {
+        while(length >= 255)
+        {
+            *out++ = 255;
+            length -= 255;
+        }
+        *out++ = (unsigned char)length;
+    }
+
+    bool read_length(const unsigned char *&in, const unsigned char *end, std::size_t &length)
+    {
+        unsigned char byte;
+        do
+        {
+            if(in == end)
+                return false;
+            byte = *in++;
+            length += byte;
+        }
+        while(byte == 255);
+        return true;
+    }
+
+    void write_literals(unsigned char *&out, unsigned char token, const unsigned char *literals, std::size_t nb_literals)
+    {
+        *out++ = (unsigned char)((nb_literals >= 15 ? 15 : nb_literals) << 4) | token;
+        if(nb_literals >= 15)
+            write_length(out, nb_literals - 15);
+        std::memcpy(out, literals, nb_literals);
+        out += nb_literals;
+    }
+}
+
+std::size_t util::lz_bound(std::size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+// greedy parse with a single entry hash table. The search step grows while no match is found, so incompressible
+// data goes through quickly
+std::size_t util::lz_compress(const unsigned char *src, std::size_t size, unsigned char *dst)
+{
+    unsigned char *out = dst;
+    std::vector<std::uint32_t> table(1u << hash_bits, 0);
+
+    std::size_t anchor = 0;
+    std::size_t i = 0;
+    while(i + min_match <= size)
+    {
+        std::uint32_t value = read32(src + i);
+        std::uint32_t &entry = table[hash(value)];
+        std::size_t candidate = entry;
+        entry = (std::uint32_t)i;
+        if(candidate >= i || i - candidate > max_offset || read32(src + candidate) != value)
+        {
+            i += 1 + ((i - anchor) >> 6);
+            continue;
+        }
+
+        std::size_t length = min_match;
+        while(i + length < size && src[candidate + length] == src[i + length])
+            ++length;
+
+        std::size_t match = length - min_match;
+        write_literals(out, (unsigned char)(match >= 15 ? 15 : match), src + anchor, i - anchor);
+        std::size_t offset = i - candidate;
+        *out++ = (unsigned char)(offset & 0xFF);
+        *out++ = (unsigned char)(offset >> 8);
+        if(match >= 15)
+            write_length(out, match - 15);
+
+        i += length;
+        anchor = i;
+    }
+
+    // the last sequence only has literals, the decoder recognizes it by reaching the end of the block
+    write_literals(out, 0, src + anchor, size - anchor);
+    return out - dst;
+}
+
+bool util::lz_decompress(const unsigned char *src, std::size_t size, unsigned char *dst, std::size_t dst_size)
+{
+    const unsigned char *in = src;
+    const unsigned char *in_end = src + size;
+    unsigned char *out = dst;
+    unsigned char *out_end = dst + dst_size;
+
+    while(in < in_end)
+    {
+        unsigned char token = *in++;
+        std::size_t nb_literals = token >> 4;
+        if(nb_literals == 15 && !read_length(in, in_end, nb_literals))
+            return false;
+        if(nb_literals > (std::size_t)(in_end - in) || nb_literals > (std::size_t)(out_end - out))
+            return false;
+        std::memcpy(out, in, nb_literals);
+        in += nb_literals;
+        out += nb_literals;
+
+        if(in == in_end)
+            break;
+
+        if(in_end - in < 2)
+            return false;
+        std::size_t offset = in[0] | (in[1] << 8);
+        in += 2;
+        std::size_t length = token & 0x0F;
+        if(length == 15 && !read_length(in, in_end, length))
+            return false;
+        length += min_match;
+        if(offset == 0 || offset > (std::size_t)(out - dst) || length > (std::size_t)(out_end - out))
+            return false;
+
+        // byte per byte since the match may overlap the bytes it produces
+        const unsigned char *match = out - offset;
+        for(std::size_t k = 0; k < length; ++k)
+            out[k] = match[k];
+        out += length;
+    }
+    return out == out_end;
+}
+
+void util::shuffle_bytes(const unsigned char *src, std::size_t nb_elements, std::size_t element_size, unsigned char *dst)
+{
+    for(std::size_t b = 0; b < element_size; ++b)
+    {
+        unsigned char *plane = dst + b * nb_elements;
+        for(std::size_t e = 0; e < nb_elements; ++e)
+            plane[e] = src[e * element_size + b];
+    }
+}
+
+void util::unshuffle_bytes(const unsigned char *src, std::size_t nb_elements, std::size_t element_size, unsigned char *dst)
+{
+    for(std::size_t b = 0; b < element_size; ++b)
+    {
+        const unsigned char *plane = src + b * nb_elements;
+        for(std::size_t e = 0; e < nb_elements; ++e)
+            dst[e * element_size + b] = plane[e];
+    }
+}
@@ -0,0 +1,25 @@
+#ifndef MESHTOOL_COMPRESSION
+#define MESHTOOL_COMPRESSION
+
+#include <cstddef>
+
+namespace util
+{
+    // LZ77 block codec with the LZ4 sequence layout : a token holding the literal and match lengths, the literals,
+    // a 16 bit little endian offset and the length extensions. Fast rather than small, meant for float grids
+    // whose bytes were shuffled first.
+
+    // worst case compressed size of size bytes
+    std::size_t lz_bound(std::size_t size);
+    // dst must hold lz_bound(size) bytes, returns the compressed size
+    std::size_t lz_compress(const unsigned char *src, std::size_t size, unsigned char *dst);
+    // false when the block is corrupted or does not decompress to exactly dst_size bytes
+    bool lz_decompress(const unsigned char *src, std::size_t size, unsigned char *dst, std::size_t dst_size);
+
+    // groups the k-th byte of every element together : exponents and high bytes of neighboring values repeat,
+    // which the codec can then match
+    void shuffle_bytes(const unsigned char *src, std::size_t nb_elements, std::size_t element_size, unsigned char *dst);
+    void unshuffle_bytes(const unsigned char *src, std::size_t nb_elements, std::size_t element_size, unsigned char *dst);
+}
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef MESHTOOL_GRID_VIEW
+#define MESHTOOL_GRID_VIEW
+
+#include <cassert>
+#include <cstddef>
+
+namespace util
+{
+    // non owning view of a row major grid : pointer, dimensions and stride (elements between two rows).
+    // GridView<const T> is the read only version, a GridView<T> converts to it
+    template<typename T>
+    class GridView
+    {
+    public:
+        GridView(T *data, unsigned int width, unsigned int height, unsigned int nb_channels = 1, unsigned int stride = 0);
+
+        template<typename U>
+        GridView(const GridView<U> &other);
+
+        T *data() const;
+        T *row(unsigned int j) const;
+        T &operator()(unsigned int i, unsigned int j, unsigned int channel = 0) const;
+
+        // rows [j_begin, j_end) of the grid
+        GridView<T> rows(unsigned int j_begin, unsigned int j_end) const;
+
+        unsigned int width() const;
+        unsigned int height() const;
+        unsigned int nb_channels() const;
+        unsigned int stride() const;
+        bool contiguous() const;
+
+    private:
+        T *data_;
+        unsigned int width_, height_, nb_channels_, stride_;
+    };
+}
+
+template<typename T>
+util::GridView<T>::GridView(T *data, unsigned int width, unsigned int height, unsigned int nb_channels, unsigned int stride)
+    : data_(data), width_(width), height_(height), nb_channels_(nb_channels), stride_(stride == 0 ? width * nb_channels : stride)
+{
+    assert(stride_ >= width_ * nb_channels_ && "stride is smaller than a row");
+}
+
+template<typename T>
+template<typename U>
+util::GridView<T>::GridView(const GridView<U> &other)
+    : data_(other.data()), width_(other.width()), height_(other.height()), nb_channels_(other.nb_channels()), stride_(other.stride())
+{}
+
+template<typename T>
+T *util::GridView<T>::data() const
+{
+    return data_;
+}
+
+template<typename T>
+T *util::GridView<T>::row(unsigned int j) const
+{
+    assert(j < height_ && "row out of bounds");
+    return data_ + (size_t)j * stride_;
+}
+
+template<typename T>
+T &util::GridView<T>::operator()(unsigned int i, unsigned int j, unsigned int channel) const
+{
+    assert(i < width_ && j < height_ && channel < nb_channels_ && "indices out of bounds");
+    return data_[(size_t)j * stride_ + i * nb_channels_ + channel];
+}
+
+template<typename T>
+util::GridView<T> util::GridView<T>::rows(unsigned int j_begin, unsigned int j_end) const
+{
+    assert(j_begin <= j_end && j_end <= height_ && "rows out of bounds");
+    return GridView<T>(data_ + (size_t)j_begin * stride_, width_, j_end - j_begin, nb_channels_, stride_);
+}
+
+template<typename T>
+unsigned int util::GridView<T>::width() const
+{
+    return width_;
+}
+
+template<typename T>
+unsigned int util::GridView<T>::height() const
+{
+    return height_;
+}
+
+template<typename T>
+unsigned int util::GridView<T>::nb_channels() const
+{
+    return nb_channels_;
+}
+
+template<typename T>
+unsigned int util::GridView<T>::stride() const
+{
+    return stride_;
+}
+
+template<typename T>
+bool util::GridView<T>::contiguous() const
+{
+    return stride_ == width_ * nb_channels_;
+}
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef MESHTOOL_PARALLEL
+#define MESHTOOL_PARALLEL
+
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+namespace util
+{
+    unsigned int nb_threads();
+
+    // splits [begin, end) in contiguous blocks, one per thread, and calls function(block_begin, block_end) on each
+    template<typename Function>
+    void parallel_for(unsigned int begin, unsigned int end, const Function &function, unsigned int min_block_size = 16);
+}
+
+inline unsigned int util::nb_threads()
+{
+    unsigned int nb = std::thread::hardware_concurrency();
+    return nb == 0 ? 1 : nb;
+}
+
+template<typename Function>
+void util::parallel_for(unsigned int begin, unsigned int end, const Function &function, unsigned int min_block_size)
+{
+    if(end <= begin)
+        return;
+
+    unsigned int size = end - begin;
+    unsigned int nb_blocks = std::min(nb_threads(), std::max(1u, size / std::max(1u, min_block_size)));
+    if(nb_blocks <= 1)
+    {
+        function(begin, end);
+        return;
+    }
+
+    std::vector<std::thread> threads;
+    threads.reserve(nb_blocks - 1);
+    unsigned int block_size = size / nb_blocks;
+    unsigned int remainder = size % nb_blocks;
+    unsigned int block_begin = begin;
+    for(unsigned int b = 0; b < nb_blocks; ++b)
+    {
+        unsigned int block_end = block_begin + block_size + (b < remainder ? 1 : 0);
+        if(b == nb_blocks - 1)
+            function(block_begin, block_end);
+        else
+            threads.push_back(std::thread(function, block_begin, block_end));
+        block_begin = block_end;
+    }
+
+    for(std::thread &thread : threads)
+        thread.join();
+}
+
+#endif
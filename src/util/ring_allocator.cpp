@@ -0,0 +1,71 @@
+#include "ring_allocator.hpp"
+
+#include <cassert>
+
+util::RingAllocator::RingAllocator(std::size_t capacity, std::size_t alignment) : capacity_(capacity), alignment_(alignment)
+{
+    assert(alignment > 0 && capacity % alignment == 0 && "ring capacity is not a multiple of the alignment");
+}
+
+std::size_t util::RingAllocator::capacity() const
+{
+    return capacity_;
+}
+
+std::size_t util::RingAllocator::used() const
+{
+    return used_;
+}
+
+// the used bytes are contiguous from the oldest segment to head_, an allocation not fitting before the end of the
+// buffer starts over at 0 and counts the skipped end as used
+bool util::RingAllocator::allocate(std::size_t size, std::size_t &offset)
+{
+    size = (size + alignment_ - 1) / alignment_ * alignment_;
+    if(size == 0 || size > capacity_)
+        return false;
+    if(used_ == 0)
+        head_ = 0;
+
+    std::size_t start = head_;
+    std::size_t padding = 0;
+    if(start + size > capacity_)
+    {
+        padding = capacity_ - start;
+        start = 0;
+    }
+    if(used_ + padding + size > capacity_)
+        return false;
+
+    offset = start;
+    head_ = start + size;
+    used_ += padding + size;
+    pending_ += padding + size;
+    return true;
+}
+
+bool util::RingAllocator::close_segment()
+{
+    if(pending_ == 0)
+        return false;
+    segments_.push_back(pending_);
+    pending_ = 0;
+    return true;
+}
+
+void util::RingAllocator::release_segment()
+{
+    assert(!segments_.empty() && "no segment to release");
+    used_ -= segments_.front();
+    segments_.pop_front();
+}
+
+unsigned int util::RingAllocator::nb_segments() const
+{
+    return segments_.size();
+}
+
+bool util::RingAllocator::pending() const
+{
+    return pending_ > 0;
+}
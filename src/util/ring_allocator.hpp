@@ -0,0 +1,40 @@
+#ifndef MESHTOOL_RING_ALLOCATOR
+#define MESHTOOL_RING_ALLOCATOR
+
+#include <deque>
+#include <cstddef>
+
+namespace util
+{
+    // offsets in a circular buffer whose space is reused in allocation order. Allocations are grouped in segments
+    // (one per batch of GPU copies, released once its fence signaled) and freed a whole segment at a time, the
+    // oldest first. Only the bookkeeping, the memory belongs to the caller
+    class RingAllocator
+    {
+    public:
+        explicit RingAllocator(std::size_t capacity = 0, std::size_t alignment = 16);
+
+        std::size_t capacity() const;
+        std::size_t used() const;
+
+        // offset of size contiguous bytes, aligned. false when size exceeds the capacity, or when the space is
+        // still used by segments : release the oldest one and retry
+        bool allocate(std::size_t size, std::size_t &offset);
+        // groups the allocations since the last call into a segment, false when there were none
+        bool close_segment();
+        // frees the oldest segment
+        void release_segment();
+        unsigned int nb_segments() const;
+        // allocations not in a segment yet
+        bool pending() const;
+
+    private:
+        std::size_t capacity_, alignment_;
+        std::size_t head_ = 0;      // next free byte
+        std::size_t used_ = 0;      // bytes of the segments and the pending allocations, padding included
+        std::size_t pending_ = 0;
+        std::deque<std::size_t> segments_;
+    };
+}
+
+#endif
@@ -0,0 +1,40 @@
+#include "worker_pool.hpp"
+
+util::WorkerPool::WorkerPool(unsigned int nb_workers)
+{
+    for(unsigned int i = 0; i < std::max(1u, nb_workers); ++i)
+        workers_.push_back(std::thread(&WorkerPool::run, this));
+}
+
+util::WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    condition_.notify_all();
+    for(std::thread &worker : workers_)
+        worker.join();
+}
+
+unsigned int util::WorkerPool::nb_workers() const
+{
+    return workers_.size();
+}
+
+void util::WorkerPool::run()
+{
+    while(true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_.wait(lock, [this]() { return stopping_ || !tasks_.empty(); });
+            if(tasks_.empty())
+                return;
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+        task();
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef MESHTOOL_WORKER_POOL
+#define MESHTOOL_WORKER_POOL
+
+#include <deque>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <future>
+#include <mutex>
+#include <functional>
+#include <condition_variable>
+
+#include "parallel.hpp"
+
+namespace util
+{
+    // fixed set of threads running queued tasks in submission order. Unlike parallel_for the threads outlive the
+    // call, so work can continue in the background ; the destructor runs the remaining tasks before joining
+    class WorkerPool
+    {
+    public:
+        explicit WorkerPool(unsigned int nb_workers = nb_threads());
+        ~WorkerPool();
+        WorkerPool(const WorkerPool &) = delete;
+        WorkerPool &operator=(const WorkerPool &) = delete;
+
+        // the future holds the result of function() once a worker ran it
+        template<typename Function>
+        auto submit(Function function) -> std::future<decltype(function())>;
+
+        unsigned int nb_workers() const;
+
+    private:
+        void run();
+
+    private:
+        std::vector<std::thread> workers_;
+        std::deque<std::function<void()>> tasks_;
+        std::mutex mutex_;
+        std::condition_variable condition_;
+        bool stopping_ = false;
+    };
+}
+
+template<typename Function>
+auto util::WorkerPool::submit(Function function) -> std::future<decltype(function())>
+{
+    typedef decltype(function()) Result;
+    std::shared_ptr<std::packaged_task<Result()>> task = std::make_shared<std::packaged_task<Result()>>(std::move(function));
+    std::future<Result> future = task->get_future();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back([task]() { (*task)(); });
+    }
+    condition_.notify_one();
+    return future;
+}
+
+#endif